@@ -0,0 +1,102 @@
+// Benchmark del pipeline de workers con el backend falso (sin red ni yt-dlp).
+// Uso: ./bench_workers [trabajos=200] [tamaños de pool...=1 2 4 8]
+#include "../server/server.hpp"
+#include "../worker/downloader.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sys/epoll.h>
+#include <vector>
+
+using namespace std;
+
+struct BenchResult {
+    int poolSize;
+    int jobs;
+    double seconds;
+    WorkerPoolStats stats;
+};
+
+static BenchResult runRound(int poolSize, int jobs) {
+    BenchResult result;
+    result.poolSize = poolSize;
+    result.jobs = jobs;
+
+    poolStats = WorkerPoolStats();
+    int epollFd = createEpoll();
+    initializeWorkers(epollFd, poolSize);
+
+    uint64_t startMs = monotonicMs();
+    for (int i = 0; i < jobs; i++) {
+        submitDownload("fake://bench/" + to_string(poolSize) + "/" + to_string(i), -1);
+    }
+
+    struct epoll_event events[64];
+    while (poolStats.jobsCompleted + poolStats.jobsFailed < (uint64_t)jobs) {
+        int nfds = epoll_wait(epollFd, events, 64, -1);
+        for (int i = 0; i < nfds; i++) {
+            EpollCallbackData* callback = (EpollCallbackData*)events[i].data.ptr;
+            callback->handler(callback->fd, callback->data);
+        }
+    }
+    result.seconds = (monotonicMs() - startMs) / 1000.0;
+    result.stats = poolStats;
+
+    shutdownWorkers();
+    close(epollFd);
+    while (waitpid(-1, nullptr, 0) > 0) {}
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    int jobs = argc > 1 ? atoi(argv[1]) : 200;
+    vector<int> poolSizes;
+    for (int i = 2; i < argc; i++) poolSizes.push_back(atoi(argv[i]));
+    if (poolSizes.empty()) poolSizes = {1, 2, 4, 8};
+
+    // Directorio temporal para los MP3 sintéticos
+    char dir[] = "/tmp/bench_workers_XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    fakeDownloaderConfig.probeLatencyMs = 20;
+    fakeDownloaderConfig.downloadLatencyMs = 50;
+    fakeDownloaderConfig.fileBytes = 1024 * 1024;
+    fakeDownloaderConfig.bytesPerSecond = 64 * 1024 * 1024;
+    activeDownloader = &fakeDownloader;
+
+    // Los logs del servidor (y de los workers, que heredan cout) a /dev/null
+    ofstream devNull("/dev/null");
+    streambuf* coutBuf = cout.rdbuf(devNull.rdbuf());
+    streambuf* cerrBuf = cerr.rdbuf(devNull.rdbuf());
+
+    globalDB = createDatabase();
+    vector<BenchResult> results;
+    for (int poolSize : poolSizes) {
+        results.push_back(runRound(poolSize, jobs));
+    }
+    freeDatabase(globalDB);
+
+    cout.rdbuf(coutBuf);
+    cerr.rdbuf(cerrBuf);
+
+    printf("backend=fake jobs=%d probe=%dms download=%dms file=%lluB rate=%lluB/s\n", jobs,
+           fakeDownloaderConfig.probeLatencyMs, fakeDownloaderConfig.downloadLatencyMs,
+           (unsigned long long)fakeDownloaderConfig.fileBytes,
+           (unsigned long long)fakeDownloaderConfig.bytesPerSecond);
+    printf("%6s %8s %10s %14s %13s %12s %12s\n", "pool", "jobs/s", "failed", "queue_wait_ms",
+           "run_ms", "ipc_avg_us", "ipc_max_us");
+    for (const BenchResult& r : results) {
+        uint64_t finished = r.stats.jobsCompleted + r.stats.jobsFailed;
+        printf("%6d %8.1f %10llu %14.1f %13.1f %12.1f %12llu\n", r.poolSize, r.jobs / r.seconds,
+               (unsigned long long)r.stats.jobsFailed, (double)r.stats.queueWaitMsTotal / finished,
+               (double)r.stats.runMsTotal / finished,
+               r.stats.ipcMessages ? (double)r.stats.ipcUsTotal / r.stats.ipcMessages : 0.0,
+               (unsigned long long)r.stats.ipcUsMax);
+    }
+
+    string cleanup = string("rm -rf ") + dir;
+    return system(cleanup.c_str()) == 0 ? 0 : 1;
+}
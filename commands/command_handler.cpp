@@ -13,9 +13,12 @@ map<string, void (*)(int, const string &)> commandHandlers;
 
 void initializeCommandHandlers() {
 	commandHandlers["ADD"] = handleAddCommand;	//	no está verificando que la url ya esté (faltá hacer que solo use los links globales)
+	commandHandlers["ADDLIST"] = handleAddListCommand;
 	commandHandlers["EXIT"] = handleExitCommand;
 	commandHandlers["GET"] = handleGetCommand;	//
 	commandHandlers["SEARCH"] = handleSearchCommand;	// hay que implementar un search bueno.
+	commandHandlers["DELETE"] = handleDeleteCommand;
+	commandHandlers["UPDATE"] = handleUpdateCommand;
 	cout << "[Server] Command handlers initialized" << endl;
 }
 
@@ -65,9 +68,9 @@ void handleGetCommand(int clientFd, const string &args) {
 	cout << "[GET] Cliente " << clientFd << " solicitó canción ID: " << songId << endl;
 
 	// Buscar canción
-	Song *song = getSongById(globalDB, (uint32_t)songId);
+	SongView song;
 
-	if (!song) {
+	if (!getSongById(globalDB, (uint32_t)songId, &song)) {
 		string error = "ERROR song_not_found\n";
 		send(clientFd, error.c_str(), error.size(), 0);
 		cout << "[GET] Canción no encontrada: ID " << songId << endl;
@@ -78,22 +81,23 @@ void handleGetCommand(int clientFd, const string &args) {
 	long offset = getSongOffsetInFile(globalDB, (uint32_t)songId);
 
 	// Construir respuesta
-	// Formato: SONG id|title|artist|filename|url|duration|offset
+	// Formato: SONG id|title|artist|filename|url|duration|offset|state
 	stringstream response;
 	response << "SONG "
-			 << song->id << "|"
-			 << song->title << "|"
-			 << song->artist << "|"
-			 << song->filename << "|"
-			 << song->url << "|"
-			 << song->duration << "|"
-			 << offset << "\n";
+			 << song.id << "|"
+			 << song.title << "|"
+			 << song.artist << "|"
+			 << song.filename << "|"
+			 << song.url << "|"
+			 << song.duration << "|"
+			 << offset << "|"
+			 << songStateName(song.state) << "\n";
 
 	string resp = response.str();
 	send(clientFd, resp.c_str(), resp.size(), 0);
 
-	cout << "[GET] Enviada canción: [" << song->id << "] "
-		 << song->title << " - " << song->artist
+	cout << "[GET] Enviada canción: [" << song.id << "] "
+		 << song.title << " - " << song.artist
 		 << " (offset: " << offset << " bytes)" << endl;
 }
 
@@ -106,18 +110,50 @@ void handleAddCommand(int clientFd, const string &url) {
 
 	cout << "[ADD] Cliente " << clientFd << " verificando URL: " << url << endl;
 
-	// Verificar si URL ya existe
-	if (isDuplicateURL(globalDB, url.c_str())) {
+	// Verificar si URL ya existe (una descarga fallida sí se puede reintentar)
+	SongView existing;
+	if (getSongByURL(globalDB, url.c_str(), &existing) && existing.state != SONG_FAILED) {
 		string response = "DUPLICATE\n";
 		send(clientFd, response.c_str(), response.size(), 0);
 		cout << "[ADD] URL duplicada rechazada: " << url << endl;
 		return;
 	}
 	
+	// No gastar un worker en una URL que acaba de fallar
+	const NegativeEntry *failure = findRecentFailure(url);
+	if (failure) {
+		string response = "ERROR recent_failure " + failure->reason + "\n";
+		send(clientFd, response.c_str(), response.size(), 0);
+		cout << "[ADD] URL con fallo reciente rechazada: " << url << endl;
+		return;
+	}
+
+	// Con el extractor caído la descarga queda en cola hasta que el breaker se cierre
+	if (downloadBreaker.state != BREAKER_CLOSED) {
+		string response = "DELAYED extractor_backoff\n";
+		send(clientFd, response.c_str(), response.size(), 0);
+	}
+
 	// Iniciar descarga
 	submitDownload(url, clientFd);
 }
 
+void handleAddListCommand(int clientFd, const string &url) {
+	if (url.empty()) {
+		string error = "ERROR missing_url\n";
+		send(clientFd, error.c_str(), error.size(), 0);
+		return;
+	}
+
+	cout << "[ADDLIST] Cliente " << clientFd << " importa playlist: " << url << endl;
+
+	// La expansión y la deduplicación se hacen en lote al terminar (ver worker_manager)
+	int bulkId = submitPlaylist(url, clientFd);
+
+	string response = "BULK_ACCEPTED " + to_string(bulkId) + "\n";
+	send(clientFd, response.c_str(), response.size(), 0);
+}
+
 void handleSearchCommand(int clientFd, const string &args) {
 	if (args.empty()) {
 		string error = "ERROR missing_query\n";
@@ -138,7 +174,7 @@ void handleSearchCommand(int clientFd, const string &args) {
 
 	cout << "[SEARCH] Cliente " << clientFd << " busca: \"" << query << "\"" << endl;
 
-	// Siempre buscar en AMBOS índices
+	// Las SEARCH_DEFAULT_LIMIT mejores, ya ordenadas
 	SearchResult result = searchSongs(globalDB, query.c_str());
 
 	if (result.count == 0) {
@@ -154,23 +190,83 @@ void handleSearchCommand(int clientFd, const string &args) {
 	response << "SEARCH_RESULTS " << result.count << "\n";
 
 	for (int i = 0; i < result.count; i++) {
-		Song *song = getSongById(globalDB, result.songIds[i]);
-		if (song) {
-			response << song->id << "|"
-					 << song->title << "|"
-					 << song->artist << "|"
-					 << song->duration << "\n";
+		SongView song;
+		if (getSongById(globalDB, result.songIds[i], &song)) {
+			response << song.id << "|"
+					 << song.title << "|"
+					 << song.artist << "|"
+					 << song.duration << "\n";
 		}
 	}
 
 	string resp = response.str();
 	send(clientFd, resp.c_str(), resp.size(), 0);
 
-	cout << "[SEARCH] Enviados " << result.count << " resultados" << endl;
+	if (result.totalMatches >= 0) {
+		cout << "[SEARCH] Enviados " << result.count << " de " << result.totalMatches << " resultados" << endl;
+	} else {
+		cout << "[SEARCH] Enviados " << result.count << " resultados" << endl;
+	}
 
 	freeSearchResult(&result);
 }
 
+// ===== DELETE <id> =====
+void handleDeleteCommand(int clientFd, const string &args) {
+	int songId = atoi(args.c_str());
+
+	if (songId <= 0) {
+		string error = args.empty() ? "ERROR missing_id\n" : "ERROR invalid_id\n";
+		send(clientFd, error.c_str(), error.size(), 0);
+		return;
+	}
+
+	cout << "[DELETE] Cliente " << clientFd << " borra canción ID: " << songId << endl;
+
+	if (!deleteSong(globalDB, (uint32_t)songId)) {
+		string error = "ERROR song_not_found\n";
+		send(clientFd, error.c_str(), error.size(), 0);
+		return;
+	}
+
+	string response = "DELETED " + to_string(songId) + "\n";
+	send(clientFd, response.c_str(), response.size(), 0);
+}
+
+// ===== UPDATE <id> <título>|<artista> (campo vacío = no cambiar) =====
+void handleUpdateCommand(int clientFd, const string &args) {
+	int songId = atoi(args.c_str());
+
+	if (songId <= 0) {
+		string error = args.empty() ? "ERROR missing_id\n" : "ERROR invalid_id\n";
+		send(clientFd, error.c_str(), error.size(), 0);
+		return;
+	}
+
+	size_t space_pos = args.find(' ');
+	size_t pipe_pos = args.find('|', space_pos);
+	if (space_pos == string::npos || pipe_pos == string::npos) {
+		string error = "ERROR missing_fields\n";
+		send(clientFd, error.c_str(), error.size(), 0);
+		return;
+	}
+
+	string title = args.substr(space_pos + 1, pipe_pos - space_pos - 1);
+	string artist = args.substr(pipe_pos + 1);
+	artist.erase(artist.find_last_not_of(" \t\r\n") + 1);
+
+	cout << "[UPDATE] Cliente " << clientFd << " corrige canción ID: " << songId << endl;
+
+	if (!updateSong(globalDB, (uint32_t)songId, title.c_str(), artist.c_str())) {
+		string error = "ERROR song_not_found\n";
+		send(clientFd, error.c_str(), error.size(), 0);
+		return;
+	}
+
+	string response = "UPDATED " + to_string(songId) + "\n";
+	send(clientFd, response.c_str(), response.size(), 0);
+}
+
 void handleExitCommand(int clientFd, const string &args) {
 	cout << "[EXIT] Cliente " << clientFd << " solicitó cerrar el servidor" << endl;
 	extern bool serverRunning;
@@ -2,6 +2,7 @@
 #include <map>
 #include <string>
 #include "../worker/worker_manager.hpp"
+#include "../worker/failure_guard.hpp"
 #include "../server/server.hpp"
 #include "../indexation/database.hpp"
 
@@ -14,6 +15,9 @@ extern map<string, void(*)(int, const string&)> commandHandlers;
 void initializeCommandHandlers();
 void handleCommand(int clientFd, const string& request);
 void handleAddCommand(int clientFd, const string& args);
+void handleAddListCommand(int clientFd, const string& args);
 void handleSearchCommand(int clientFd, const string& args);
 void handleGetCommand(int clientFd, const string& args);
+void handleDeleteCommand(int clientFd, const string& args);
+void handleUpdateCommand(int clientFd, const string& args);
 void handleExitCommand(int clientFd, const string& args);
\ No newline at end of file
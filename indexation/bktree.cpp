@@ -1,39 +1,32 @@
 #include "bktree.hpp"
+#include "epoch.hpp"
 #include <cstddef>
 #include <cstring>
 #include <algorithm>
 
-void insertWordBKTree(BKNode *&root, string word, int songId) {
+BKNode *insertWordBKTree(BKNode *&root, string word, int songId) {
 	if (root == nullptr) {
-		root = createBKNode(word, songId);
-		return;
+		EPOCH_PUBLISH(root, createBKNode(word, songId));
+		return root;
 	}
 
-	recursiveBKInsert(root, word, songId);
+	return recursiveBKInsert(root, word, songId);
 }
 
-void recursiveBKInsert(BKNode *node, string word, int songId) {
+// Los ids llegan crecientes: solo un UPDATE busca si ya estaba
+void insertBKSongId(BKNode *node, int songId) {
+	insertPublishedSorted(node->songIds, node->songIdCount, node->songIdCapacity, songId);
+}
+
+BKNode *recursiveBKInsert(BKNode *node, string word, int songId) {
 	string nodeWord(node->word);
 
 	if (word == nodeWord) {
-		for (int i = 0; i < node->songIdCount; i++) {
-			if (node->songIds[i] == songId) {
-				return;
-			}
-		}
-		if (node->songIdCount >= node->songIdCapacity) {
-			int newCapacity = node->songIdCapacity * 2;
-			int *newSongIds = new int[newCapacity];
-			memcpy(newSongIds, node->songIds, node->songIdCount * sizeof(int));
-			delete[] node->songIds;
-			node->songIds = newSongIds;
-			node->songIdCapacity = newCapacity;
-		}
-		node->songIds[node->songIdCount++] = songId;
-		return;
+		insertBKSongId(node, songId);
+		return node;
 	}
 
-	int distance = levenshteinDistance(word, node->word);
+	int distance = levenshteinDistance(word.c_str(), node->word);
 
 	BKNode *child = nullptr;
 	for (int i = 0; i < node->childrenCount; i++) {
@@ -44,53 +37,37 @@ void recursiveBKInsert(BKNode *node, string word, int songId) {
 	}
 
 	if (child != nullptr) {
-		recursiveBKInsert(child, word, songId);
-		return;
-	} else {
-		BKNode *newNode = createBKNode(word, songId);
-
-		if (node->childrenCount >= node->childrenCapacity) {
-			int newCapacity = node->childrenCapacity * 2;
-			BKChild *newChildren = new BKChild[newCapacity];
-			memcpy(newChildren, node->children, node->childrenCount * sizeof(BKChild));
-			delete[] node->children;
-			node->children = newChildren;
-			node->childrenCapacity = newCapacity;
-		}
-
-		node->children[node->childrenCount].distance = distance;
-		node->children[node->childrenCount++].node = newNode;
+		return recursiveBKInsert(child, word, songId);
 	}
+	child = createBKNode(word, songId);
+	addBKChild(node, distance, child);
+	return child;
 }
 
-int levenshteinDistance(string word, string target) {
-	int **dp = new int *[word.length() + 1];
-	for (size_t i = 0; i <= word.length(); i++) {
-		dp[i] = new int[target.length() + 1];
-	}
+// Dos filas de la tabla en la pila: las palabras del índice caben en 64 bytes
+// y esto se llama una vez por nodo visitado del BK-tree
+int levenshteinDistance(const char* word, const char* target) {
+	int wordLength = strnlen(word, 63);
+	int targetLength = strnlen(target, 63);
+	int previous[64];
+	int current[64];
 
-	for (size_t j = 0; j <= target.length(); j++) {
-		dp[0][j] = j;
+	for (int j = 0; j <= targetLength; j++) {
+		previous[j] = j;
 	}
-	for (size_t i = 0; i <= word.length(); i++) {
-		dp[i][0] = i;
-	}
-	for (size_t i = 1; i <= word.length(); i++) {
-		for (size_t j = 1; j <= target.length(); j++) {
+	for (int i = 1; i <= wordLength; i++) {
+		current[0] = i;
+		for (int j = 1; j <= targetLength; j++) {
 			if (word[i - 1] == target[j - 1]) {
-				dp[i][j] = dp[i - 1][j - 1];
+				current[j] = previous[j - 1];
 			} else {
-				dp[i][j] = 1 + std::min({ dp[i - 1][j], dp[i][j - 1], dp[i - 1][j - 1] });
+				current[j] = 1 + std::min({ previous[j], current[j - 1], previous[j - 1] });
 			}
 		}
+		memcpy(previous, current, sizeof(int) * (targetLength + 1));
 	}
 
-	int res = dp[word.length()][target.length()];
-
-	for (size_t i = 0; i <= word.length(); i++) delete[] dp[i];
-	delete[] dp;
-
-	return res;
+	return previous[targetLength];
 }
 
 BKNode *createBKNode(string word, int songId) {
@@ -107,25 +84,97 @@ BKNode *createBKNode(string word, int songId) {
 	return root;
 }
 
-void recursiveBKSearch(BKNode* node, string word, int tolerance, std::unordered_set<int>& idsFound){
-	int distance = levenshteinDistance(node->word, word);
+// ===== NODO CON TODOS SUS IDS (carga del árbol guardado) =====
+BKNode *createBKNodeWithIds(const char *word, const int *songIds, int count) {
+	BKNode *node = new BKNode;
+	node->songIdCapacity = count > 4 ? count : 4;
+	node->songIds = new int[node->songIdCapacity];
+	memcpy(node->songIds, songIds, count * sizeof(int));
+	node->songIdCount = count;
+	node->childrenCount = 0;
+	node->childrenCapacity = 5;
+	strncpy(node->word, word, sizeof(node->word) - 1);
+	node->word[sizeof(node->word) - 1] = '\0';
+	node->children = new BKChild[5];
+
+	return node;
+}
+
+void addBKChild(BKNode *node, int distance, BKNode *child) {
+	if (node->childrenCount >= node->childrenCapacity) {
+		int newCapacity = node->childrenCapacity * 2;
+		BKChild *newChildren = new BKChild[newCapacity];
+		memcpy(newChildren, node->children, node->childrenCount * sizeof(BKChild));
+		retireArray(node->children);
+		EPOCH_PUBLISH(node->children, newChildren);
+		node->childrenCapacity = newCapacity;
+	}
+
+	// El hijo se publica con el contador, ya completo
+	node->children[node->childrenCount].distance = distance;
+	node->children[node->childrenCount].node = child;
+	EPOCH_PUBLISH(node->childrenCount, node->childrenCount + 1);
+}
+
+void recursiveBKSearch(BKNode* node, string word, int tolerance, std::vector<int>& idsFound){
+	int distance = levenshteinDistance(node->word, word.c_str());
 
 	if (distance <= tolerance){
-		for (int i = 0; i < node->songIdCount; i++){
-			idsFound.insert(node->songIds[i]);
-		}
+		int songIdCount = EPOCH_LOAD(node->songIdCount);
+		int* songIds = EPOCH_LOAD(node->songIds);
+		idsFound.insert(idsFound.end(), songIds, songIds + songIdCount);
 	}
 
 	int minDistance = distance - tolerance;
 	int maxDistance = distance + tolerance;
 
-	for (int i = 0; i < node->childrenCount; i++){
-		int childDistance = node->children[i].distance;
+	int childrenCount = EPOCH_LOAD(node->childrenCount);
+	BKChild* children = EPOCH_LOAD(node->children);
+	for (int i = 0; i < childrenCount; i++){
+		int childDistance = children[i].distance;
 
 		if (childDistance >= minDistance && childDistance <= maxDistance){
-			recursiveBKSearch(node->children[i].node, word, tolerance, idsFound);
+			recursiveBKSearch(children[i].node, word, tolerance, idsFound);
+		}
+	}
+}
+
+void recursiveBKSearchWords(BKNode* node, const string& word, int tolerance, std::vector<string>& words){
+	int distance = levenshteinDistance(node->word, word.c_str());
+	if (distance <= tolerance){
+		words.push_back(node->word);
+	}
+
+	int childrenCount = EPOCH_LOAD(node->childrenCount);
+	BKChild* children = EPOCH_LOAD(node->children);
+	for (int i = 0; i < childrenCount; i++){
+		int childDistance = children[i].distance;
+		if (childDistance >= distance - tolerance && childDistance <= distance + tolerance){
+			recursiveBKSearchWords(children[i].node, word, tolerance, words);
+		}
+	}
+}
+
+BKNode* findBKWord(BKNode* root, string word) {
+	BKNode* node = EPOCH_LOAD(root);
+	while (node != nullptr) {
+		int distance = levenshteinDistance(word.c_str(), node->word);
+		if (distance == 0) {
+			return node;
+		}
+
+		int childrenCount = EPOCH_LOAD(node->childrenCount);
+		BKChild* children = EPOCH_LOAD(node->children);
+		BKNode* next = nullptr;
+		for (int i = 0; i < childrenCount; i++) {
+			if (children[i].distance == distance) {
+				next = children[i].node;
+				break;
+			}
 		}
+		node = next;
 	}
+	return nullptr;
 }
 
 void freeBKNode(BKNode* node) {
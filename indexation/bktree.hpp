@@ -1,7 +1,7 @@
 #pragma once
 
 #include <string>
-#include <unordered_set>
+#include <vector>
 
 using std::string;
 
@@ -24,17 +24,27 @@ struct BKNode{
     int childrenCapacity;
 };
 
-void insertWordBKTree(BKNode*& root, string word, int songId);
+// Devuelve el nodo de la palabra (para añadirle ids sin bajar desde la raíz)
+BKNode* insertWordBKTree(BKNode*& root, string word, int songId);
+void insertBKSongId(BKNode* node, int songId);
 
 
 // ===== FUNCIONES =====
 
 BKNode* createBKNode(string word, int songId);
+BKNode* createBKNodeWithIds(const char* word, const int* songIds, int count);
+void addBKChild(BKNode* node, int distance, BKNode* child);
 
 void freeBKNode(BKNode* node);
 
-void recursiveBKInsert(BKNode* node, string word, int songId);
+// Nodo con exactamente esa palabra (nullptr si no está)
+BKNode* findBKWord(BKNode* root, string word);
 
-int levenshteinDistance(string word1, string word2);
+BKNode* recursiveBKInsert(BKNode* node, string word, int songId);
 
-void recursiveBKSearch(BKNode* node, string word, int tolerance, std::unordered_set<int>& idsFound);
\ No newline at end of file
+int levenshteinDistance(const char* word1, const char* word2);
+
+// Añade a idsFound los ids de las palabras a distancia <= tolerance (sin ordenar)
+void recursiveBKSearch(BKNode* node, string word, int tolerance, std::vector<int>& idsFound);
+// Igual, pero añade las palabras en vez de sus ids
+void recursiveBKSearchWords(BKNode* node, const string& word, int tolerance, std::vector<string>& words);
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "checkpoint.hpp"
+#include "song_store.hpp"
+#include "song_wal.hpp"
+#include "../server/epoll_handler.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+int checkpointEpollFd = -1;
+pid_t checkpointPid = -1;
+int checkpointPipe = -1;
+bool checkpointReportedOk = false;
+long long checkpointStartMs = 0;
+
+static long long checkpointNowMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void initBackgroundCheckpoints(int epollFd) {
+	checkpointEpollFd = epollFd;
+}
+
+// ===== EN EL HIJO: escribir la foto y salir =====
+static void runCheckpointChild(SongDatabase *db, int progressFd) {
+	bool ok = saveDatabase(db, db->filepath.c_str(), progressFd);
+
+	SaveProgress done = {1, (uint8_t)ok, 0, 0};
+	if (write(progressFd, &done, sizeof(done)) != sizeof(done)) {
+		ok = false;
+	}
+	_exit(ok ? 0 : 1);
+}
+
+bool startBackgroundCheckpoint(SongDatabase *db) {
+	if (checkpointPid > 0) {
+		return false;
+	}
+	if (checkpointEpollFd < 0) {
+		return checkpointDatabase(db);
+	}
+
+	int fds[2];
+	if (pipe(fds) < 0) {
+		cerr << "[CHECKPOINT] No se pudo crear el pipe: " << strerror(errno) << endl;
+		return false;
+	}
+
+	// Lo registrado hasta aquí queda cubierto por la foto del fork
+	if (!rotateSongWal(db->wal)) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		// El .ckpt se queda: lo recoge el siguiente checkpoint o la carga
+		cerr << "[CHECKPOINT] fork falló: " << strerror(errno) << endl;
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		runCheckpointChild(db, fds[1]);
+	}
+
+	close(fds[1]);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	if (addToEpoll(checkpointEpollFd, fds[0], handleCheckpointEvent, nullptr) < 0) {
+		close(fds[0]);
+		waitpid(pid, nullptr, 0);
+		return false;
+	}
+
+	checkpointPid = pid;
+	checkpointPipe = fds[0];
+	checkpointReportedOk = false;
+	checkpointStartMs = checkpointNowMs();
+
+	cout << "[CHECKPOINT] Iniciado en segundo plano (pid " << pid << ", "
+		 << db->store->count << " canciones)" << endl;
+	return true;
+}
+
+// ===== FIN DEL HIJO: recoger el resultado =====
+static void finishBackgroundCheckpoint() {
+	removeFromEpoll(checkpointEpollFd, checkpointPipe);
+	close(checkpointPipe);
+	checkpointPipe = -1;
+
+	int status = 0;
+	waitpid(checkpointPid, &status, 0);
+	checkpointPid = -1;
+
+	bool ok = checkpointReportedOk && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	if (ok) {
+		finishSongWalCheckpoint(globalDB ? globalDB->wal : nullptr);
+		cout << "[CHECKPOINT] Completado en " << checkpointNowMs() - checkpointStartMs << " ms" << endl;
+	} else {
+		cerr << "[CHECKPOINT] Falló; el WAL rotado se conserva para el siguiente" << endl;
+	}
+}
+
+// ===== MENSAJES DEL HIJO (avance y resultado) =====
+void handleCheckpointEvent(int fd, void *data) {
+	SaveProgress messages[16];
+
+	while (true) {
+		ssize_t bytesRead = read(fd, messages, sizeof(messages));
+		if (bytesRead < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN) return;	// no hay más por ahora
+		}
+		if (bytesRead <= 0) {
+			finishBackgroundCheckpoint();
+			return;
+		}
+
+		for (size_t i = 0; i < bytesRead / sizeof(SaveProgress); i++) {
+			if (messages[i].done) {
+				checkpointReportedOk = messages[i].ok;
+			} else {
+				cout << "[CHECKPOINT] " << messages[i].bytesWritten / (1024 * 1024) << " / "
+					 << messages[i].totalBytes / (1024 * 1024) << " MiB" << endl;
+			}
+		}
+	}
+}
+
+void waitBackgroundCheckpoint() {
+	if (checkpointPid <= 0) {
+		return;
+	}
+
+	// Leer en bloqueante hasta el EOF del hijo
+	fcntl(checkpointPipe, F_SETFL, 0);
+	while (checkpointPid > 0) {
+		handleCheckpointEvent(checkpointPipe, nullptr);
+	}
+}
+
+// ===== CHECKPOINT EN EL MOMENTO: archivo completo + WAL vacío =====
+bool checkpointDatabase(SongDatabase *db) {
+	if (!db || db->filepath.empty()) {
+		return false;
+	}
+
+	// Los dos escriben el mismo archivo temporal
+	waitBackgroundCheckpoint();
+
+	if (!saveDatabase(db, db->filepath.c_str())) {
+		// El WAL sigue teniendo todo: no se pierde nada
+		flushSongWal(db->wal);
+		return false;
+	}
+
+	finishSongWalCheckpoint(db->wal);
+	resetSongWal(db->wal);
+	cout << "[CHECKPOINT] Checkpoint de " << db->store->count << " canciones" << endl;
+	return true;
+}
+
+void tickDatabaseWal() {
+	if (!globalDB || !globalDB->wal) {
+		return;
+	}
+
+	flushSongWal(globalDB->wal);
+	if (checkpointPid <= 0 && songWalNeedsCheckpoint(globalDB->wal)) {
+		startBackgroundCheckpoint(globalDB);
+	}
+}
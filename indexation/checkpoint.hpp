@@ -0,0 +1,23 @@
+#pragma once
+
+#include "database.hpp"
+
+// ===== CHECKPOINTS DE LA BASE DE DATOS =====
+// En marcha, el checkpoint lo escribe un proceso hijo (fork): ve una foto
+// copy-on-write de la base y el reactor sigue atendiendo mientras tanto.
+// El hijo informa del avance por un pipe registrado en epoll.
+
+// Activa los checkpoints en segundo plano (sin esto se hacen en el momento)
+void initBackgroundCheckpoints(int epollFd);
+
+// Lanza el checkpoint en segundo plano; false si ya hay uno o no se pudo
+bool startBackgroundCheckpoint(SongDatabase* db);
+void handleCheckpointEvent(int fd, void* data);
+// Espera a que termine el checkpoint en curso, si lo hay
+void waitBackgroundCheckpoint();
+
+// Reescribe el archivo con todo lo que hay en memoria y vacía el WAL (bloquea)
+bool checkpointDatabase(SongDatabase* db);
+
+// Tarea periódica: group commit del WAL y checkpoint cuando toca
+void tickDatabaseWal();
@@ -0,0 +1,272 @@
+#include "compaction.hpp"
+#include "bktree.hpp"
+#include "epoch.hpp"
+#include "inverted_index.hpp"
+#include "song_store.hpp"
+#include "trie.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// Filas muertas desde que empezó la pasada en curso
+vector<int> pendingSlots;
+unordered_set<uint32_t> pendingRewritten;
+
+// Pasada en curso: las palabras de sus filas muertas, una a una
+bool compactionRunning = false;
+vector<int> compactionSlots;
+vector<string> compactionWords;
+size_t compactionCursor = 0;
+long compactionRemoved = 0;
+long compactionUpdated = 0;             // postings de reescritas puestos al día
+vector<uint32_t> compactionIds;         // ordenados: las canciones de esas filas
+unordered_set<uint32_t> compactionRewritten;
+
+// Postings actuales de las canciones reescritas (se calculan una vez por pasada)
+unordered_map<uint32_t, vector<SongWordPosting>> currentPostingsCache;
+
+void noteDeadRow(SongDatabase* db, int slot, bool rewritten) {
+    pendingSlots.push_back(slot);
+    if (rewritten) {
+        uint32_t id = storeId(db->store, slot);
+        pendingRewritten.insert(id);
+        currentPostingsCache.erase(id);
+    }
+}
+
+void pendingDeadRows(vector<int>& slots) {
+    slots = pendingSlots;
+    if (compactionRunning) {
+        slots.insert(slots.end(), compactionSlots.begin(), compactionSlots.end());
+    }
+}
+
+void resetIndexCompaction() {
+    pendingSlots.clear();
+    pendingRewritten.clear();
+    compactionRunning = false;
+    compactionSlots.clear();
+    compactionWords.clear();
+    compactionCursor = 0;
+    compactionRemoved = 0;
+    compactionUpdated = 0;
+    compactionIds.clear();
+    compactionRewritten.clear();
+    currentPostingsCache.clear();
+}
+
+static void addTextWords(const char* text, unordered_set<string>& result) {
+    char words[50][64];
+    int wordCount = 0;
+    extractWords(text, words, &wordCount, 50);
+    for (int i = 0; i < wordCount; i++) {
+        result.insert(words[i]);
+    }
+}
+
+static const vector<SongWordPosting>& currentPostings(uint32_t id, const SongView& song) {
+    auto cached = currentPostingsCache.find(id);
+    if (cached != currentPostingsCache.end()) {
+        return cached->second;
+    }
+
+    vector<SongWordPosting>& result = currentPostingsCache[id];
+    result.resize(SONG_MAX_WORDS);
+    int titleWords, artistWords;
+    result.resize(songWordPostings(song.title, song.artist, result.data(), &titleWords,
+                                   &artistWords));
+    return result;
+}
+
+// ===== ¿SIGUE VALIENDO EL POSTING (word, id)? =====
+// Solo se mira la base para las canciones de la pasada; el resto valen. Si
+// la canción se reescribió y aún tiene la palabra, *current es su posting
+// con el texto actual (el UPDATE pudo dejar la freq y posiciones viejas)
+static bool postingIsLive(SongDatabase* db, const char* word, int id,
+                          const SongWordPosting** current) {
+    *current = nullptr;
+    if (!binary_search(compactionIds.begin(), compactionIds.end(), (uint32_t)id)) {
+        return true;
+    }
+    SongView song;
+    if (!getSongById(db, (uint32_t)id, &song)) {
+        return false;   // borrada
+    }
+    if (!compactionRewritten.count(id)) {
+        return true;
+    }
+    for (const SongWordPosting& posting : currentPostings(id, song)) {
+        if (strcmp(posting.word, word) == 0) {
+            *current = &posting;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ===== UNA PALABRA EN LAS TRES ESTRUCTURAS =====
+static void compactWord(SongDatabase* db, WordEntry* entry) {
+    string word = entry->word;
+    auto keep = [db, &word](int id) {
+        const SongWordPosting* current;
+        return postingIsLive(db, word.c_str(), id, &current);
+    };
+
+    // Lista ordenada comprimida: se reconstruye sin los ids que sobran y con
+    // los postings actuales de las reescritas
+    vector<int> ids;
+    vector<uint16_t> freqs;
+    vector<uint8_t> positions;
+    vector<uint32_t> offsets;
+    bool hasPositions = wordPostings(entry, ids, freqs, positions, offsets);
+    vector<uint8_t> keptPositions;
+    size_t kept = 0;
+    long updated = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        const SongWordPosting* current;
+        if (!postingIsLive(db, word.c_str(), ids[i], &current)) {
+            continue;
+        }
+        uint16_t freq = freqs[i];
+        const uint8_t* from = hasPositions ? positions.data() + offsets[i] : nullptr;
+        uint32_t bytes = hasPositions ? offsets[i + 1] - offsets[i] : 0;
+        if (current) {
+            bool samePositions = !hasPositions || (bytes == (uint32_t)current->positionBytes &&
+                                                   memcmp(from, current->positions, bytes) == 0);
+            if (current->freq != freq || !samePositions) {
+                updated++;
+            }
+            freq = current->freq;
+            if (hasPositions) {
+                from = current->positions;
+                bytes = current->positionBytes;
+            }
+        }
+        ids[kept] = ids[i];
+        freqs[kept] = freq;
+        if (hasPositions) {
+            keptPositions.insert(keptPositions.end(), from, from + bytes);
+        }
+        kept++;
+    }
+    if (kept < ids.size() || updated > 0) {
+        replaceWordPostings(entry, buildPostingList(ids.data(), freqs.data(),
+                                                    hasPositions ? keptPositions.data() : nullptr,
+                                                    keptPositions.size(), kept));
+        compactionRemoved += ids.size() - kept;
+        compactionUpdated += updated;
+    }
+
+    TrieNode* node = findTrieWord(db->trie, word);
+    if (node) {
+        compactionRemoved += removePublished(node->songIds, node->songIdCount,
+                                             node->songIdCapacity, keep);
+    }
+
+    BKNode* bkNode = entry->bkNode;
+    if (bkNode) {
+        compactionRemoved += removePublished(bkNode->songIds, bkNode->songIdCount,
+                                             bkNode->songIdCapacity, keep);
+    }
+}
+
+// ===== EMPEZAR UNA PASADA CON LAS FILAS MUERTAS PENDIENTES =====
+static void startCompaction(SongDatabase* db) {
+    compactionRunning = true;
+    compactionSlots.swap(pendingSlots);
+    pendingSlots.clear();
+    compactionRewritten.swap(pendingRewritten);
+    pendingRewritten.clear();
+    compactionCursor = 0;
+    compactionRemoved = 0;
+    compactionUpdated = 0;
+
+    unordered_set<string> words;
+    compactionIds.clear();
+    for (int slot : compactionSlots) {
+        compactionIds.push_back(storeId(db->store, slot));
+        addTextWords(storeText(db->store, slot, TEXT_TITLE), words);
+        addTextWords(storeText(db->store, slot, TEXT_ARTIST), words);
+    }
+    sort(compactionIds.begin(), compactionIds.end());
+    compactionIds.erase(unique(compactionIds.begin(), compactionIds.end()), compactionIds.end());
+    compactionWords.assign(words.begin(), words.end());
+
+    cout << "[COMPACT] Compactando índices (" << compactionSlots.size() << " filas muertas, "
+         << compactionWords.size() << " palabras)" << endl;
+}
+
+static void finishCompaction(SongDatabase* db) {
+    // Las reescritas otra vez durante la pasada pueden tener postings en
+    // palabras ya revisadas: siguen marcadas hasta la siguiente
+    for (uint32_t id : compactionRewritten) {
+        if (!pendingRewritten.count(id)) {
+            EPOCH_PUBLISH(db->staleById[id], (uint8_t)0);
+        }
+    }
+
+    // Menos postings cambian el IDF (y otra freq la puntuación): lo cacheado
+    // puntuaba con los de antes. Una vez por pasada, no por tick: a medias
+    // las consultas ya dan las mismas canciones
+    if (compactionRemoved + compactionUpdated > 0) {
+        bumpDatabaseGeneration(db);
+    }
+
+    cout << "[COMPACT] Índices compactados: " << compactionRemoved
+         << " postings eliminados, " << compactionUpdated << " actualizados" << endl;
+
+    compactionRunning = false;
+    compactionSlots.clear();
+    compactionWords.clear();
+    compactionIds.clear();
+    compactionRewritten.clear();
+    currentPostingsCache.clear();
+}
+
+bool compactIndexStep(SongDatabase* db, int maxWords) {
+    if (!db || !db->invertedIndex) {
+        return true;
+    }
+
+    if (!compactionRunning) {
+        if (pendingSlots.empty()) {
+            return true;
+        }
+        startCompaction(db);
+    }
+
+    // Una palabra muy común puede tener millones de postings: el tick
+    // también para por los que lleva descomprimidos
+    InvertedIndex* index = db->invertedIndex;
+    long postings = 0;
+    for (int words = 0; words < maxWords && postings < COMPACTION_POSTINGS_PER_TICK &&
+                        compactionCursor < compactionWords.size();
+         words++) {
+        WordEntry* entry = findWord(index, compactionWords[compactionCursor++].c_str());
+        if (entry) {
+            postings += wordPostingCount(entry);
+            compactWord(db, entry);
+        }
+    }
+
+    if (compactionCursor >= compactionWords.size()) {
+        finishCompaction(db);
+        return pendingSlots.empty();
+    }
+    return false;
+}
+
+void tickIndexCompaction() {
+    compactIndexStep(globalDB, COMPACTION_WORDS_PER_TICK);
+}
+
+// ===== FUSIÓN DE SEGMENTOS =====
+void tickSegmentMerges() {
+    mergePendingSegments(globalDB->invertedIndex, SEGMENT_MERGES_PER_TICK);
+}
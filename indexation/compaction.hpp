@@ -0,0 +1,42 @@
+#pragma once
+
+#include "database.hpp"
+#include <cstdint>
+#include <vector>
+
+// ===== COMPACTACIÓN DE LOS ÍNDICES =====
+// DELETE y UPDATE no tocan los postings al momento: la búsqueda filtra lo que
+// ya no vale y esta compactación lo va quitando desde el tick, unas cuantas
+// palabras cada vez, del índice invertido, el trie y el BK-tree a la vez.
+// Solo se revisan las palabras de las filas muertas (la borrada o la versión
+// vieja de un UPDATE siguen teniendo su título y artista), no el diccionario
+// entero. Los nodos del trie y del BK-tree se quedan aunque se vacíen (siguen
+// sirviendo de camino a los demás).
+
+// Palabras revisadas en cada tick, y como mucho estos postings entre todas
+#define COMPACTION_WORDS_PER_TICK 256
+#define COMPACTION_POSTINGS_PER_TICK (1 << 20)
+
+// La llama la base de datos al borrar (rewritten = false) o reescribir una
+// canción: slot es la fila que deja de valer
+void noteDeadRow(SongDatabase* db, int slot, bool rewritten);
+
+// Filas muertas cuyos postings siguen en los índices (se guardan con ellos
+// para no buscarlas al arrancar)
+void pendingDeadRows(std::vector<int>& slots);
+
+// Avanza la compactación hasta maxWords palabras; true si no queda nada pendiente
+bool compactIndexStep(SongDatabase* db, int maxWords);
+// Olvidar lo pendiente (al liberar la base)
+void resetIndexCompaction();
+
+// Tarea periódica sobre globalDB
+void tickIndexCompaction();
+
+// ===== FUSIÓN DE SEGMENTOS DE LOS POSTINGS =====
+// Las inserciones solo sellan segmentos; juntar los del mismo nivel (ver
+// postings.hpp) se hace aquí, unas cuantas palabras por tick
+#define SEGMENT_MERGES_PER_TICK 64
+
+// Tarea periódica sobre globalDB
+void tickSegmentMerges();
@@ -1,32 +1,79 @@
 #include "database.hpp"
 #include "bktree.hpp"
+#include "compaction.hpp"
+#include "epoch.hpp"
+#include "index_sections.hpp"
 #include "inverted_index.hpp"
+#include "query.hpp"
+#include "ranking.hpp"
+#include "result_cache.hpp"
 #include "trie.hpp"
+#include "url_index.hpp"
+#include "song_store.hpp"
+#include "song_wal.hpp"
+#include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <unordered_set>
+#include <vector>
 
 using namespace std;
 
+// ===== FORMATO v1 (sin estado), solo para migrar al cargar =====
+#pragma pack(1)
+struct SongV1 {
+  uint32_t id;
+  char title[256];
+  char artist[128];
+  char filename[256];
+  char url[512];
+  uint32_t duration;
+};
+#pragma pack()
+
+static const char *songURLBySlot(void *owner, int slot) {
+  SongStore *store = ((SongDatabase *)owner)->store;
+  if (slot < 0 || slot >= EPOCH_LOAD(store->count)) {
+    return nullptr;
+  }
+  return storeText(store, slot, TEXT_URL);
+}
+
 // ===== CREAR BASE DE DATOS VACÍA =====
 SongDatabase *createDatabase() {
   SongDatabase *db = new SongDatabase();
 
-  db->songCapacity = 100;
-  db->songs = new Song[db->songCapacity];
-  db->songCount = 0;
+  db->store = createSongStore();
   db->nextSongId = 1;
+  db->mappedFile = nullptr;
+  db->mappedSize = 0;
+  db->wal = nullptr;
+
+  db->slotByIdCapacity = 128;
+  db->slotByIdMapped = false;
+  db->slotById = new int[db->slotByIdCapacity];
+  memset(db->slotById, -1, sizeof(int) * db->slotByIdCapacity);
+  db->staleById = new uint8_t[db->slotByIdCapacity]();
+  db->wordCountsById = new uint16_t[db->slotByIdCapacity]();
+  db->rankedSongCount = 0;
+  db->titleWordTotal = 0;
+  db->artistWordTotal = 0;
 
   // ===== INICIALIZAR ÍNDICES =====
   db->invertedIndex = createInvertedIndex();
   db->trie = createTrie();
   db->bkTree = nullptr;
+  db->urlIndex = createUrlIndex(100, songURLBySlot, db);
+
+  db->generation = 0;
+  db->resultCache = createResultCache();
 
   cout << "[INFO] Base de datos creada (vacía) en RAM" << endl;
 
@@ -40,137 +87,997 @@ void freeDatabase(SongDatabase *db) {
   freeBKNode(db->bkTree);
   freeInvertedIndex(db->invertedIndex);
   freeTrie(db->trie);
-  delete[] db->songs;
+  freeUrlIndex(db->urlIndex);
+  freeResultCache(db->resultCache);
+  closeSongWal(db->wal);
+  freeSongStore(db->store);
+  if (db->mappedFile) {
+    munmap(db->mappedFile, db->mappedSize);
+  }
+  if (!db->slotByIdMapped) {
+    delete[] db->slotById;
+  }
+  delete[] db->staleById;
+  delete[] db->wordCountsById;
   delete db;
+  resetIndexCompaction();
+  // Sin lectores ya: lo retirado por los índices se puede liberar
+  drainRetiredMemory();
 }
 
 // ===== VERIFICAR URL DUPLICADA =====
+// Como ADD: una canción borrada ya no cuenta y una fallida se puede reintentar
+static bool urlTaken(SongDatabase *db, const char *url) {
+  int slot = findUrlIndex(db->urlIndex, url);
+  if (slot < 0) {
+    return false;
+  }
+  uint8_t state = storeState(db->store, slot);
+  return state != SONG_DELETED && state != SONG_FAILED;
+}
+
 bool isDuplicateURL(SongDatabase *db, const char *url) {
-  for (int i = 0; i < db->songCount; i++) {
-    cout << "song in db: " << db->songs[i].url << endl;
-    cout << "song to compare: " << url << endl;
-    if (strcmp(db->songs[i].url, url) == 0) {
-      return true;
-    }
+  EpochGuard guard;
+  return urlTaken(db, url);
+}
+
+void findDuplicateURLs(SongDatabase *db, const string *urls, int count, char *duplicates) {
+  EpochGuard guard;
+  for (int i = 0; i < count; i++) {
+    duplicates[i] = urlTaken(db, urls[i].c_str());
   }
-  return false;
 }
 
-long getSongOffsetInFile(SongDatabase *db, uint32_t id) {
-  // Encontrar índice de la canción
-  int index = -1;
-  for (int i = 0; i < db->songCount; i++) {
-    if (db->songs[i].id == id) {
-      index = i;
-      break;
+// ===== TABLA ID -> POSICIÓN =====
+// Los ids salen de nextSongId, así que son densos: un array directo basta
+static void setSongSlot(SongDatabase *db, uint32_t id, int slot) {
+  if (id >= (uint32_t)db->slotByIdCapacity) {
+    int newCapacity = db->slotByIdCapacity;
+    while ((uint32_t)newCapacity <= id) {
+      newCapacity *= 2;
+    }
+    int *newSlots = new int[newCapacity];
+    memcpy(newSlots, db->slotById, sizeof(int) * db->slotByIdCapacity);
+    memset(newSlots + db->slotByIdCapacity, -1,
+           sizeof(int) * (newCapacity - db->slotByIdCapacity));
+    uint8_t *newStale = new uint8_t[newCapacity]();
+    memcpy(newStale, db->staleById, db->slotByIdCapacity);
+    uint16_t *newWordCounts = new uint16_t[newCapacity]();
+    memcpy(newWordCounts, db->wordCountsById, sizeof(uint16_t) * db->slotByIdCapacity);
+
+    // Primero las tablas y después la capacidad: quien lea la capacidad nueva
+    // ya ve las tablas que la tienen. La mapeada vive lo que el archivo
+    if (db->slotByIdMapped) {
+      db->slotByIdMapped = false;
+    } else {
+      retireArray(db->slotById);
     }
+    retireArray(db->staleById);
+    retireArray(db->wordCountsById);
+    EPOCH_PUBLISH(db->slotById, newSlots);
+    EPOCH_PUBLISH(db->staleById, newStale);
+    EPOCH_PUBLISH(db->wordCountsById, newWordCounts);
+    EPOCH_PUBLISH(db->slotByIdCapacity, newCapacity);
   }
+  EPOCH_PUBLISH(db->slotById[id], slot);
+}
 
-  if (index < 0) {
-    return -1; // No encontrada
+// La tabla mapeada no se valida al cargar: cada posición se comprueba al leerla
+static int getSongSlot(SongDatabase *db, uint32_t id) {
+  if (id >= (uint32_t)EPOCH_LOAD(db->slotByIdCapacity)) {
+    return -1;
   }
+  int *slots = EPOCH_LOAD(db->slotById);
+  int slot = EPOCH_LOAD(slots[id]);
+  if (slot < 0 || slot >= EPOCH_LOAD(db->store->count) || storeId(db->store, slot) != id) {
+    return -1;
+  }
+  return slot;
+}
 
-  // Calcular offset: header + (índice × tamaño de Song)
-  long offset = sizeof(DatabaseHeader) + (index * sizeof(Song));
+// Igual, pero una canción borrada cuenta como inexistente
+static int getLiveSongSlot(SongDatabase *db, uint32_t id) {
+  int slot = getSongSlot(db, id);
+  if (slot >= 0 && storeState(db->store, slot) == SONG_DELETED) {
+    return -1;
+  }
+  return slot;
+}
 
-  return offset;
+static void fillSongView(SongDatabase *db, int slot, SongView *song) {
+  song->id = storeId(db->store, slot);
+  song->title = storeText(db->store, slot, TEXT_TITLE);
+  song->artist = storeText(db->store, slot, TEXT_ARTIST);
+  song->filename = storeText(db->store, slot, TEXT_FILENAME);
+  song->url = storeText(db->store, slot, TEXT_URL);
+  song->duration = storeDuration(db->store, slot);
+  song->state = storeState(db->store, slot);
 }
 
-void insertWordDatabase(SongDatabase *db, string word, uint32_t id) {
-  insertWordBKTree(db->bkTree, word, id);
+void insertWordDatabase(SongDatabase *db, string word, uint32_t id, uint16_t freq,
+                        const uint8_t *positions, int positionBytes) {
+  WordEntry *entry = insertWordIndex(db->invertedIndex, word, id, freq, positions, positionBytes);
+  if (!entry) {
+    return;
+  }
+  // Palabra ya en el BK-tree: su nodo está en la entrada, sin recorrer el árbol
+  if (entry->bkNode) {
+    insertBKSongId(entry->bkNode, id);
+  } else {
+    entry->bkNode = insertWordBKTree(db->bkTree, word, id);
+  }
   insertWordTrie(db->trie, word, id);
-  insertWordIndex(db->invertedIndex, word, id);
 }
 
-// ===== AÑADIR CANCIÓN =====
-int addSong(SongDatabase *db, Song songSent) {
-  if (db->songCount >= db->songCapacity) {
-    db->songCapacity *= 2;
-    Song *newSongs = new Song[db->songCapacity];
-    memcpy(newSongs, db->songs, sizeof(Song) * db->songCount);
-    delete[] db->songs;
-    db->songs = newSongs;
-  }
-
-  Song *songSave = &db->songs[db->songCount++];
-  memcpy(songSave->artist, songSent.artist, sizeof(songSent.artist));
-  cout << "[DEBUG DATABASE] artista que se va a guardar " << songSave->artist << endl;
-  memcpy(songSave->title, songSent.title, sizeof(songSent.title));
-  cout << "[DEBUG DATABASE] título que se va a guardar " << songSave->title << endl;
-  memcpy(songSave->filename, songSent.filename, sizeof(songSent.filename));
-  cout << "[DEBUG DATABASE] filename que se va a guardar " << songSave->filename << endl;
-  memcpy(songSave->url, songSent.url, sizeof(songSent.url));
-  cout << "[DEBUG DATABASE] url que se va a guardar " << songSave->url << endl;
-  songSave->duration = songSent.duration;
-  songSave->id = db->nextSongId++;
+// ===== LONGITUDES DE CAMPO PARA BM25 =====
+static void countSongWords(SongDatabase *db, uint32_t id, int titleWords, int artistWords) {
+  uint16_t counts = min(titleWords, 255) | min(artistWords, 255) << 8;
+  EPOCH_PUBLISH(db->wordCountsById[id], counts);
+  EPOCH_PUBLISH(db->titleWordTotal, db->titleWordTotal + (counts & 0xff));
+  EPOCH_PUBLISH(db->artistWordTotal, db->artistWordTotal + (counts >> 8));
+  EPOCH_PUBLISH(db->rankedSongCount, db->rankedSongCount + 1);
+}
 
-  // ===== INDEXAR TÍTULO =====
-  cout << "[INDEX] Indexando título: \"" << songSave->title << "\"..." << endl;
+// La canción deja de contar para las medias (borrada o a punto de reindexarse)
+static void uncountSongWords(SongDatabase *db, uint32_t id) {
+  uint16_t counts = db->wordCountsById[id];
+  EPOCH_PUBLISH(db->titleWordTotal, db->titleWordTotal - (counts & 0xff));
+  EPOCH_PUBLISH(db->artistWordTotal, db->artistWordTotal - (counts >> 8));
+  EPOCH_PUBLISH(db->rankedSongCount, db->rankedSongCount - 1);
+}
 
-  char words[100][64];
+// ¿Tenía ya la palabra un posting del id en los mismos campos?
+static bool keepsOldPosting(SongDatabase *db, const SongWordPosting *posting, uint32_t id) {
+  WordEntry *entry = findWord(db->invertedIndex, posting->word);
+  uint16_t freq;
+  if (!entry || !findWordPosting(entry, id, &freq)) {
+    return false;
+  }
+  return postingInField(freq, POSTING_FIELD_TITLE) ==
+             postingInField(posting->freq, POSTING_FIELD_TITLE) &&
+         postingInField(freq, POSTING_FIELD_ARTIST) ==
+             postingInField(posting->freq, POSTING_FIELD_ARTIST);
+}
+
+// ===== INDEXAR TÍTULO Y ARTISTA DE UNA CANCIÓN =====
+// rewritten: la canción ya estaba indexada (UPDATE). Sus palabras que ya la
+// tienen en los mismos campos no se tocan: reconstruir la lista entera para
+// cambiar la freq o las posiciones de un id viejo cuesta la lista, así que lo
+// hace la compactación de la fila vieja, y hasta entonces la canción está
+// marcada con postings viejos y se comprueba contra su texto actual
+static void indexSongWords(SongDatabase *db, const char *title, const char *artist, uint32_t id,
+                           bool rewritten) {
+  SongWordPosting postings[SONG_MAX_WORDS];
   int titleWordCount = 0;
   int artistWordCount = 0;
-  extractWords(songSave->title, words, &titleWordCount, 50);
-  extractWords(songSave->artist, words + titleWordCount, &artistWordCount, 50);
+  int count = songWordPostings(title, artist, postings, &titleWordCount, &artistWordCount);
+
+  for (int i = 0; i < count; i++) {
+    const SongWordPosting *posting = &postings[i];
+    if (rewritten && keepsOldPosting(db, posting, id)) {
+      continue;
+    }
+#if INDEX_POSITIONS
+    insertWordDatabase(db, posting->word, id, posting->freq, posting->positions,
+                       posting->positionBytes);
+#else
+    insertWordDatabase(db, posting->word, id, posting->freq, nullptr, 0);
+#endif
+  }
+  countSongWords(db, id, titleWordCount, artistWordCount);
+}
+
+// ===== AÑADIR CANCIÓN CON UN ID YA ASIGNADO (carga) =====
+static int appendSongWithId(SongDatabase *db, const Song &song, uint32_t id) {
+  const char *texts[SONG_TEXT_FIELDS];
+  texts[TEXT_TITLE] = song.title;
+  texts[TEXT_ARTIST] = song.artist;
+  texts[TEXT_FILENAME] = song.filename;
+  texts[TEXT_URL] = song.url;
+
+  int slot = appendSong(db->store, id, song.duration, song.state, texts);
+  setSongSlot(db, id, slot);
+  insertUrlIndex(db->urlIndex, storeText(db->store, slot, TEXT_URL), slot);
 
-  cout << "[INDEX] Palabras extraídas del título y artista: "
-       << titleWordCount + artistWordCount << endl;
+  if (id >= (uint32_t)db->nextSongId) {
+    db->nextSongId = id + 1;
+  }
+  return slot;
+}
 
-  for (int i = 0; i < titleWordCount + artistWordCount; i++) {
-    cout << "[INDEX]   - \"" << words[i] << "\"" << endl;
-    insertWordDatabase(db, words[i], songSave->id);
+// ===== AÑADIR CANCIÓN =====
+int addSong(SongDatabase *db, Song songSent) {
+  // Los campos de Song vienen de memoria ajena: asegurar el '\0'
+  songSent.title[sizeof(songSent.title) - 1] = '\0';
+  songSent.artist[sizeof(songSent.artist) - 1] = '\0';
+  songSent.filename[sizeof(songSent.filename) - 1] = '\0';
+  songSent.url[sizeof(songSent.url) - 1] = '\0';
+
+  uint32_t id = db->nextSongId;
+  int slot = appendSongWithId(db, songSent, id);
+
+  // Durable en el siguiente group commit del WAL
+  const char *texts[SONG_TEXT_FIELDS];
+  for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+    texts[field] = storeText(db->store, slot, field);
   }
-  cout << "[INFO] Canción añadida e indexada: [" << songSave->id << "] "
-       << songSave->title << " - " << songSave->artist << endl;
+  walAppendSong(db->wal, id, songSent.duration, songSent.state, texts);
+
+  // ===== INDEXAR TÍTULO =====
+  cout << "[INDEX] Indexando título: \"" << songSent.title << "\"..." << endl;
+  indexSongWords(db, songSent.title, songSent.artist, id, false);
+  bumpDatabaseGeneration(db);
+
+  cout << "[INFO] Canción añadida e indexada: [" << id << "] "
+       << songSent.title << " - " << songSent.artist << endl;
 
-  return songSave->id;
+  return id;
 }
 
 // ===== OBTENER CANCIÓN POR ID =====
-Song *getSongById(SongDatabase *db, uint32_t id) {
-  for (int i = 0; i < db->songCount; i++) {
-    if (db->songs[i].id == id) {
-      return &db->songs[i];
+bool getSongById(SongDatabase *db, uint32_t id, SongView *song) {
+  EpochGuard guard;
+  int slot = getLiveSongSlot(db, id);
+  if (slot < 0) {
+    return false;
+  }
+  fillSongView(db, slot, song);
+  return true;
+}
+
+// ===== OBTENER CANCIÓN POR URL =====
+bool getSongByURL(SongDatabase *db, const char *url, SongView *song) {
+  EpochGuard guard;
+  int slot = findUrlIndex(db->urlIndex, url);
+  if (slot < 0 || storeState(db->store, slot) == SONG_DELETED) {
+    return false;
+  }
+  fillSongView(db, slot, song);
+  return true;
+}
+
+bool setSongState(SongDatabase *db, uint32_t id, uint8_t state) {
+  int slot = getLiveSongSlot(db, id);
+  if (slot < 0) {
+    return false;
+  }
+  storeSetState(db->store, slot, state);
+  walSetState(db->wal, id, state);
+  return true;
+}
+
+// ===== BORRAR CANCIÓN (tombstone) =====
+// La fila y sus postings se quedan: la búsqueda la filtra por el estado y la
+// compactación quita los postings poco a poco
+bool deleteSong(SongDatabase *db, uint32_t id) {
+  int slot = getLiveSongSlot(db, id);
+  if (slot < 0) {
+    return false;
+  }
+  storeSetState(db->store, slot, SONG_DELETED);
+  walSetState(db->wal, id, SONG_DELETED);
+  uncountSongWords(db, id);
+  noteDeadRow(db, slot, false);
+  bumpDatabaseGeneration(db);
+
+  cout << "[INFO] Canción borrada: [" << id << "]" << endl;
+  return true;
+}
+
+// ===== REESCRIBIR UNA CANCIÓN EN UNA FILA NUEVA (mismo id) =====
+// Un lector ve la fila vieja o la nueva entera, nunca una mezcla; la vieja
+// queda como tombstone
+static int rewriteSong(SongDatabase *db, int slot, const char *title, const char *artist) {
+  uint32_t id = storeId(db->store, slot);
+
+  const char *texts[SONG_TEXT_FIELDS];
+  texts[TEXT_TITLE] = title;
+  texts[TEXT_ARTIST] = artist;
+  texts[TEXT_FILENAME] = storeText(db->store, slot, TEXT_FILENAME);
+  texts[TEXT_URL] = storeText(db->store, slot, TEXT_URL);
+
+  // Marcar antes de publicar la fila: quien la vea ya comprueba los postings
+  EPOCH_PUBLISH(db->staleById[id], (uint8_t)1);
+
+  int newSlot = appendSong(db->store, id, storeDuration(db->store, slot),
+                           storeState(db->store, slot), texts);
+  setSongSlot(db, id, newSlot);
+  insertUrlIndex(db->urlIndex, storeText(db->store, newSlot, TEXT_URL), newSlot);
+  storeSetState(db->store, slot, SONG_DELETED);
+
+  uncountSongWords(db, id);
+  indexSongWords(db, title, artist, id, true);
+  noteDeadRow(db, slot, true);
+  bumpDatabaseGeneration(db);
+  return newSlot;
+}
+
+// ===== CORREGIR TÍTULO / ARTISTA =====
+bool updateSong(SongDatabase *db, uint32_t id, const char *title, const char *artist) {
+  int slot = getLiveSongSlot(db, id);
+  if (slot < 0) {
+    return false;
+  }
+
+  Song song;
+  snprintf(song.title, sizeof(song.title), "%s",
+           title[0] ? title : storeText(db->store, slot, TEXT_TITLE));
+  snprintf(song.artist, sizeof(song.artist), "%s",
+           artist[0] ? artist : storeText(db->store, slot, TEXT_ARTIST));
+
+  int newSlot = rewriteSong(db, slot, song.title, song.artist);
+
+  const char *texts[SONG_TEXT_FIELDS];
+  for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+    texts[field] = storeText(db->store, newSlot, field);
+  }
+  walUpdateSong(db->wal, id, storeDuration(db->store, newSlot),
+                storeState(db->store, newSlot), texts);
+
+  cout << "[INFO] Canción corregida: [" << id << "] " << song.title << " - "
+       << song.artist << endl;
+  return true;
+}
+
+const char *songStateName(uint8_t state) {
+  switch (state) {
+  case SONG_AVAILABLE:
+    return "available";
+  case SONG_PENDING:
+    return "pending";
+  case SONG_FAILED:
+    return "failed";
+  case SONG_DELETED:
+    return "deleted";
+  }
+  return "unknown";
+}
+
+static bool writeAll(int fd, const void *data, size_t size) {
+  const char *bytes = (const char *)data;
+  size_t total = 0;
+  while (total < size) {
+    ssize_t written = write(fd, bytes + total, size - total);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    total += written;
+  }
+  return true;
+}
+
+static bool readAll(int fd, void *data, size_t size) {
+  char *bytes = (char *)data;
+  size_t total = 0;
+  while (total < size) {
+    ssize_t bytesRead = read(fd, bytes + total, size - total);
+    if (bytesRead < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (bytesRead == 0) {
+      return false;
+    }
+    total += bytesRead;
+  }
+  return true;
+}
+
+// Canciones por write()/read() al guardar y cargar
+#define SONG_IO_BATCH 256
+
+// Cada sección del archivo v3 empieza alineada (el mmap da páginas alineadas)
+#define SECTION_ALIGN 64
+
+static uint64_t alignSection(uint64_t offset) {
+  return (offset + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+// ===== FILAS QUE SE GUARDAN =====
+// Un tombstone cuyos postings ya quitó la compactación (canción borrada o
+// versión vieja de un UPDATE) no le sirve a nadie: el archivo se escribe sin
+// él y las demás filas se renumeran. Los que siguen pendientes se guardan,
+// la compactación necesita su título y artista después de cargar
+struct SavedRows {
+  vector<int> slots;      // filas que van al archivo, en orden
+  vector<int> newSlots;   // posición en el archivo de cada fila (-1 = no va)
+  uint64_t arenaBytes;
+};
+
+// Bytes del registro de texto de una fila (cada texto con su '\0')
+static uint64_t rowTextBytes(SongStore *store, int slot) {
+  const uint16_t *lengths = storeTextLengths(store, slot);
+  uint64_t bytes = 0;
+  for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+    bytes += lengths[field] + 1;
+  }
+  return bytes;
+}
+
+static void collectSavedRows(SongDatabase *db, SavedRows *rows) {
+  int count = db->store->count;
+  vector<char> pending(count, 0);
+  vector<int> deadSlots;
+  pendingDeadRows(deadSlots);
+  for (int slot : deadSlots) {
+    if (slot >= 0 && slot < count) {
+      pending[slot] = 1;
+    }
+  }
+
+  rows->slots.clear();
+  rows->newSlots.assign(count, -1);
+  rows->arenaBytes = 0;
+  for (int slot = 0; slot < count; slot++) {
+    if (storeState(db->store, slot) == SONG_DELETED && !pending[slot]) {
+      continue;
+    }
+    rows->newSlots[slot] = rows->slots.size();
+    rows->slots.push_back(slot);
+    rows->arenaBytes += rowTextBytes(db->store, slot);
+  }
+}
+
+// ===== POSICIÓN DE CADA SECCIÓN PARA LAS FILAS QUE SE GUARDAN =====
+static void computeLayout(SongDatabase *db, const SavedRows &rows, DatabaseHeader *header) {
+  uint64_t songs = rows.slots.size();
+
+  memset(header, 0, sizeof(DatabaseHeader));
+  memcpy(header->magic, "MUSI", 4);
+  header->version = DATABASE_VERSION;
+  header->numSongs = songs;
+  header->nextSongId = db->nextSongId;
+
+  header->offsetSongs = alignSection(sizeof(DatabaseHeader));
+  header->offsetDurations = alignSection(header->offsetSongs + songs * sizeof(uint32_t));
+  header->offsetStates = alignSection(header->offsetDurations + songs * sizeof(uint32_t));
+  header->offsetTextOffsets = alignSection(header->offsetStates + songs * sizeof(uint8_t));
+  header->offsetTextLengths = alignSection(header->offsetTextOffsets + songs * sizeof(uint64_t));
+  header->offsetArena = alignSection(header->offsetTextLengths +
+                                     songs * sizeof(uint16_t) * SONG_TEXT_FIELDS);
+  header->arenaBytes = rows.arenaBytes;
+}
+
+// Offset de los textos de la canción en el archivo que escribe saveDatabase
+// (recorre todas las filas: solo lo pide GET)
+long getSongOffsetInFile(SongDatabase *db, uint32_t id) {
+  int slot = getLiveSongSlot(db, id);
+
+  if (slot < 0) {
+    return -1; // No encontrada
+  }
+
+  SavedRows rows;
+  collectSavedRows(db, &rows);
+  DatabaseHeader header;
+  computeLayout(db, rows, &header);
+
+  uint64_t offset = header.offsetArena;
+  for (int i = 0; i < rows.newSlots[slot]; i++) {
+    offset += rowTextBytes(db->store, rows.slots[i]);
+  }
+  return offset;
+}
+
+// ===== CHECKSUM FNV-1a =====
+#define FNV_OFFSET_BASIS 2166136261u
+
+static uint32_t fnvBytes(uint32_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// ===== CHECKSUM DE UNA REGIÓN: FNV-1a de 64 bits por palabras de 8 bytes =====
+// Byte a byte, comprobar la arena costaría más que el resto de la carga. Se
+// alimenta por trozos de cualquier tamaño (la palabra a medias se guarda)
+struct RegionChecksum {
+  uint64_t hash;
+  unsigned char partial[8];
+  size_t partialBytes;
+};
+
+static void startRegionChecksum(RegionChecksum *checksum) {
+  checksum->hash = 14695981039346656037ull;
+  checksum->partialBytes = 0;
+}
+
+static void addRegionChecksum(RegionChecksum *checksum, const void *data, size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  uint64_t word;
+
+  while (size > 0 && checksum->partialBytes > 0) {
+    checksum->partial[checksum->partialBytes++] = *bytes++;
+    size--;
+    if (checksum->partialBytes == sizeof(word)) {
+      memcpy(&word, checksum->partial, sizeof(word));
+      checksum->hash = (checksum->hash ^ word) * 1099511628211ull;
+      checksum->partialBytes = 0;
     }
   }
-  return nullptr;
+  for (; size >= sizeof(word); bytes += sizeof(word), size -= sizeof(word)) {
+    memcpy(&word, bytes, sizeof(word));
+    checksum->hash = (checksum->hash ^ word) * 1099511628211ull;
+  }
+  memcpy(checksum->partial + checksum->partialBytes, bytes, size);
+  checksum->partialBytes += size;
+}
+
+static uint32_t finishRegionChecksum(RegionChecksum *checksum) {
+  for (size_t i = 0; i < checksum->partialBytes; i++) {
+    checksum->hash = (checksum->hash ^ checksum->partial[i]) * 1099511628211ull;
+  }
+  return (uint32_t)(checksum->hash ^ (checksum->hash >> 32));
+}
+
+static uint32_t regionChecksum(const char *data, size_t size) {
+  RegionChecksum checksum;
+  startRegionChecksum(&checksum);
+  addRegionChecksum(&checksum, data, size);
+  return finishRegionChecksum(&checksum);
+}
+
+// ===== ESCRITURA SECUENCIAL CON RELLENO ENTRE SECCIONES =====
+struct FileWriter {
+  int fd;
+  uint64_t position;
+  bool ok;
+
+  // Avance hacia quien hizo el fork (-1 = sin avisos)
+  int progressFd;
+  uint64_t totalBytes;
+  uint64_t lastReported;
+
+  // Checksum de la región que se está escribiendo (nullptr = ninguna)
+  RegionChecksum *checksum;
+};
+
+static void writeBytes(FileWriter *writer, const void *data, size_t size) {
+  if (!writer->ok) return;
+  writer->ok = writeAll(writer->fd, data, size);
+  writer->position += size;
+  if (writer->checksum) {
+    addRegionChecksum(writer->checksum, data, size);
+  }
+
+  if (writer->progressFd >= 0 && writer->position - writer->lastReported >= SAVE_PROGRESS_BYTES) {
+    SaveProgress progress = {0, 0, writer->position, writer->totalBytes};
+    writeAll(writer->progressFd, &progress, sizeof(progress));
+    writer->lastReported = writer->position;
+  }
+}
+
+// ===== CHECKSUM DEL HEADER =====
+static uint32_t headerChecksum(const DatabaseHeader &header, size_t size = sizeof(DatabaseHeader)) {
+  DatabaseHeader copy = header;
+  copy.headerChecksum = 0;
+  return fnvBytes(FNV_OFFSET_BASIS, &copy, size);
+}
+
+// Los v3 anteriores a los checksums de región lo calculaban sin esos campos
+static bool headerChecksumOk(const DatabaseHeader &header) {
+  if (header.headerChecksum == headerChecksum(header)) {
+    return true;
+  }
+  return header.songsChecksum == 0 && header.indexesChecksum == 0 &&
+         header.headerChecksum == headerChecksum(header, offsetof(DatabaseHeader, songsChecksum));
+}
+
+// ===== CHECKSUMS DE LAS REGIONES (file = archivo entero en memoria) =====
+// Solo se llama con las secciones ya comprobadas dentro del archivo
+static bool songsChecksumOk(const DatabaseHeader &header, const char *file) {
+  uint64_t end = header.offsetArena + header.arenaBytes;
+  return header.songsChecksum == 0 ||
+         regionChecksum(file + header.offsetSongs, end - header.offsetSongs) == header.songsChecksum;
+}
+
+static bool indexesChecksumOk(const DatabaseHeader &header, const char *file, size_t fileSize) {
+  return header.indexesChecksum == 0 ||
+         regionChecksum(file + header.offsetIndexes, fileSize - header.offsetIndexes) ==
+             header.indexesChecksum;
+}
+
+static void padTo(FileWriter *writer, uint64_t offset) {
+  static const char zeros[SECTION_ALIGN] = {0};
+  if (writer->position < offset) {
+    writeBytes(writer, zeros, offset - writer->position);
+  }
+}
+
+#define COLUMN_IDS          0
+#define COLUMN_DURATIONS    1
+#define COLUMN_STATES       2
+#define COLUMN_TEXT_OFFSETS 3
+#define COLUMN_TEXT_LENGTHS 4
+
+static void writeColumn(FileWriter *writer, SongStore *store, const SavedRows &rows, int column,
+                        uint64_t offset) {
+  padTo(writer, offset);
+
+  size_t bufferSize = SONG_IO_BATCH * sizeof(uint16_t) * SONG_TEXT_FIELDS;
+  char *buffer = new char[bufferSize];
+  int count = rows.slots.size();
+  uint64_t textOffset = 0;    // en la arena que se escribe, sin las filas que no van
+
+  for (int first = 0; writer->ok && first < count; first += SONG_IO_BATCH) {
+    int batchCount = min(SONG_IO_BATCH, count - first);
+    size_t size = 0;
+
+    for (int i = first; i < first + batchCount; i++) {
+      int slot = rows.slots[i];
+      switch (column) {
+      case COLUMN_IDS: {
+        uint32_t id = storeId(store, slot);
+        memcpy(buffer + size, &id, sizeof(id));
+        size += sizeof(id);
+        break;
+      }
+      case COLUMN_DURATIONS: {
+        uint32_t duration = storeDuration(store, slot);
+        memcpy(buffer + size, &duration, sizeof(duration));
+        size += sizeof(duration);
+        break;
+      }
+      case COLUMN_STATES:
+        buffer[size++] = storeState(store, slot);
+        break;
+      case COLUMN_TEXT_OFFSETS:
+        memcpy(buffer + size, &textOffset, sizeof(textOffset));
+        size += sizeof(textOffset);
+        textOffset += rowTextBytes(store, slot);
+        break;
+      case COLUMN_TEXT_LENGTHS:
+        memcpy(buffer + size, storeTextLengths(store, slot), sizeof(uint16_t) * SONG_TEXT_FIELDS);
+        size += sizeof(uint16_t) * SONG_TEXT_FIELDS;
+        break;
+      }
+    }
+
+    writeBytes(writer, buffer, size);
+  }
+
+  delete[] buffer;
+}
+
+// ===== ARENA: el registro de texto de cada fila que se guarda, seguidos =====
+// Texto a texto y no de un solo memcpy: una fila del archivo con el texto
+// corrupto se lee vacía (storeText) y se rellena hasta su longitud
+static void writeArena(FileWriter *writer, SongStore *store, const SavedRows &rows) {
+  size_t bufferSize = 64 * 1024;
+  char *buffer = new char[bufferSize];
+  size_t size = 0;
+
+  for (size_t i = 0; writer->ok && i < rows.slots.size(); i++) {
+    int slot = rows.slots[i];
+    if (size + rowTextBytes(store, slot) > bufferSize) {
+      writeBytes(writer, buffer, size);
+      size = 0;
+    }
+
+    const uint16_t *lengths = storeTextLengths(store, slot);
+    for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+      const char *text = storeText(store, slot, field);
+      size_t length = strnlen(text, lengths[field]);
+      memcpy(buffer + size, text, length);
+      memset(buffer + size + length, 0, lengths[field] + 1 - length);
+      size += lengths[field] + 1;
+    }
+  }
+  writeBytes(writer, buffer, size);
+
+  delete[] buffer;
+}
+
+// ===== RELEER LO ESCRITO ANTES DE SUSTITUIR EL ARCHIVO =====
+// Sin las páginas en caché, la lectura viene del disco
+static bool verifySavedFile(int fd, const DatabaseHeader &header, size_t fileSize) {
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  void *mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  const char *file = (const char *)mapped;
+  DatabaseHeader saved;
+  memcpy(&saved, file, sizeof(saved));
+  bool ok = memcmp(&saved, &header, sizeof(header)) == 0 && songsChecksumOk(header, file) &&
+            (header.offsetIndexes == 0 || indexesChecksumOk(header, file, fileSize));
+  munmap(mapped, fileSize);
+  return ok;
 }
 
 // ============================================
 // ===== GUARDAR A ARCHIVO BINARIO =====
 // ============================================
 
-bool saveDatabase(SongDatabase *db, const char *filepath) {
-  // Crear header
+bool saveDatabase(SongDatabase *db, const char *filepath, int progressFd) {
+  // Crear header para las filas que se guardan
+  SavedRows rows;
+  collectSavedRows(db, &rows);
   DatabaseHeader header;
-  memset(&header, 0, sizeof(DatabaseHeader));
+  computeLayout(db, rows, &header);
 
-  memcpy(header.magic, "MUSI", 4);
-  header.version = 1;
-  header.numSongs = db->songCount;
-  header.offsetSongs = sizeof(DatabaseHeader);
+  // Se escribe aparte y se renombra: el archivo actual puede estar mapeado
+  // (truncarlo daría SIGBUS) y así un corte a mitad no deja el catálogo roto
+  string tmpPath = string(filepath) + ".tmp";
+  int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    cerr << "[ERROR] No se pudo abrir " << tmpPath << ": " << strerror(errno) << endl;
+    return false;
+  }
+
+  FileWriter writer = {fd, 0, true, progressFd, 0, 0, nullptr};
 
-  // Abrir archivo
-  int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  // Índices serializados; si fallan, el header sale sin offsetIndexes y la
+  // siguiente carga los reconstruye
+  string indexSections;
+  if (!serializeIndexSections(db, rows.slots, rows.newSlots, indexSections)) {
+    indexSections.clear();
+  }
 
-  // Escribir header
-  write(fd, &header, sizeof(DatabaseHeader));
+  writer.totalBytes = header.offsetArena + header.arenaBytes;
+  if (!indexSections.empty()) {
+    header.offsetIndexes = alignSection(header.offsetArena + header.arenaBytes);
+    writer.totalBytes = header.offsetIndexes + indexSections.size();
+  }
 
-  // Escribir SOLO canciones
-  write(fd, db->songs, sizeof(Song) * db->songCount);
+  // El header se escribe otra vez al final, con los checksums de las regiones
+  writeBytes(&writer, &header, sizeof(DatabaseHeader));
+  padTo(&writer, header.offsetSongs);
+
+  // Escribir columnas
+  RegionChecksum songsChecksum;
+  startRegionChecksum(&songsChecksum);
+  writer.checksum = &songsChecksum;
+  writeColumn(&writer, db->store, rows, COLUMN_IDS, header.offsetSongs);
+  writeColumn(&writer, db->store, rows, COLUMN_DURATIONS, header.offsetDurations);
+  writeColumn(&writer, db->store, rows, COLUMN_STATES, header.offsetStates);
+  writeColumn(&writer, db->store, rows, COLUMN_TEXT_OFFSETS, header.offsetTextOffsets);
+  writeColumn(&writer, db->store, rows, COLUMN_TEXT_LENGTHS, header.offsetTextLengths);
+
+  // Escribir arena de texto
+  padTo(&writer, header.offsetArena);
+  writeArena(&writer, db->store, rows);
+
+  writer.checksum = nullptr;
+  header.songsChecksum = finishRegionChecksum(&songsChecksum);
+
+  // Escribir índices detrás de la arena
+  if (!indexSections.empty()) {
+    padTo(&writer, header.offsetIndexes);
+    header.indexesChecksum = regionChecksum(indexSections.data(), indexSections.size());
+    writeBytes(&writer, indexSections.data(), indexSections.size());
+  }
 
+  header.headerChecksum = headerChecksum(header);
+  if (writer.ok && pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+    writer.ok = false;
+  }
+  if (writer.ok && fdatasync(fd) < 0) {
+    writer.ok = false;
+  }
+  if (writer.ok && !verifySavedFile(fd, header, writer.position)) {
+    cerr << "[ERROR] Los checksums de " << tmpPath << " no coinciden al releerlo" << endl;
+    writer.ok = false;
+  }
   close(fd);
 
+  if (!writer.ok || rename(tmpPath.c_str(), filepath) < 0) {
+    cerr << "[ERROR] Escritura incompleta de " << filepath << ": " << strerror(errno) << endl;
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+// ===== SECCIÓN DENTRO DEL ARCHIVO =====
+static bool sectionFits(uint64_t offset, uint64_t size, size_t fileSize) {
+  return offset % SECTION_ALIGN == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+// ===== TABLAS id -> POSICIÓN Y URL -> POSICIÓN GUARDADAS =====
+// Solo sobre una base recién creada: nadie lee aún las tablas que se sustituyen
+static bool adoptSongTables(SongDatabase *db, char *sections, size_t size, uint32_t songCount) {
+  SongTableSections tables;
+  if (!findSongTableSections(sections, size, songCount, &tables) ||
+      !mapUrlIndex(db->urlIndex, tables.urlTable, tables.urlTableBytes, tables.urlCapacity,
+                   tables.urlCount)) {
+    return false;
+  }
+
+  delete[] db->slotById;
+  delete[] db->staleById;
+  delete[] db->wordCountsById;
+  db->slotById = tables.slotById;
+  db->slotByIdMapped = true;
+  db->slotByIdCapacity = tables.slotCount;
+  db->staleById = new uint8_t[db->slotByIdCapacity]();
+  db->wordCountsById = new uint16_t[db->slotByIdCapacity]();
+  return true;
+}
+
+// ===== ABRIR ARCHIVO v3 CON MMAP (sin leer ni copiar canciones) =====
+// Si las secciones de índice no cuadran con su checksum se quita
+// offsetIndexes del header y se reconstruyen desde las canciones
+static bool mapDatabaseFile(SongDatabase *db, int fd, DatabaseHeader &header) {
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    return false;
+  }
+  size_t fileSize = st.st_size;
+  uint64_t songs = header.numSongs;
+
+  if (!sectionFits(header.offsetSongs, songs * sizeof(uint32_t), fileSize) ||
+      !sectionFits(header.offsetDurations, songs * sizeof(uint32_t), fileSize) ||
+      !sectionFits(header.offsetStates, songs * sizeof(uint8_t), fileSize) ||
+      !sectionFits(header.offsetTextOffsets, songs * sizeof(uint64_t), fileSize) ||
+      !sectionFits(header.offsetTextLengths, songs * sizeof(uint16_t) * SONG_TEXT_FIELDS, fileSize) ||
+      !sectionFits(header.offsetArena, header.arenaBytes, fileSize)) {
+    cerr << "[ERROR] Secciones fuera del archivo" << endl;
+    return false;
+  }
+
+  // Privado y escribible: cambiar un estado copia solo esa página, el
+  // archivo no se toca hasta el siguiente saveDatabase
+  void *mapped = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    cerr << "[ERROR] mmap: " << strerror(errno) << endl;
+    return false;
+  }
+
+  // Columnas o arena dañadas: como con un header malo no se carga nada y el
+  // archivo, el WAL y el .ckpt se quedan como están
+  char *file = (char *)mapped;
+  if (!songsChecksumOk(header, file)) {
+    cerr << "[ERROR] Checksum de las columnas o la arena incorrecto" << endl;
+    munmap(mapped, fileSize);
+    return false;
+  }
+  if (header.offsetIndexes != 0 &&
+      (header.offsetIndexes >= fileSize || !indexesChecksumOk(header, file, fileSize))) {
+    cerr << "[WARNING] Checksum de los índices incorrecto, se reconstruyen" << endl;
+    header.offsetIndexes = 0;
+  }
 
+  SongStoreBase base;
+  base.count = header.numSongs;
+  base.ids = (const uint32_t *)(file + header.offsetSongs);
+  base.durations = (const uint32_t *)(file + header.offsetDurations);
+  base.states = (uint8_t *)(file + header.offsetStates);
+  base.textOffsets = (const uint64_t *)(file + header.offsetTextOffsets);
+  base.textLengths = (const uint16_t(*)[SONG_TEXT_FIELDS])(file + header.offsetTextLengths);
+  base.arena = file + header.offsetArena;
+  base.arenaBytes = header.arenaBytes;
+
+  // Los textos de cada fila se comprueban al leerla (storeText): recorrerlos
+  // aquí traería la arena entera a memoria
+  attachSongStoreBase(db->store, base);
+  db->mappedFile = mapped;
+  db->mappedSize = fileSize;
+
+  // Tablas id -> posición y URL -> posición: las guardadas se usan mapeadas;
+  // un archivo sin ellas se recorre entero una vez
+  if (header.offsetIndexes == 0 ||
+      !adoptSongTables(db, file + header.offsetIndexes, fileSize - header.offsetIndexes,
+                       header.numSongs)) {
+    cout << "[INFO] Sin tablas de posiciones guardadas, recorriendo las canciones" << endl;
+    for (int slot = 0; slot < db->store->count; slot++) {
+      uint32_t id = storeId(db->store, slot);
+      setSongSlot(db, id, slot);
+      insertUrlIndex(db->urlIndex, storeText(db->store, slot, TEXT_URL), slot);
+      if (id >= (uint32_t)db->nextSongId) {
+        db->nextSongId = id + 1;
+      }
+    }
+  }
+  if (header.nextSongId > (uint32_t)db->nextSongId) {
+    db->nextSongId = header.nextSongId;
+  }
   return true;
 }
 
+// ===== RECONSTRUIR ÍNDICES DE PALABRAS DESDE LAS CANCIONES =====
+static void rebuildIndexes(SongDatabase *db) {
+  // Puede quedar a medias una carga de secciones fallida
+  freeInvertedIndex(db->invertedIndex);
+  freeTrie(db->trie);
+  freeBKNode(db->bkTree);
+  db->invertedIndex = createInvertedIndex();
+  db->trie = createTrie();
+  db->bkTree = nullptr;
+  db->rankedSongCount = 0;
+  db->titleWordTotal = 0;
+  db->artistWordTotal = 0;
+
+  // Solo la fila actual de cada id (con la tabla mapeada, una fila con un id
+  // que la tabla no conoce tampoco cuenta)
+  for (int slot = 0; slot < db->store->count; slot++) {
+    uint32_t id = storeId(db->store, slot);
+    if (storeState(db->store, slot) == SONG_DELETED || getSongSlot(db, id) != slot) {
+      continue;
+    }
+    indexSongWords(db, storeText(db->store, slot, TEXT_TITLE),
+                   storeText(db->store, slot, TEXT_ARTIST), id, false);
+  }
+}
+
+// ===== FILAS MUERTAS CON POSTINGS EN LOS ÍNDICES GUARDADOS =====
+// El checkpoint guarda las que la compactación no había recogido; un archivo
+// sin esa lista se recorre entero una vez. Un tombstone que no es la fila
+// actual de su id es la versión vieja de un UPDATE
+static void notePendingDeadRows(SongDatabase *db, const char *sections, size_t size) {
+  vector<int> slots;
+  if (!loadDeadRowSection(sections, size, db->store->count, slots)) {
+    cout << "[INFO] Sin lista de filas muertas, buscándolas en todas las canciones" << endl;
+    slots.clear();
+    for (int slot = 0; slot < db->store->count; slot++) {
+      if (storeState(db->store, slot) == SONG_DELETED) {
+        slots.push_back(slot);
+      }
+    }
+  }
+
+  for (int slot : slots) {
+    if (slot < 0 || slot >= db->store->count || storeState(db->store, slot) != SONG_DELETED) {
+      continue;
+    }
+    uint32_t id = storeId(db->store, slot);
+    int current = getSongSlot(db, id);
+    bool rewritten = current >= 0 && current != slot;
+    if (rewritten) {
+      EPOCH_PUBLISH(db->staleById[id], (uint8_t)1);
+    }
+    noteDeadRow(db, slot, rewritten);
+  }
+}
+
+// ===== LEER REGISTROS Song DE v1/v2 =====
+static bool loadSongRecords(SongDatabase *db, int fd, const DatabaseHeader &header) {
+  if (header.version == 1) {
+    cout << "[INFO] Migrando base de datos v1 -> v" << DATABASE_VERSION << endl;
+  } else {
+    cout << "[INFO] Migrando base de datos v2 -> v" << DATABASE_VERSION << endl;
+  }
+
+  lseek(fd, header.offsetSongs, SEEK_SET);
+
+  size_t recordSize = header.version == 1 ? sizeof(SongV1) : sizeof(Song);
+  char *records = new char[recordSize * SONG_IO_BATCH];
+  bool ok = true;
+
+  for (uint32_t first = 0; ok && first < header.numSongs; first += SONG_IO_BATCH) {
+    uint32_t batchCount = min((uint32_t)SONG_IO_BATCH, header.numSongs - first);
+    ok = readAll(fd, records, recordSize * batchCount);
+
+    for (uint32_t i = 0; ok && i < batchCount; i++) {
+      Song song;
+      if (header.version == 1) {
+        // ===== MIGRAR v1: las canciones antiguas ya tenían el audio =====
+        memcpy(&song, records + i * recordSize, sizeof(SongV1));
+        song.state = SONG_AVAILABLE;
+      } else {
+        memcpy(&song, records + i * recordSize, sizeof(Song));
+      }
+      song.title[sizeof(song.title) - 1] = '\0';
+      song.artist[sizeof(song.artist) - 1] = '\0';
+      song.filename[sizeof(song.filename) - 1] = '\0';
+      song.url[sizeof(song.url) - 1] = '\0';
+      appendSongWithId(db, song, song.id);
+    }
+  }
+  delete[] records;
+  return ok;
+}
+
 // ============================================
 // ===== CARGAR DESDE ARCHIVO BINARIO (POSIX) =====
 // ===== CON FALLBACK A CREAR NUEVA =====
 // ============================================
 
-SongDatabase *loadDatabase(const char *filepath) {
+static SongDatabase *loadDatabaseFile(const char *filepath) {
   cout << "[DEBUG] ===== INICIO loadDatabase() =====" << endl;
   cout << "[DEBUG] Archivo: " << filepath << endl;
 
@@ -240,85 +1147,182 @@ SongDatabase *loadDatabase(const char *filepath) {
   cout << "[INFO] Versión: " << header.version << endl;
   cout << "[INFO] Canciones: " << header.numSongs << endl;
 
+  // Los v3 anteriores al checksum lo tienen a 0
+  if (header.version == DATABASE_VERSION && header.headerChecksum != 0 &&
+      !headerChecksumOk(header)) {
+    cerr << "[ERROR] Checksum del header incorrecto" << endl;
+    close(fd);
+    return nullptr;
+  }
+
+  if (header.version < 1 || header.version > DATABASE_VERSION) {
+    cerr << "[ERROR] Versión de base de datos no soportada: " << header.version << endl;
+    close(fd);
+    return nullptr;
+  }
+
   // ===== CREAR BASE DE DATOS =====
   SongDatabase *db = createDatabase();
 
   // ===== CARGAR CANCIONES =====
-  if (header.numSongs > 0) {
-    cout << "[DEBUG] Cargando " << header.numSongs << " canciones..." << endl;
-
-    lseek(fd, header.offsetSongs, SEEK_SET);
+  bool ok;
+  if (header.version == DATABASE_VERSION) {
+    ok = mapDatabaseFile(db, fd, header);
+  } else {
+    ok = loadSongRecords(db, fd, header);
+  }
+  close(fd);
 
-    size_t totalBytes = sizeof(Song) * header.numSongs;
-    bytes_read = read(fd, db->songs, totalBytes);
+  if (!ok) {
+    cerr << "[ERROR] No se pudieron cargar las canciones de " << filepath << endl;
+    freeDatabase(db);
+    return nullptr;
+  }
 
-    cout << "[DEBUG] Bytes leídos: " << bytes_read << " de " << totalBytes
-         << endl;
+  // ===== ÍNDICES: ADOPTAR LOS GUARDADOS O RECONSTRUIR =====
+  bool adopted = false;
+  const char *sections = nullptr;
+  size_t sectionBytes = 0;
+  if (header.version == DATABASE_VERSION && header.offsetIndexes != 0 &&
+      header.offsetIndexes < db->mappedSize) {
+    sections = (const char *)db->mappedFile + header.offsetIndexes;
+    sectionBytes = db->mappedSize - header.offsetIndexes;
+    adopted = loadIndexSections(db, sections, sectionBytes, header.numSongs);
+  }
 
-    if (bytes_read != (ssize_t)totalBytes) {
-      cerr << "[ERROR] No se pudieron leer todas las canciones" << endl;
-      delete[] db->songs;
-      delete db;
-      close(fd);
-      return nullptr;
-    }
+  if (!adopted) {
+    rebuildIndexes(db);
+    cout << "[INFO] Índices reconstruidos:" << endl;
+  } else {
+    notePendingDeadRows(db, sections, sectionBytes);
+    cout << "[INFO] Índices cargados del archivo:" << endl;
+  }
 
-    db->songCount = header.numSongs;
+  // Reescribir en v3 (con índices) para que el siguiente arranque ya use mmap
+  if (header.version != DATABASE_VERSION && !saveDatabase(db, filepath)) {
+    cerr << "[WARNING] No se pudo reescribir la base de datos en v" << DATABASE_VERSION << endl;
+  }
+  cout << "  - Palabras en index: " << db->invertedIndex->count << " ("
+       << invertedIndexMemory(db->invertedIndex) / 1024 << " KiB)" << endl;
+  cout << "  - Canciones mapeadas: " << db->store->base.count << " ("
+       << db->mappedSize / 1024 << " KiB)" << endl;
+  cout << "  - Memoria de canciones nuevas: " << songStoreMemory(db->store) / 1024 << " KiB" << endl;
+  return db;
+}
 
-    uint32_t maxId = 0;
-    for (int i = 0; i < db->songCount; i++) {
-      cout << "[DEBUG]   - Canción " << i << ": [" << db->songs[i].id << "] "
-           << db->songs[i].title << endl;
-      if (db->songs[i].id > maxId) {
-        maxId = db->songs[i].id;
-      }
+// ===== REPRODUCIR UN REGISTRO DEL WAL (idempotente: puede repetir lo que ya
+// llegó al archivo si el checkpoint no alcanzó a vaciar el WAL) =====
+static void replayWalRecord(void *owner, const WalRecordHeader &header,
+                            const char *texts[SONG_TEXT_FIELDS]) {
+  SongDatabase *db = (SongDatabase *)owner;
+  int slot = getSongSlot(db, header.songId);
+
+  if (header.kind == WAL_ADD_SONG && slot < 0) {
+    Song song;
+    memset(&song, 0, sizeof(Song));
+    strncpy(song.title, texts[TEXT_TITLE], sizeof(song.title) - 1);
+    strncpy(song.artist, texts[TEXT_ARTIST], sizeof(song.artist) - 1);
+    strncpy(song.filename, texts[TEXT_FILENAME], sizeof(song.filename) - 1);
+    strncpy(song.url, texts[TEXT_URL], sizeof(song.url) - 1);
+    song.duration = header.duration;
+    song.state = header.state;
+
+    appendSongWithId(db, song, header.songId);
+    indexSongWords(db, song.title, song.artist, header.songId, false);
+  } else if (header.kind == WAL_UPDATE_SONG && slot >= 0 &&
+             storeState(db->store, slot) != SONG_DELETED) {
+    // Ya aplicado si la fila actual tiene esos textos
+    if (strcmp(storeText(db->store, slot, TEXT_TITLE), texts[TEXT_TITLE]) != 0 ||
+        strcmp(storeText(db->store, slot, TEXT_ARTIST), texts[TEXT_ARTIST]) != 0) {
+      rewriteSong(db, slot, texts[TEXT_TITLE], texts[TEXT_ARTIST]);
+    }
+  } else if (header.kind == WAL_SET_STATE && slot >= 0) {
+    bool wasDeleted = storeState(db->store, slot) == SONG_DELETED;
+    storeSetState(db->store, slot, header.state);
+    if (header.state == SONG_DELETED && !wasDeleted) {
+      uncountSongWords(db, header.songId);
+      noteDeadRow(db, slot, false);
     }
-    db->nextSongId = maxId + 1;
+  }
+}
 
-  } 
+SongDatabase *loadDatabase(const char *filepath) {
+  SongDatabase *db = loadDatabaseFile(filepath);
+  if (!db) {
+    return nullptr;
+  }
 
-  close(fd);
+  // Lo añadido desde el último checkpoint está en el WAL
+  db->filepath = filepath;
+  db->wal = openSongWal((db->filepath + ".wal").c_str(), replayWalRecord, db);
+  if (!db->wal) {
+    cerr << "[WARNING] Sin WAL: las canciones nuevas solo se guardan al salir" << endl;
+  }
+  return db;
+}
 
-  // ===== CREAR ÍNDICES =====
-  cout << "[DEBUG] Índices creados (vacíos)" << endl;
+// ============================================
+// ===== BÚSQUEDA DE CANCIONES =====
+// ============================================
 
-  for (int i = 0; i < db->songCount; i++) {
-    Song *song = &db->songs[i];
+// ===== ¿SIGUE LA CANCIÓN COINCIDIENDO CON LA CONSULTA? =====
+bool songHasStalePostings(SongDatabase *db, uint32_t id) {
+  if (id >= (uint32_t)EPOCH_LOAD(db->slotByIdCapacity)) {
+    return false;
+  }
+  uint8_t *stale = EPOCH_LOAD(db->staleById);
+  return EPOCH_LOAD(stale[id]) != 0;
+}
 
-    char words[100][64];
-    int titleWordCount = 0;
-    int artistWordCount = 0;
-    extractWords(song->title, words, &titleWordCount, 50);
-    extractWords(song->artist, words + titleWordCount, &artistWordCount, 50);
+bool songMatchesText(SongDatabase *db, uint32_t id, const Query *query) {
+  int slot = getLiveSongSlot(db, id);
+  if (slot < 0) {
+    return false;
+  }
 
-    cout << "[INDEX] Palabras extraídas del título: " << titleWordCount << endl;
+  char words[100][64];
+  int titleWordCount = 0;
+  int artistWordCount = 0;
+  extractWords(storeText(db->store, slot, TEXT_TITLE), words, &titleWordCount, 50);
+  extractWords(storeText(db->store, slot, TEXT_ARTIST), words + titleWordCount,
+               &artistWordCount, 50);
+  return queryMatchesWords(query, words, titleWordCount, titleWordCount + artistWordCount);
+}
 
-    for (int i = 0; i < titleWordCount + artistWordCount; i++) {
-      cout << "[INDEX]   - \"" << words[i] << "\"" << endl;
-      insertWordDatabase(db, words[i], song->id);
-    }
+// Descarta tombstones; si un UPDATE cambió sus palabras, el posting puede ser
+// de las viejas y se comprueba la consulta contra el texto actual
+static bool songMatchesNow(SongDatabase *db, uint32_t id, const Query *query) {
+  if (getLiveSongSlot(db, id) < 0) {
+    return false;
   }
-  cout << "[INFO] Índices reconstruidos:" << endl;
-  cout << "  - Palabras en index: " << db->invertedIndex->count << endl;
-  return db;
+  return !songHasStalePostings(db, id) || songMatchesText(db, id, query);
 }
 
-// ============================================
-// ===== BÚSQUEDA DE CANCIONES =====
-// ============================================
+static void logResultCache(SongDatabase *db) {
+  ResultCacheStats stats;
+  resultCacheStats(db->resultCache, &stats);
+  uint64_t lookups = stats.hits + stats.misses;
+  cout << "[SEARCH] Caché: " << stats.hits << " aciertos de " << lookups << " ("
+       << (lookups ? stats.hits * 100 / lookups : 0) << "%), " << stats.stale
+       << " invalidadas, " << stats.entries << " entradas" << endl;
+}
 
-// mejorar esta función un montón
-SearchResult searchSongs(SongDatabase *db, const char *query) {
+// ===== BÚSQUEDA (sintaxis en query.hpp) =====
+SearchResult searchSongs(SongDatabase *db, const char *query, int limit) {
   SearchResult result;
   result.capacity = 100;
   result.songIds = new int[result.capacity];
   result.count = 0;
+  result.totalMatches = 0;
 
   if (!db || !query || query[0] == '\0') {
     cerr << "[ERROR] searchSongs: parámetros inválidos" << endl;
     return result;
   }
 
+  // Todo lo que se lea de los índices sigue vivo hasta salir de aquí
+  EpochGuard guard;
+
   // ===== VERIFICACIÓN CRÍTICA =====
   if (!db->invertedIndex) {
     cerr << "[ERROR] searchSongs: invertedIndex es NULL" << endl;
@@ -326,96 +1330,94 @@ SearchResult searchSongs(SongDatabase *db, const char *query) {
   }
 
   cout << "[SEARCH] Buscando: \"" << query << "\"" << endl;
-  // ===== DEBUG: ESTADO DE LOS ÍNDICES =====
-  cout << "[DEBUG] invertedIndex->count = " << db->invertedIndex->count << endl;
-
-  // Extraer palabras de la consulta
-  char queryWords[50][64];
-  int queryWordCount = 0;
-  extractWords(query, queryWords, &queryWordCount, 50);
-
-  cout << "[SEARCH] Palabras extraídas: " << queryWordCount << endl;
-  for (int i = 0; i < queryWordCount; i++) {
-    cout << "         - \"" << queryWords[i] << "\"" << endl;
-  }
-
-  // Set para evitar duplicados
-  unordered_set<int> foundIds;
-  unordered_set<int> trieIds;
-  unordered_set<int> bkTreeIds;
-
-  // ===== BUSCAR EN INDEX (exact match), TRIE (prefix) y BK-TREE (fuzzy) =====
-  for (int i = 0; i < queryWordCount; i++) {
-    const string q = queryWords[i];
-
-    cout << "[DEBUG] Buscando \"" << q << "\" en inverted index..." << endl;
-    WordEntry *entry = findWord(db->invertedIndex, q.c_str());
-    if (entry) {
-      cout << "[SEARCH] \"" << q << "\" encontrada en index: " << entry->count
-           << " canciones" << endl;
-      for (int j = 0; j < entry->count; j++) {
-        foundIds.insert(entry->songIds[j]);
-      }
-    } else {
-      cout << "[DEBUG] \"" << q << "\" NO encontrada en inverted index" << endl;
-    }
 
-    // Buscar por prefijo en el trie (autocompletar)
-    if (db->trie) {
-      cout << "[DEBUG] Buscando prefijos \"" << q << "\" en trie..." << endl;
-      searchPrefix(db->trie, q, trieIds);
-    } else {
-      cout << "[DEBUG] trie es NULL, omitiendo búsqueda por prefijo" << endl;
-    }
+  Query parsed;
+  if (!parseQuery(query, &parsed)) {
+    cout << "[SEARCH] Ninguna palabra que buscar" << endl;
+    return result;
+  }
 
-    // Búsqueda fuzzy en BK-tree (tolerancia = 2)
-    if (db->bkTree != nullptr) {
-      cout << "[DEBUG] Buscando fuzzy \"" << q << "\" en BK-tree..." << endl;
-      recursiveBKSearch(db->bkTree, q, 2, bkTreeIds);
-    } else {
-      cout << "[DEBUG] bkTree es NULL, omitiendo búsqueda fuzzy" << endl;
-    }
+  // ===== CACHÉ DE RESULTADOS =====
+  // La generación se lee antes de calcular: si la base cambia mientras tanto,
+  // lo que se guarde ya nace viejo
+  uint64_t generation = EPOCH_LOAD(db->generation);
+  char key[RESULT_CACHE_KEY_BYTES];
+  bool cacheable = resultCacheKey(&parsed, limit, key);
+  if (cacheable && lookupResultCache(db->resultCache, key, generation, &result)) {
+    cout << "[SEARCH] Desde la caché: " << result.count << " canciones" << endl;
+    logResultCache(db);
+    return result;
   }
 
-  // Fusionar resultados de trie y bk-tree en foundIds
-  if (!bkTreeIds.empty()) {
-    cout << "  ✅ Fuzzy encontró " << bkTreeIds.size() << " canciones" << endl;
-    for (int id : bkTreeIds)
-      foundIds.insert(id);
-  } else {
-    cout << "  ❌ Fuzzy no encontró resultados" << endl;
+  cout << "[SEARCH] " << parsed.clauseCount << " grupos AND:" << endl;
+  for (int i = 0; i < parsed.termCount; i++) {
+    const QueryTerm &term = parsed.terms[i];
+    cout << "         - \"" << term.word << "\""
+         << (term.clause < 0 ? " (NOT)" : term.exact ? " (exacta)" : "")
+         << (term.clause >= 0 ? " grupo " + to_string(term.clause) : "")
+         << (term.phrase >= 0 ? " frase " + to_string(term.phrase) : "")
+         << (term.field == POSTING_FIELD_TITLE    ? " (título)"
+             : term.field == POSTING_FIELD_ARTIST ? " (artista)"
+                                                  : "")
+         << endl;
   }
 
-  if (!trieIds.empty()) {
-    cout << "  ✅ Prefix encontró " << trieIds.size() << " canciones" << endl;
-    for (int id : trieIds)
-      foundIds.insert(id);
+  // ===== LAS MEJORES POR BM25 =====
+  // Con límite se sacan directamente de los postings, podando las que no
+  // pueden entrar (sin contar cuántas cumplían)
+  vector<ScoredSong> top;
+  if (searchTopSongs(db, &parsed, limit, songMatchesNow, top)) {
+    result.totalMatches = -1;
   } else {
-    cout << "  ❌ Prefix no encontró resultados" << endl;
-  }
-  // ===== CONVERTIR SET A ARRAY =====
-  for (int id : foundIds) {
-    if (result.count >= result.capacity) {
-      result.capacity *= 2;
-      int *newIds = new int[result.capacity];
-      memcpy(newIds, result.songIds, sizeof(int) * result.count);
-      delete[] result.songIds;
-      result.songIds = newIds;
+    vector<int> ids;
+    evaluateQuery(db, &parsed, ids);
+
+    // Sin borradas ni postings viejos
+    size_t kept = 0;
+    for (int id : ids) {
+      if (songMatchesNow(db, id, &parsed)) {
+        ids[kept++] = id;
+      }
     }
+    ids.resize(kept);
+    result.totalMatches = kept;
 
-    result.songIds[result.count++] = id;
+    rankSongs(db, &parsed, ids, limit, top);
   }
 
-  cout << "[SEARCH] Resultados totales: " << result.count << " canciones"
-       << endl;
+  if ((int)top.size() > result.capacity) {
+    delete[] result.songIds;
+    result.capacity = top.size();
+    result.songIds = new int[result.capacity];
+  }
+  for (const ScoredSong &song : top) {
+    result.songIds[result.count++] = song.id;
+  }
 
+  if (result.totalMatches >= 0) {
+    cout << "[SEARCH] Resultados totales: " << result.totalMatches << " canciones, devueltas "
+         << result.count << endl;
+  } else {
+    cout << "[SEARCH] Devueltas las " << result.count << " mejores (top-k podado)" << endl;
+  }
+
+  if (cacheable) {
+    storeResultCache(db->resultCache, key, generation, &result);
+    logResultCache(db);
+  }
   return result;
 }
 
 void indexSong(Song song) {
   // Verificar NUEVAMENTE que no exista (por seguridad)
-  if (isDuplicateURL(globalDB, song.url)) {
-    string response = "ERROR duplicate_url\n";
+  SongView existing;
+  if (getSongByURL(globalDB, song.url, &existing)) {
+    if (existing.state == SONG_FAILED) {
+      // Reintento de una descarga fallida: vuelve a quedar pendiente
+      setSongState(globalDB, existing.id, song.state);
+      cout << "[INDEX] Reintentando canción fallida: [" << existing.id << "]" << endl;
+      return;
+    }
     cout << "[INDEX] URL duplicada (doble verificación)" << endl;
     return;
   }
@@ -432,6 +1434,21 @@ void indexSong(Song song) {
        << song.title << " - " << song.artist << endl;
 }
 
+// ===== CAMBIAR ESTADO DEL AUDIO (pendiente -> disponible / fallida) =====
+void markSongState(const char *url, uint8_t state) {
+  SongView song;
+  if (!getSongByURL(globalDB, url, &song)) {
+    return;
+  }
+
+  setSongState(globalDB, song.id, state);
+  cout << "[INDEX] Canción [" << song.id << "] ahora " << songStateName(state) << endl;
+}
+
+void bumpDatabaseGeneration(SongDatabase *db) {
+  EPOCH_PUBLISH(db->generation, db->generation + 1);
+}
+
 void freeSearchResult(SearchResult *result) {
   if (result && result->songIds) {
     delete[] result->songIds;
@@ -439,4 +1456,4 @@ void freeSearchResult(SearchResult *result) {
     result->count = 0;
     result->capacity = 0;
   }
-}
\ No newline at end of file
+}
@@ -1,15 +1,39 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
 struct BKNode;
 struct InvertedIndex;
+struct Query;
+struct ResultCache;
 struct Trie;
+struct UrlIndex;
+struct SongStore;
+struct SongWal;
 
 using std::string;
 
+// ===== VERSIÓN DEL ARCHIVO =====
+// v1: Song sin estado
+// v2: Song con estado de disponibilidad del audio
+// v3: columnas + arena de texto, pensadas para usarse con mmap sin copiar
+#define DATABASE_VERSION 3
+
+// ===== POSICIONES EN LOS POSTINGS (frases) =====
+// 1 = cada posting guarda en qué palabra del título/artista sale la palabra;
+// 0 = índice más pequeño y las frases se comprueban contra el texto
+#define INDEX_POSITIONS 1
+
+// ===== ESTADO DEL AUDIO DE UNA CANCIÓN =====
+#define SONG_AVAILABLE 0    // audio descargado
+#define SONG_PENDING   1    // indexada con metadatos, audio en descarga
+#define SONG_FAILED    2    // la descarga del audio falló
+#define SONG_DELETED   3    // borrada (tombstone): no se devuelve en consultas
+
 // ===== ESTRUCTURA DE CANCIÓN =====
+// Registro de entrada (metadatos de un worker) y formato en disco de v2
 #pragma pack(1)
 struct Song {
     uint32_t id;
@@ -18,6 +42,7 @@ struct Song {
     char filename[256];
     char url[512];
     uint32_t duration;
+    uint8_t state;
 };
 #pragma pack()
 
@@ -27,17 +52,86 @@ struct DatabaseHeader {
     char magic[4];
     uint32_t version;
     uint32_t numSongs;
-    uint64_t offsetSongs;
-    char reserved[64];
+    uint64_t offsetSongs;           // v1/v2: registros Song; v3: columna de ids
+
+    // ===== v3: resto de secciones (en v1/v2 era espacio reservado) =====
+    uint64_t offsetDurations;
+    uint64_t offsetStates;
+    uint64_t offsetTextOffsets;
+    uint64_t offsetTextLengths;
+    uint64_t offsetArena;
+    uint64_t arenaBytes;
+    uint32_t nextSongId;
+    uint64_t offsetIndexes;         // secciones de índice (0 = no guardadas)
+    uint32_t headerChecksum;        // FNV-1a del header (este campo = 0)
+
+    // ===== checksums FNV-1a de cada región (0 = archivo anterior sin ellos) =====
+    uint32_t songsChecksum;         // columnas y arena, con el relleno entre ellas
+    uint32_t indexesChecksum;       // secciones de índice enteras
+};
+#pragma pack()
+
+// ===== AVANCE DE UN GUARDADO (checkpoint en segundo plano) =====
+#define SAVE_PROGRESS_BYTES (4 * 1024 * 1024)
+
+#pragma pack(1)
+struct SaveProgress {
+    uint8_t done;               // 1 = último mensaje, ok dice si salió bien
+    uint8_t ok;
+    uint64_t bytesWritten;
+    uint64_t totalBytes;
 };
 #pragma pack()
 
+// ===== VISTA DE UNA CANCIÓN (apunta al almacén, no copia) =====
+// Los bloques de la arena no se mueven ni se retiran nunca, así que los
+// punteros siguen siendo válidos aunque el escritor siga añadiendo canciones
+struct SongView {
+    uint32_t id;
+    const char* title;
+    const char* artist;
+    const char* filename;
+    const char* url;
+    uint32_t duration;
+    uint8_t state;
+};
+
 // ===== ESTRUCTURA PRINCIPAL =====
+// Un solo escritor (el reactor); las consultas pueden ir desde otros hilos
+// sin locks, cada una dentro de su EpochGuard (ver epoch.hpp)
 struct SongDatabase {
-    Song* songs;
-    int songCount;
-    int songCapacity;
+    // Canciones en columnas + arena de texto (Song solo es el formato en disco)
+    SongStore* store;
     int nextSongId;
+
+    // Archivo v3 mapeado: base de solo lectura del almacén (nullptr si no hay)
+    void* mappedFile;
+    size_t mappedSize;
+
+    // Archivo de la base y su WAL (altas y cambios de estado desde el último checkpoint)
+    string filepath;
+    SongWal* wal;
+
+    // Tabla densa id -> posición en songs (-1 = no existe); la de un archivo
+    // v3 se usa mapeada (slotByIdMapped) hasta que crece
+    int* slotById;
+    int slotByIdCapacity;
+    bool slotByIdMapped;
+    // Misma capacidad: 1 = un UPDATE cambió sus palabras y puede quedar algún
+    // posting viejo (la búsqueda lo comprueba hasta que pase la compactación)
+    uint8_t* staleById;
+    // Misma capacidad: palabras indexadas de la canción, título en el byte
+    // bajo y artista en el alto (para las longitudes medias de BM25; cada
+    // posting lleva las suyas)
+    uint16_t* wordCountsById;
+
+    // Suma de esas longitudes sobre las canciones vivas (para las medias)
+    int rankedSongCount;
+    uint64_t titleWordTotal;
+    uint64_t artistWordTotal;
+
+    // URL -> posición, para detectar duplicados en O(1)
+    UrlIndex* urlIndex;
     
     // Índices de títulos
     InvertedIndex* invertedIndex;
@@ -46,13 +140,22 @@ struct SongDatabase {
     BKNode* bkTree;
 
     Trie* trie;
+
+    // Sube con cada cambio que puede alterar una búsqueda (alta, borrado,
+    // corrección, compactación): la caché descarta lo de generaciones viejas
+    uint64_t generation;
+    ResultCache* resultCache;
 };
 
 // ===== RESULTADO DE BÚSQUEDA =====
+// Canciones devueltas por SEARCH: las mejores por BM25, de mayor a menor
+#define SEARCH_DEFAULT_LIMIT 50
+
 struct SearchResult {
-    int* songIds;
+    int* songIds;       // ordenados por puntuación
     int count;
     int capacity;
+    int totalMatches;   // cuántas cumplían la consulta antes de quedarse con las mejores (-1 = no se contaron)
 };
 
 extern SongDatabase* globalDB;
@@ -66,20 +169,43 @@ void freeDatabase(SongDatabase* db);
 // Añadir canción
 int addSong(SongDatabase* db, Song song);
 
-// Verificar duplicados
+// Verificar duplicados; el lote (ADDLIST) se consulta en una sola lectura y
+// deja duplicates[i] a 1 si urls[i] ya está
 bool isDuplicateURL(SongDatabase* db, const char* url);
-
-// Obtener canción por ID
-Song* getSongById(SongDatabase* db, uint32_t id);
+void findDuplicateURLs(SongDatabase* db, const string* urls, int count, char* duplicates);
+
+// Obtener canción por ID / URL (false si no existe)
+bool getSongById(SongDatabase* db, uint32_t id, SongView* song);
+bool getSongByURL(SongDatabase* db, const char* url, SongView* song);
+bool setSongState(SongDatabase* db, uint32_t id, uint8_t state);
+
+// Borrar / corregir título y artista (false si no existe; "" = no cambiar).
+// Los postings viejos los filtra la búsqueda y los quita la compactación
+bool deleteSong(SongDatabase* db, uint32_t id);
+bool updateSong(SongDatabase* db, uint32_t id, const char* title, const char* artist);
+const char* songStateName(uint8_t state);
 long getSongOffsetInFile(SongDatabase* db, uint32_t id);
 
 // ===== BÚSQUEDA =====
-SearchResult searchSongs(SongDatabase* db, const char* query);
+// AND/OR/NOT, palabras exactas, frases y campos (ver query.hpp); las
+// limit mejores por BM25 (limit <= 0: todas, también ordenadas)
+SearchResult searchSongs(SongDatabase* db, const char* query, int limit = SEARCH_DEFAULT_LIMIT);
+// true si un UPDATE dejó postings viejos de esa canción sin compactar
+bool songHasStalePostings(SongDatabase* db, uint32_t id);
+// ¿Cumplen la consulta el título y el artista actuales? (false si está borrada)
+bool songMatchesText(SongDatabase* db, uint32_t id, const Query* query);
 void freeSearchResult(SearchResult* result);
+// Después de cambiar lo que puede devolver una búsqueda (invalida la caché)
+void bumpDatabaseGeneration(SongDatabase* db);
 
 // ===== PERSISTENCIA =====
-bool saveDatabase(SongDatabase* db, const char* filepath);
+// Con progressFd >= 0 se informa del avance con mensajes SaveProgress
+bool saveDatabase(SongDatabase* db, const char* filepath, int progressFd = -1);
 SongDatabase* loadDatabase(const char* filepath);
 void indexSong(Song song);
+void markSongState(const char* url, uint8_t state);
 
-void insertWordDatabase(SongDatabase* db, string word, uint32_t id);
\ No newline at end of file
+// freq: veces en título y artista (makePostingFreq de postings.hpp);
+// positions: encodePostingPositions (nullptr si INDEX_POSITIONS es 0)
+void insertWordDatabase(SongDatabase* db, string word, uint32_t id, uint16_t freq,
+                        const uint8_t* positions, int positionBytes);
\ No newline at end of file
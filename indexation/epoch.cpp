@@ -0,0 +1,142 @@
+#include "epoch.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Época anunciada por cada hilo lector (0 = fuera de toda lectura); una línea
+// de caché por hilo para que los lectores no se estorben entre sí. Un hilo
+// que termina deja su hueco libre para el siguiente
+struct alignas(64) EpochSlot {
+    uint64_t epoch;
+    uint8_t used;
+};
+
+struct RetiredMemory {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;
+};
+
+static EpochSlot epochSlots[EPOCH_MAX_READERS];
+static int epochSlotsUsed = 0;      // huecos que ha llegado a haber ocupados a la vez
+static uint64_t globalEpoch = 1;
+static vector<RetiredMemory> retiredList;
+
+// ===== HUECO DEL HILO =====
+// Se devuelve al terminar el hilo (destructor thread_local)
+struct ThreadEpochSlot {
+    int index = -1;
+    ~ThreadEpochSlot() {
+        if (index >= 0) {
+            __atomic_store_n(&epochSlots[index].epoch, 0, __ATOMIC_RELEASE);
+            __atomic_store_n(&epochSlots[index].used, 0, __ATOMIC_RELEASE);
+        }
+    }
+};
+
+static thread_local ThreadEpochSlot threadSlot;
+static thread_local int threadDepth = 0;
+
+static int claimEpochSlot() {
+    for (int i = 0; i < EPOCH_MAX_READERS; i++) {
+        uint8_t expected = 0;
+        if (__atomic_compare_exchange_n(&epochSlots[i].used, &expected, 1, false, __ATOMIC_SEQ_CST,
+                                        __ATOMIC_RELAXED)) {
+            // El escritor recorre hasta epochSlotsUsed: subirlo antes de anunciar época
+            int used = __atomic_load_n(&epochSlotsUsed, __ATOMIC_SEQ_CST);
+            while (used <= i && !__atomic_compare_exchange_n(&epochSlotsUsed, &used, i + 1, false,
+                                                             __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            }
+            return i;
+        }
+    }
+    cerr << "[EPOCH] Demasiados hilos lectores a la vez (máx " << EPOCH_MAX_READERS << ")" << endl;
+    abort();
+}
+
+// ===== LECTORES =====
+void epochEnter() {
+    if (threadDepth++ > 0) {
+        return;
+    }
+
+    if (threadSlot.index < 0) {
+        threadSlot.index = claimEpochSlot();
+    }
+    int slot = threadSlot.index;
+
+    // Anunciar la época y comprobar que no avanzó mientras tanto: si avanzó,
+    // el escritor pudo no ver el anuncio y hay que repetirlo con la nueva
+    uint64_t epoch = __atomic_load_n(&globalEpoch, __ATOMIC_ACQUIRE);
+    while (true) {
+        __atomic_store_n(&epochSlots[slot].epoch, epoch, __ATOMIC_SEQ_CST);
+        uint64_t current = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST);
+        if (current == epoch) {
+            break;
+        }
+        epoch = current;
+    }
+}
+
+void epochExit() {
+    if (--threadDepth > 0) {
+        return;
+    }
+    __atomic_store_n(&epochSlots[threadSlot.index].epoch, 0, __ATOMIC_RELEASE);
+}
+
+// ===== ESCRITOR =====
+void retireMemory(void* ptr, void (*deleter)(void*)) {
+    RetiredMemory retired;
+    retired.ptr = ptr;
+    retired.deleter = deleter;
+    retired.epoch = __atomic_load_n(&globalEpoch, __ATOMIC_ACQUIRE);
+    retiredList.push_back(retired);
+}
+
+void reclaimRetiredMemory() {
+    uint64_t epoch = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST);
+
+    // Solo se avanza si ningún lector sigue en una época anterior
+    bool canAdvance = true;
+    int slots = __atomic_load_n(&epochSlotsUsed, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < slots && i < EPOCH_MAX_READERS; i++) {
+        if (!__atomic_load_n(&epochSlots[i].used, __ATOMIC_SEQ_CST)) {
+            continue;   // hueco libre: su hilo ya terminó
+        }
+        uint64_t readerEpoch = __atomic_load_n(&epochSlots[i].epoch, __ATOMIC_SEQ_CST);
+        if (readerEpoch != 0 && readerEpoch != epoch) {
+            canAdvance = false;
+            break;
+        }
+    }
+    if (canAdvance) {
+        epoch++;
+        __atomic_store_n(&globalEpoch, epoch, __ATOMIC_SEQ_CST);
+    }
+
+    // Retirado en la época e: los lectores que pudieron verlo entraron en <= e,
+    // y la época no llega a e + 2 hasta que todos ellos han salido
+    size_t kept = 0;
+    for (size_t i = 0; i < retiredList.size(); i++) {
+        if (retiredList[i].epoch + 2 <= epoch) {
+            retiredList[i].deleter(retiredList[i].ptr);
+        } else {
+            retiredList[kept++] = retiredList[i];
+        }
+    }
+    retiredList.resize(kept);
+}
+
+void drainRetiredMemory() {
+    for (auto& retired : retiredList) {
+        retired.deleter(retired.ptr);
+    }
+    retiredList.clear();
+}
+
+size_t retiredMemoryCount() {
+    return retiredList.size();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ===== RECLAMACIÓN DE MEMORIA POR ÉPOCAS =====
+// Un solo escritor (el hilo del reactor) y cualquier número de hilos lectores
+// sin locks. El escritor nunca modifica en sitio lo que un lector puede estar
+// recorriendo: rellena el elemento nuevo y después publica el contador; si un
+// array tiene que crecer, publica la copia y retira el viejo, que se libera
+// cuando ningún lector puede seguir dentro de la época en la que era visible.
+
+// Hilos lectores vivos a la vez (el hueco de un hilo se reutiliza cuando termina)
+#define EPOCH_MAX_READERS 64
+
+// Punteros y contadores compartidos con los lectores
+#define EPOCH_LOAD(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define EPOCH_PUBLISH(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+
+// ===== LECTORES =====
+// Todo acceso de lectura va entre epochEnter y epochExit (se pueden anidar)
+void epochEnter();
+void epochExit();
+
+struct EpochGuard {
+    EpochGuard() { epochEnter(); }
+    ~EpochGuard() { epochExit(); }
+};
+
+// ===== ESCRITOR =====
+// Liberar ptr con deleter cuando ya ningún lector pueda tenerlo
+void retireMemory(void* ptr, void (*deleter)(void*));
+
+template <typename T>
+void retireArray(T* ptr) {
+    if (ptr) retireMemory(ptr, [](void* p) { delete[] (T*)p; });
+}
+
+// Quitar de un array publicado (items/count) los elementos que no cumplan
+// keep. Los que quedan van delante en una copia del mismo tamaño y los
+// quitados detrás, así un lector con el contador viejo sigue viendo todos los
+// de antes. Devuelve cuántos se quitaron.
+template <typename T, typename Keep>
+int removePublished(T*& items, int& count, int& capacity, Keep keep) {
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (keep(items[i])) kept++;
+    }
+    if (kept == count) {
+        return 0;
+    }
+
+    int newCapacity = count > 4 ? count : 4;
+    T* newItems = new T[newCapacity];
+    int front = 0;
+    int back = kept;
+    for (int i = 0; i < count; i++) {
+        if (keep(items[i])) {
+            newItems[front++] = items[i];
+        } else {
+            newItems[back++] = items[i];
+        }
+    }
+
+    int removed = count - kept;
+    retireArray(items);
+    EPOCH_PUBLISH(items, newItems);
+    EPOCH_PUBLISH(count, kept);
+    capacity = newCapacity;
+    return removed;
+}
+
+// Añadir value a un array publicado (items/count) ordenado y sin repetidos;
+// false si ya estaba. Lo normal es que sea mayor que todos y vaya al final.
+// Si no (UPDATE de una canción vieja), primero se añade al final como
+// siempre y después se publica una copia ordenada del mismo tamaño: un
+// lector ve en cualquier momento todos los de antes.
+template <typename T>
+bool insertPublishedSorted(T*& items, int& count, int& capacity, T value) {
+    bool inOrder = count == 0 || items[count - 1] < value;
+    if (!inOrder && std::binary_search(items, items + count, value)) {
+        return false;
+    }
+
+    if (count >= capacity) {
+        int newCapacity = capacity > 2 ? capacity * 2 : 4;
+        T* newItems = new T[newCapacity];
+        memcpy(newItems, items, sizeof(T) * count);
+        retireArray(items);
+        EPOCH_PUBLISH(items, newItems);
+        capacity = newCapacity;
+    }
+    items[count] = value;
+    EPOCH_PUBLISH(count, count + 1);
+    if (inOrder) {
+        return true;
+    }
+
+    T* sorted = new T[capacity];
+    int position = std::lower_bound(items, items + count - 1, value) - items;
+    memcpy(sorted, items, sizeof(T) * position);
+    sorted[position] = value;
+    memcpy(sorted + position + 1, items + position, sizeof(T) * (count - 1 - position));
+    retireArray(items);
+    EPOCH_PUBLISH(items, sorted);
+    return true;
+}
+
+// Tarea periódica: avanzar la época si todos los lectores la han visto y
+// liberar lo retirado hace dos épocas
+void reclaimRetiredMemory();
+// Sin lectores (al cerrar la base): liberar todo lo retirado
+void drainRetiredMemory();
+size_t retiredMemoryCount();
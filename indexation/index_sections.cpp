@@ -0,0 +1,480 @@
+#include "index_sections.hpp"
+#include "bktree.hpp"
+#include "compaction.hpp"
+#include "database.hpp"
+#include "inverted_index.hpp"
+#include "song_store.hpp"
+#include "trie.hpp"
+#include "url_index.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// ===== CHECKSUM FNV-1a =====
+static uint64_t sectionChecksum(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static void appendU32(string& out, uint32_t value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+static void appendU64(string& out, uint64_t value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+// ===== ESCRIBIR UNA SECCIÓN (header + contenido + relleno) =====
+static void appendSection(string& out, const char* magic, uint32_t songCount, const string& payload) {
+    IndexSectionHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, 4);
+    header.version = INDEX_SECTION_VERSION;
+    header.songCount = songCount;
+    header.payloadBytes = payload.size();
+    header.checksum = sectionChecksum(payload.data(), payload.size());
+
+    out.append((const char*)&header, sizeof(header));
+    out.append(payload);
+    out.append((INDEX_SECTION_ALIGN - out.size() % INDEX_SECTION_ALIGN) % INDEX_SECTION_ALIGN, '\0');
+}
+
+// Palabra sin posiciones en POSD
+#define POSITIONS_NONE 0xffffffffu
+
+// ===== INDX: por palabra, nº de ids, longitud, ids, frecuencias y palabra =====
+// (frecuencias de 16 bits y palabra rellenas hasta múltiplo de 4)
+// POSD: nº de palabras y por palabra (en el orden de INDX) inicio y bytes de
+// sus posiciones en POSB (POSITIONS_NONE = no tiene) y el fin de las de cada
+// bloque completo de POSTING_BLOCK ids, contado desde su inicio
+static void serializeInverted(InvertedIndex* index, string& payload, string& directory,
+                              string& positionBytes) {
+    vector<int> ids;
+    vector<uint16_t> freqs;
+    vector<uint8_t> positions;
+    vector<uint32_t> offsets;
+    appendU32(payload, index->count);
+    appendU32(directory, index->count);
+    for (int i = 0; i < index->count; i++) {
+        WordEntry& entry = *wordEntryAt(index, i);
+        uint32_t wordLength = strlen(entry.word);
+        ids.clear();
+        freqs.clear();
+        positions.clear();
+        offsets.clear();
+        bool hasPositions = wordPostings(&entry, ids, freqs, positions, offsets);
+
+        appendU32(directory, positionBytes.size());
+        appendU32(directory, hasPositions ? positions.size() : POSITIONS_NONE);
+        for (size_t b = 1; b <= ids.size() / POSTING_BLOCK; b++) {
+            appendU32(directory, offsets[b * POSTING_BLOCK]);
+        }
+        positionBytes.append((const char*)positions.data(), positions.size());
+
+        appendU32(payload, ids.size());
+        appendU32(payload, wordLength);
+        payload.append((const char*)ids.data(), sizeof(int) * ids.size());
+        payload.append((const char*)freqs.data(), sizeof(uint16_t) * freqs.size());
+        payload.append(freqs.size() % 2 * sizeof(uint16_t), '\0');
+        payload.append(entry.word, wordLength);
+        payload.append((4 - wordLength % 4) % 4, '\0');
+    }
+}
+
+// ===== WCNT: nº de ids, totales sobre las vivas y longitudes por id =====
+// (relleno hasta múltiplo de 4)
+static void serializeWordCounts(SongDatabase* db, string& payload) {
+    uint32_t count = min(db->nextSongId, db->slotByIdCapacity);
+    appendU32(payload, count);
+    appendU32(payload, db->rankedSongCount);
+    appendU64(payload, db->titleWordTotal);
+    appendU64(payload, db->artistWordTotal);
+    payload.append((const char*)db->wordCountsById, sizeof(uint16_t) * count);
+    payload.append(count % 2 * sizeof(uint16_t), '\0');
+}
+
+// Posición en el archivo de una fila actual (-1 si no se guarda)
+static int savedSlot(const vector<int>& newSlots, int slot) {
+    return slot >= 0 && slot < (int)newSlots.size() ? newSlots[slot] : -1;
+}
+
+// ===== SLOT: nº de ids y la posición de cada uno =====
+static void serializeSlots(SongDatabase* db, const vector<int>& newSlots, string& payload) {
+    uint32_t count = min(db->nextSongId, db->slotByIdCapacity);
+    appendU32(payload, count);
+    for (uint32_t id = 0; id < count; id++) {
+        appendU32(payload, (uint32_t)savedSlot(newSlots, db->slotById[id]));
+    }
+}
+
+// ===== URLH: capacidad, nº de URLs y la tabla tal cual (alineada a 8) =====
+// La tabla se rehace con las filas que se guardan; en orden, la última
+// versión de cada URL reemplaza a las anteriores como al añadirlas
+struct SavedUrls {
+    SongStore* store;
+    const vector<int>* savedSlots;
+};
+
+static const char* savedUrlBySlot(void* owner, int slot) {
+    SavedUrls* urls = (SavedUrls*)owner;
+    if (slot < 0 || slot >= (int)urls->savedSlots->size()) {
+        return nullptr;
+    }
+    return storeText(urls->store, (*urls->savedSlots)[slot], TEXT_URL);
+}
+
+static void serializeUrls(UrlIndex* index, string& payload) {
+    UrlTable* table = index->table;
+    appendU32(payload, table->capacity);
+    appendU32(payload, index->count);
+    payload.append((const char*)table->hashes, sizeof(uint64_t) * table->capacity);
+    payload.append((const char*)table->slots, sizeof(int) * table->capacity);
+    payload.append((const char*)table->bloomWords, table->bloomBits / 8);
+}
+
+// ===== BKTR: nodo = nº de palabra, nº de hijos y por hijo distancia + subárbol =====
+static bool serializeBKNode(BKNode* node, const unordered_map<string, uint32_t>& termNumbers,
+                            string& payload) {
+    auto term = termNumbers.find(node->word);
+    if (term == termNumbers.end()) {
+        return false;
+    }
+
+    appendU32(payload, term->second);
+    appendU32(payload, node->childrenCount);
+    for (int i = 0; i < node->childrenCount; i++) {
+        appendU32(payload, node->children[i].distance);
+        if (!serializeBKNode(node->children[i].node, termNumbers, payload)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool serializeIndexSections(SongDatabase* db, const vector<int>& savedSlots,
+                            const vector<int>& newSlots, string& out) {
+    uint32_t songCount = savedSlots.size();
+
+    string inverted, positions, positionBytes;
+    serializeInverted(db->invertedIndex, inverted, positions, positionBytes);
+
+    // El BK-tree guarda solo la forma: palabra e ids salen de INDX
+    unordered_map<string, uint32_t> termNumbers;
+    for (int i = 0; i < db->invertedIndex->count; i++) {
+        termNumbers[wordEntryAt(db->invertedIndex, i)->word] = i;
+    }
+
+    string bktree;
+    appendU32(bktree, db->bkTree != nullptr);
+    if (db->bkTree && !serializeBKNode(db->bkTree, termNumbers, bktree)) {
+        cerr << "[ERROR] BK-tree con palabras fuera del índice, no se guarda" << endl;
+        return false;
+    }
+
+    string wordCounts;
+    serializeWordCounts(db, wordCounts);
+
+    // DEAD: nº de filas y sus posiciones (las pendientes siempre se guardan)
+    vector<int> deadSlots;
+    pendingDeadRows(deadSlots);
+    string deadRows;
+    appendU32(deadRows, deadSlots.size());
+    for (int slot : deadSlots) {
+        appendU32(deadRows, (uint32_t)savedSlot(newSlots, slot));
+    }
+
+    appendSection(out, SECTION_INVERTED, songCount, inverted);
+    appendSection(out, SECTION_BKTREE, songCount, bktree);
+    appendSection(out, SECTION_WORDCOUNTS, songCount, wordCounts);
+    appendSection(out, SECTION_POSITIONS, songCount, positions);
+    appendSection(out, SECTION_POSITION_BYTES, songCount, positionBytes);
+    appendSection(out, SECTION_DEAD_ROWS, songCount, deadRows);
+
+    SavedUrls savedUrls = {db->store, &savedSlots};
+    UrlIndex* urlIndex = createUrlIndex(savedSlots.size(), savedUrlBySlot, &savedUrls);
+    for (size_t slot = 0; slot < savedSlots.size(); slot++) {
+        insertUrlIndex(urlIndex, storeText(db->store, savedSlots[slot], TEXT_URL), slot);
+    }
+
+    string slots, urls;
+    serializeSlots(db, newSlots, slots);
+    serializeUrls(urlIndex, urls);
+    freeUrlIndex(urlIndex);
+    appendSection(out, SECTION_SLOTS, songCount, slots);
+    appendSection(out, SECTION_URLS, songCount, urls);
+    return true;
+}
+
+// ===== LECTURA CON LÍMITES =====
+struct SectionReader {
+    const char* data;
+    size_t size;
+    size_t position;
+    bool ok;
+};
+
+static uint32_t readU32(SectionReader* reader) {
+    uint32_t value = 0;
+    if (!reader->ok || reader->size - reader->position < sizeof(value)) {
+        reader->ok = false;
+        return 0;
+    }
+    memcpy(&value, reader->data + reader->position, sizeof(value));
+    reader->position += sizeof(value);
+    return value;
+}
+
+static uint64_t readU64(SectionReader* reader) {
+    uint64_t value = 0;
+    if (!reader->ok || reader->size - reader->position < sizeof(value)) {
+        reader->ok = false;
+        return 0;
+    }
+    memcpy(&value, reader->data + reader->position, sizeof(value));
+    reader->position += sizeof(value);
+    return value;
+}
+
+static const char* readBytes(SectionReader* reader, size_t length) {
+    if (!reader->ok || reader->size - reader->position < length) {
+        reader->ok = false;
+        return nullptr;
+    }
+    const char* bytes = reader->data + reader->position;
+    reader->position += length;
+    return bytes;
+}
+
+// ===== BUSCAR Y VALIDAR UNA SECCIÓN =====
+// Sin verifyChecksum no se lee el contenido (POSB: se usa mapeado y solo se
+// traen las páginas que lea una frase)
+static bool findSection(const char* data, size_t size, const char* magic, uint32_t songCount,
+                        SectionReader* reader, bool verifyChecksum = true) {
+    size_t position = 0;
+    while (position <= size && size - position >= sizeof(IndexSectionHeader)) {
+        IndexSectionHeader header;
+        memcpy(&header, data + position, sizeof(header));
+
+        size_t payloadStart = position + sizeof(header);
+        if (header.payloadBytes > size - payloadStart) {
+            return false;
+        }
+
+        if (memcmp(header.magic, magic, 4) == 0) {
+            if (header.version != INDEX_SECTION_VERSION) {
+                cout << "[INDEX] Sección " << magic << " de otra versión (" << header.version << ")" << endl;
+                return false;
+            }
+            if (header.songCount != songCount) {
+                cout << "[INDEX] Sección " << magic << " desactualizada: cubre " << header.songCount
+                     << " de " << songCount << " canciones" << endl;
+                return false;
+            }
+            if (verifyChecksum &&
+                sectionChecksum(data + payloadStart, header.payloadBytes) != header.checksum) {
+                cerr << "[ERROR] Checksum incorrecto en la sección " << magic << endl;
+                return false;
+            }
+            *reader = {data + payloadStart, (size_t)header.payloadBytes, 0, true};
+            return true;
+        }
+
+        size_t sectionBytes = sizeof(header) + header.payloadBytes;
+        position += (sectionBytes + INDEX_SECTION_ALIGN - 1) / INDEX_SECTION_ALIGN * INDEX_SECTION_ALIGN;
+    }
+    return false;
+}
+
+static BKNode* loadBKNode(SectionReader* reader, InvertedIndex* index) {
+    uint32_t term = readU32(reader);
+    uint32_t childrenCount = readU32(reader);
+    if (!reader->ok || term >= (uint32_t)index->count) {
+        reader->ok = false;
+        return nullptr;
+    }
+
+    WordEntry& entry = *wordEntryAt(index, term);
+    vector<int> ids;
+    wordPostingIds(&entry, ids);
+    BKNode* node = createBKNodeWithIds(entry.word, ids.data(), ids.size());
+    entry.bkNode = node;
+
+    for (uint32_t i = 0; i < childrenCount && reader->ok; i++) {
+        int distance = (int)readU32(reader);
+        BKNode* child = loadBKNode(reader, index);
+        if (child) {
+            addBKChild(node, distance, child);
+        }
+    }
+    return node;
+}
+
+// ===== LONGITUDES POR ID Y SUS TOTALES (guardados: sin recorrer las canciones) =====
+static bool loadWordCounts(SongDatabase* db, SectionReader* reader) {
+    uint32_t count = readU32(reader);
+    uint32_t rankedSongCount = readU32(reader);
+    uint64_t titleWordTotal = readU64(reader);
+    uint64_t artistWordTotal = readU64(reader);
+    if (!reader->ok || count > (uint32_t)db->slotByIdCapacity ||
+        count > reader->size / sizeof(uint16_t) || rankedSongCount > (uint32_t)db->store->count) {
+        return false;
+    }
+    const char* counts = readBytes(reader, sizeof(uint16_t) * count);
+    if (!reader->ok) {
+        return false;
+    }
+    memcpy(db->wordCountsById, counts, sizeof(uint16_t) * count);
+
+    db->rankedSongCount = rankedSongCount;
+    db->titleWordTotal = titleWordTotal;
+    db->artistWordTotal = artistWordTotal;
+    return true;
+}
+
+bool loadIndexSections(SongDatabase* db, const char* data, size_t size, uint32_t songCount) {
+    SectionReader inverted, bktree, wordCounts;
+    if (!findSection(data, size, SECTION_INVERTED, songCount, &inverted) ||
+        !findSection(data, size, SECTION_BKTREE, songCount, &bktree) ||
+        !findSection(data, size, SECTION_WORDCOUNTS, songCount, &wordCounts)) {
+        return false;
+    }
+
+    if (!loadWordCounts(db, &wordCounts)) {
+        cerr << "[ERROR] Sección " << SECTION_WORDCOUNTS << " mal formada" << endl;
+        return false;
+    }
+
+    // Con INDEX_POSITIONS a 0 las posiciones guardadas se ignoran
+    SectionReader positions = {nullptr, 0, 0, false};
+    SectionReader positionBytes = {nullptr, 0, 0, false};
+    if (INDEX_POSITIONS &&
+        (!findSection(data, size, SECTION_POSITIONS, songCount, &positions) ||
+         !findSection(data, size, SECTION_POSITION_BYTES, songCount, &positionBytes, false))) {
+        return false;
+    }
+
+    // ===== ÍNDICE INVERTIDO + TRIE =====
+    uint32_t wordCount = readU32(&inverted);
+    if (INDEX_POSITIONS && readU32(&positions) != wordCount) {
+        positions.ok = false;
+    }
+    vector<uint32_t> blockEnds;
+    for (uint32_t i = 0; i < wordCount && inverted.ok && (!INDEX_POSITIONS || positions.ok); i++) {
+        uint32_t idCount = readU32(&inverted);
+        uint32_t wordLength = readU32(&inverted);
+        if (wordLength == 0 || wordLength > 63 || idCount > inverted.size / sizeof(int)) {
+            inverted.ok = false;
+            break;
+        }
+
+        const char* ids = readBytes(&inverted, sizeof(int) * idCount);
+        const char* freqs = readBytes(&inverted, sizeof(uint16_t) * (idCount + idCount % 2));
+        const char* wordBytes = readBytes(&inverted, wordLength + (4 - wordLength % 4) % 4);
+        if (!inverted.ok) break;
+
+        // Las listas comprimidas necesitan ids crecientes
+        for (uint32_t j = 1; j < idCount; j++) {
+            if (((const int*)ids)[j] <= ((const int*)ids)[j - 1]) {
+                inverted.ok = false;
+            }
+        }
+        if (!inverted.ok) break;
+
+        // Posiciones: dentro de POSB y con los fines de bloque en orden
+        const uint8_t* wordPositions = nullptr;
+        uint32_t wordPositionBytes = 0;
+        if (INDEX_POSITIONS) {
+            uint32_t offset = readU32(&positions);
+            wordPositionBytes = readU32(&positions);
+            blockEnds.clear();
+            for (uint32_t b = 0; b < idCount / POSTING_BLOCK && positions.ok; b++) {
+                blockEnds.push_back(readU32(&positions));
+                uint32_t previous = b > 0 ? blockEnds[b - 1] : 0;
+                if (blockEnds[b] < previous || blockEnds[b] > wordPositionBytes) {
+                    positions.ok = false;
+                }
+            }
+            if (wordPositionBytes == POSITIONS_NONE) {
+                wordPositionBytes = 0;
+            } else if (offset > positionBytes.size || wordPositionBytes > positionBytes.size - offset) {
+                positions.ok = false;
+            } else {
+                wordPositions = (const uint8_t*)positionBytes.data + offset;
+            }
+            if (!positions.ok) break;
+        }
+
+        char word[64];
+        memcpy(word, wordBytes, wordLength);
+        word[wordLength] = '\0';
+
+        adoptWordEntry(db->invertedIndex, word, (const int*)ids, (const uint16_t*)freqs, idCount,
+                       wordPositions, wordPositionBytes, blockEnds.data());
+        insertPostingsTrie(db->trie, word, (const int*)ids, idCount);
+    }
+
+    // ===== BK-TREE =====
+    if (inverted.ok && readU32(&bktree) != 0) {
+        db->bkTree = loadBKNode(&bktree, db->invertedIndex);
+    }
+
+    if (!inverted.ok || !bktree.ok || (INDEX_POSITIONS && !positions.ok)) {
+        cerr << "[ERROR] Secciones de índice mal formadas" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadDeadRowSection(const char* data, size_t size, uint32_t songCount, vector<int>& slots) {
+    SectionReader reader;
+    if (!findSection(data, size, SECTION_DEAD_ROWS, songCount, &reader)) {
+        return false;
+    }
+    uint32_t count = readU32(&reader);
+    const char* rows = count <= reader.size / sizeof(int) ? readBytes(&reader, sizeof(int) * count)
+                                                           : nullptr;
+    if (!rows) {
+        cerr << "[ERROR] Sección " << SECTION_DEAD_ROWS << " mal formada" << endl;
+        return false;
+    }
+    slots.assign((const int*)rows, (const int*)rows + count);
+    return true;
+}
+
+bool findSongTableSections(char* data, size_t size, uint32_t songCount, SongTableSections* tables) {
+    // Sin checksum: se usan mapeadas y leerlas enteras es lo que se evita
+    SectionReader slots, urls;
+    if (!findSection(data, size, SECTION_SLOTS, songCount, &slots, false) ||
+        !findSection(data, size, SECTION_URLS, songCount, &urls, false)) {
+        return false;
+    }
+
+    uint32_t slotCount = readU32(&slots);
+    if (!slots.ok || slotCount == 0 || slotCount > INT32_MAX ||
+        (slots.size - slots.position) / sizeof(int) != slotCount) {
+        cerr << "[ERROR] Sección " << SECTION_SLOTS << " mal formada" << endl;
+        return false;
+    }
+    uint32_t urlCapacity = readU32(&urls);
+    uint32_t urlCount = readU32(&urls);
+    if (!urls.ok || urlCapacity > INT32_MAX || urlCount > urlCapacity) {
+        cerr << "[ERROR] Sección " << SECTION_URLS << " mal formada" << endl;
+        return false;
+    }
+
+    // Las mismas direcciones que los SectionReader, pero escribibles (mapeo privado)
+    tables->slotById = (int*)(data + (slots.data + slots.position - data));
+    tables->slotCount = (int)slotCount;
+    tables->urlTable = data + (urls.data + urls.position - data);
+    tables->urlTableBytes = urls.size - urls.position;
+    tables->urlCapacity = (int)urlCapacity;
+    tables->urlCount = (int)urlCount;
+    return true;
+}
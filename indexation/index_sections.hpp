@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SongDatabase;
+
+// ===== SECCIONES DE ÍNDICE EN EL ARCHIVO v3 =====
+// Van detrás de la arena, una tras otra, cada una alineada a INDEX_SECTION_ALIGN.
+// Subir INDEX_SECTION_VERSION si cambia el formato o cómo se extraen las
+// palabras: al cargar, una versión distinta obliga a reconstruir.
+// v2: frecuencias por posting en INDX y sección WCNT
+// v3: las frecuencias de INDX pasan a 16 bits (con las longitudes de los campos)
+// v4: posiciones por posting (POSD + POSB)
+// v5: totales de longitudes en WCNT; tablas id -> posición y URL (SLOT, URLH)
+#define INDEX_SECTION_VERSION 5
+#define INDEX_SECTION_ALIGN 64
+
+#define SECTION_INVERTED   "INDX"   // palabras + ids + frecuencias (el trie se rehace de aquí)
+#define SECTION_BKTREE     "BKTR"   // forma del BK-tree en preorden, por nº de palabra
+#define SECTION_WORDCOUNTS "WCNT"   // longitudes de título y artista por id (BM25)
+#define SECTION_POSITIONS  "POSD"   // por palabra, dónde empiezan sus posiciones en POSB
+#define SECTION_POSITION_BYTES "POSB"   // posiciones de todos los postings (se usan mapeadas)
+#define SECTION_DEAD_ROWS  "DEAD"   // filas muertas que la compactación aún no había recogido
+#define SECTION_SLOTS      "SLOT"   // posición de cada id (se usa mapeada)
+#define SECTION_URLS       "URLH"   // tabla hash de URLs con su filtro (se usa mapeada)
+
+#pragma pack(1)
+struct IndexSectionHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t songCount;         // canciones que cubre el índice
+    uint32_t reserved;
+    uint64_t payloadBytes;
+    uint64_t checksum;          // FNV-1a del contenido
+};
+#pragma pack()
+
+// ===== FUNCIONES =====
+
+// Añade las secciones a out (false si los índices no son coherentes).
+// savedSlots son las filas que van al archivo, en orden, y newSlots la
+// posición nueva de cada fila actual (-1 = no se guarda): SLOT, URLH y DEAD
+// se escriben ya renumeradas
+bool serializeIndexSections(SongDatabase* db, const std::vector<int>& savedSlots,
+                            const std::vector<int>& newSlots, std::string& out);
+
+// Adopta los índices guardados; false si faltan, están corruptos o no cubren
+// songCount canciones (el llamador debe reconstruirlos)
+bool loadIndexSections(SongDatabase* db, const char* data, size_t size, uint32_t songCount);
+
+// Filas de DEAD (sin validar contra las canciones); false si no está
+bool loadDeadRowSection(const char* data, size_t size, uint32_t songCount, std::vector<int>& slots);
+
+// ===== TABLAS id -> posición Y URL -> posición =====
+// Apuntan dentro de data (el archivo mapeado, escribible) sin haber leído
+// su contenido: quien las use comprueba cada posición al leerla
+struct SongTableSections {
+    int* slotById;
+    int slotCount;
+    char* urlTable;         // hashes, slots y filtro (ver mapUrlIndex)
+    uint64_t urlTableBytes;
+    int urlCapacity;
+    int urlCount;
+};
+
+// false si falta SLOT o URLH o no cubren songCount canciones
+bool findSongTableSections(char* data, size_t size, uint32_t songCount, SongTableSections* tables);
@@ -1,9 +1,12 @@
 #include "inverted_index.hpp"
+#include "epoch.hpp"
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <cctype>
+#include <algorithm>
 #include <unordered_set>
+#include <vector>
 
 using namespace std;
 
@@ -202,21 +205,118 @@ void extractWords(const char* text, char words[][64], int* wordCount, int maxWor
     }
 }
 
+// ===== POSTINGS DE UNA CANCIÓN (TÍTULO + ARTISTA) =====
+int songWordPostings(const char* title, const char* artist, SongWordPosting* out,
+                     int* titleWords, int* artistWords) {
+    char words[SONG_MAX_WORDS][64];
+    int titleWordCount = 0;
+    int artistWordCount = 0;
+    extractWords(title, words, &titleWordCount, SONG_MAX_WORDS / 2);
+    extractWords(artist, words + titleWordCount, &artistWordCount, SONG_MAX_WORDS / 2);
+    int wordCount = titleWordCount + artistWordCount;
+    *titleWords = titleWordCount;
+    *artistWords = artistWordCount;
+
+    // Cada palabra una vez, con las veces que sale en cada campo (y dónde)
+    int count = 0;
+    for (int i = 0; i < wordCount; i++) {
+        bool repeated = false;
+        for (int j = 0; j < i && !repeated; j++) {
+            repeated = strcmp(words[i], words[j]) == 0;
+        }
+        if (repeated) {
+            continue;
+        }
+
+        PostingPositions positions;
+        positions.titleCount = 0;
+        positions.artistCount = 0;
+        for (int j = i; j < wordCount; j++) {
+            if (strcmp(words[i], words[j]) == 0) {
+                if (j < titleWordCount) {
+                    positions.title[positions.titleCount++] = j;
+                } else {
+                    positions.artist[positions.artistCount++] = j - titleWordCount;
+                }
+            }
+        }
+        SongWordPosting* posting = &out[count++];
+        memcpy(posting->word, words[i], sizeof(posting->word));
+        posting->freq = makePostingFreq(positions.titleCount, positions.artistCount,
+                                        titleWordCount, artistWordCount);
+        posting->positionBytes = encodePostingPositions(&positions, posting->positions);
+    }
+    return count;
+}
+
+// ===== HASH DE 64 BITS DE UNA PALABRA (FNV-1a + finalizador de murmur3) =====
+uint64_t hashWord(const char* word) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char* ptr = (const unsigned char*)word; *ptr; ptr++) {
+        hash = (hash ^ *ptr) * 1099511628211ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return hash == 0 ? 1 : hash;  // 0 está reservado para "hueco libre"
+}
+
+static WordTable* createWordTable(int capacity) {
+    WordTable* table = new WordTable();
+    table->capacity = capacity;
+    table->hashes = new uint64_t[capacity]();
+    table->terms = new int[capacity];
+    return table;
+}
+
+static void freeWordTable(void* pointer) {
+    WordTable* table = (WordTable*)pointer;
+    delete[] table->hashes;
+    delete[] table->terms;
+    delete table;
+}
+
+static void placeTerm(WordTable* table, uint64_t hash, int term) {
+    int mask = table->capacity - 1;
+    int pos = (int)(hash & mask);
+    while (table->hashes[pos] != 0) {
+        pos = (pos + 1) & mask;
+    }
+    table->terms[pos] = term;
+    EPOCH_PUBLISH(table->hashes[pos], hash);
+}
+
+// ===== CRECER LA TABLA: los hashes están en las entradas =====
+static void growWordTable(InvertedIndex* index) {
+    WordTable* oldTable = index->table;
+    WordTable* newTable = createWordTable(oldTable->capacity * 2);
+
+    for (int i = 0; i < oldTable->capacity; i++) {
+        if (oldTable->hashes[i] != 0) {
+            placeTerm(newTable, oldTable->hashes[i], oldTable->terms[i]);
+        }
+    }
+
+    EPOCH_PUBLISH(index->table, newTable);
+    retireMemory(oldTable, freeWordTable);
+}
+
 // ===== CREAR ÍNDICE INVERTIDO VACÍO =====
 InvertedIndex* createInvertedIndex() {
     InvertedIndex* index = new InvertedIndex();
     
-    index->capacity = 100;
-    index->entries = new WordEntry[index->capacity]();
+    index->chunkCapacity = 16;
+    index->chunks = new WordEntry*[index->chunkCapacity];
+    index->chunkCount = 0;
     index->count = 0;
-    
-    // Inicializar entradas
-    for (int i = 0; i < index->capacity; i++) {
-        index->entries[i].word[0] = '\0';
-        index->entries[i].songIds = nullptr;
-        index->entries[i].count = 0;
-        index->entries[i].capacity = 0;
-    }
+    index->table = createWordTable(1024);
+    index->pendingMergeCapacity = 64;
+    index->pendingMerges = new WordEntry*[index->pendingMergeCapacity];
+    index->pendingMergeCount = 0;
     
     return index;
 }
@@ -225,98 +325,303 @@ InvertedIndex* createInvertedIndex() {
 void freeInvertedIndex(InvertedIndex* index) {
     if (!index) return;
     
-    // Liberar arrays de songIds
+    // Liberar listas de postings
     for (int i = 0; i < index->count; i++) {
-        delete[] index->entries[i].songIds;
+        freePostingList(wordEntryAt(index, i)->postings);
     }
     
-    delete[] index->entries;
+    for (int i = 0; i < index->chunkCount; i++) {
+        delete[] index->chunks[i];
+    }
+    delete[] index->chunks;
+    delete[] index->pendingMerges;
+    freeWordTable(index->table);
     delete index;
 }
 
-// ===== BUSCAR PALABRA EN EL ÍNDICE =====
+WordEntry* wordEntryAt(InvertedIndex* index, int term) {
+    WordEntry** chunks = EPOCH_LOAD(index->chunks);
+    return &chunks[term >> WORD_CHUNK_SHIFT][term & (WORD_CHUNK_SIZE - 1)];
+}
+
+// ===== BUSCAR PALABRA EN EL ÍNDICE (O(1): hash + sondeo lineal) =====
 WordEntry* findWord(InvertedIndex* index, const char* word) {
     if (!index || !word) return nullptr;
     
-    for (int i = 0; i < index->count; i++) {
-        if (strcmp(index->entries[i].word, word) == 0) {
-            return &index->entries[i];
+    WordTable* table = EPOCH_LOAD(index->table);
+    uint64_t hash = hashWord(word);
+    int mask = table->capacity - 1;
+    int pos = (int)(hash & mask);
+    uint64_t stored;
+    while ((stored = EPOCH_LOAD(table->hashes[pos])) != 0) {
+        if (stored == hash) {
+            WordEntry* entry = wordEntryAt(index, table->terms[pos]);
+            if (strcmp(entry->word, word) == 0) {
+                return entry;
+            }
         }
+        pos = (pos + 1) & mask;
     }
     
     return nullptr;
 }
 
+// ===== AÑADIR ENTRADA NUEVA (sin buscar si ya existe) =====
+// No se cuenta ni se encuentra hasta que el llamador la publica con publishWordEntry
+static WordEntry* appendWordEntry(InvertedIndex* index, const char* word) {
+    int chunk = index->count >> WORD_CHUNK_SHIFT;
+    
+    // Bloque nuevo si es necesario (los existentes no se mueven)
+    if (chunk >= index->chunkCount) {
+        if (index->chunkCount >= index->chunkCapacity) {
+            int newCapacity = index->chunkCapacity * 2;
+            WordEntry** newChunks = new WordEntry*[newCapacity];
+            memcpy(newChunks, index->chunks, sizeof(WordEntry*) * index->chunkCount);
+            retireArray(index->chunks);
+            EPOCH_PUBLISH(index->chunks, newChunks);
+            index->chunkCapacity = newCapacity;
+        }
+        index->chunks[index->chunkCount++] = new WordEntry[WORD_CHUNK_SIZE]();
+    }
+    
+    // Crear nueva entrada
+    WordEntry* entry = &index->chunks[chunk][index->count & (WORD_CHUNK_SIZE - 1)];
+    
+    // Copiar palabra
+    size_t wordLen = strlen(word);
+    memcpy(entry->word, word, min(wordLen + 1, (size_t)64));
+    entry->word[63] = '\0';
+    entry->hash = hashWord(entry->word);
+    return entry;
+}
+
+static void publishWordEntry(InvertedIndex* index, WordEntry* entry) {
+    if ((index->count + 1) * 2 > index->table->capacity) {
+        growWordTable(index);
+    }
+    placeTerm(index->table, entry->hash, index->count);
+    EPOCH_PUBLISH(index->count, index->count + 1);
+}
+
+// ===== ADOPTAR UNA PALABRA CON SUS IDS (carga del índice guardado) =====
+// La palabra no debe estar ya en el índice; los ids vienen ordenados y sin
+// repetir (como los escribe serializeIndexSections)
+WordEntry* adoptWordEntry(InvertedIndex* index, const char* word, const int* songIds,
+                          const uint16_t* freqs, int count, const uint8_t* positions,
+                          uint32_t positionBytes, const uint32_t* blockEnds) {
+    WordEntry* entry = appendWordEntry(index, word);
+    
+    if (count <= POSTING_INLINE && positionBytes <= POSTING_INLINE_POSITION_BYTES) {
+        memcpy(entry->inlineIds, songIds, sizeof(int) * count);
+        memcpy(entry->inlineFreqs, freqs, sizeof(uint16_t) * count);
+        if (positions) {
+            memcpy(entry->inlinePositions, positions, positionBytes);
+        }
+        entry->inlinePositionBytes = positions ? (int)positionBytes : -1;
+        entry->inlineCount = count;
+    } else if (count <= POSTING_INLINE) {
+        entry->postings = buildPostingList(songIds, freqs, positions, positionBytes, count);
+    } else {
+        entry->postings = buildPostingList(songIds, freqs, nullptr, 0, count);
+        if (positions) {
+            mapPostingPositions(entry->postings, positions, positionBytes, blockEnds);
+        }
+    }
+    
+    publishWordEntry(index, entry);
+    return entry;
+}
+
+void replaceWordPostings(WordEntry* entry, PostingList* postings) {
+    PostingList* old = entry->postings;
+    EPOCH_PUBLISH(entry->postings, postings);
+    retirePostingList(old);
+}
+
+// ===== FUSIÓN DE SEGMENTOS (fuera de la inserción, desde el tick) =====
+static void queueSegmentMerge(InvertedIndex* index, WordEntry* entry) {
+    if (index->pendingMergeCount >= index->pendingMergeCapacity) {
+        int newCapacity = index->pendingMergeCapacity * 2;
+        WordEntry** newPending = new WordEntry*[newCapacity];
+        memcpy(newPending, index->pendingMerges, sizeof(WordEntry*) * index->pendingMergeCount);
+        delete[] index->pendingMerges;
+        index->pendingMerges = newPending;
+        index->pendingMergeCapacity = newCapacity;
+    }
+    index->pendingMerges[index->pendingMergeCount++] = entry;
+    entry->mergePending = true;
+}
+
+int mergePendingSegments(InvertedIndex* index, int maxWords) {
+    for (int i = 0; i < maxWords && index->pendingMergeCount > 0; i++) {
+        WordEntry* entry = index->pendingMerges[--index->pendingMergeCount];
+        entry->mergePending = false;
+        // La lista puede haberse reconstruido entera mientras esperaba
+        if (entry->postings) {
+            mergePostingSegments(entry->postings);
+        }
+    }
+    return index->pendingMergeCount;
+}
+
+// ===== LECTURA DE LOS IDS DE UNA PALABRA =====
+// Una vez publicada la PostingList los ids de dentro no vuelven a cambiar,
+// así que quien aún vea postings == nullptr lee una lista corta coherente
+void wordPostingsBegin(PostingIterator* it, WordEntry* entry) {
+    PostingList* postings = EPOCH_LOAD(entry->postings);
+    if (postings) {
+        postingBegin(it, postings);
+    } else {
+        int count = EPOCH_LOAD(entry->inlineCount);
+        int positionBytes = EPOCH_LOAD(entry->inlinePositionBytes);
+        postingBeginIds(it, entry->inlineIds, entry->inlineFreqs, count,
+                        positionBytes >= 0 ? entry->inlinePositions : nullptr,
+                        positionBytes >= 0 ? positionBytes : 0);
+    }
+}
+
+int wordPostingCount(WordEntry* entry) {
+    PostingList* postings = EPOCH_LOAD(entry->postings);
+    return postings ? postingCount(postings) : EPOCH_LOAD(entry->inlineCount);
+}
+
+void wordPostingIds(WordEntry* entry, vector<int>& ids) {
+    PostingIterator it;
+    wordPostingsBegin(&it, entry);
+    while (postingNext(&it)) {
+        ids.push_back(it.id);
+    }
+}
+
+bool wordPostings(WordEntry* entry, vector<int>& ids, vector<uint16_t>& freqs,
+                  vector<uint8_t>& positions, vector<uint32_t>& positionOffsets) {
+    PostingIterator it;
+    wordPostingsBegin(&it, entry);
+    bool hasPositions = it.hasPositions;
+    positionOffsets.push_back(0);
+    while (postingNext(&it)) {
+        ids.push_back(it.id);
+        freqs.push_back(it.freq);
+
+        // Se vuelven a codificar: así salen igual estén donde estén
+        PostingPositions decoded;
+        if (hasPositions && !postingPositions(&it, &decoded)) {
+            hasPositions = false;   // dañadas: mejor sin ellas
+        }
+        if (hasPositions) {
+            uint8_t encoded[POSTING_MAX_POSITION_BYTES];
+            int bytes = encodePostingPositions(&decoded, encoded);
+            positions.insert(positions.end(), encoded, encoded + bytes);
+        }
+        positionOffsets.push_back(positions.size());
+    }
+    if (!hasPositions) {
+        positions.clear();
+        positionOffsets.assign(ids.size() + 1, 0);
+    }
+    return hasPositions;
+}
+
+bool findWordPosting(WordEntry* entry, int songId, uint16_t* freq) {
+    PostingIterator it;
+    wordPostingsBegin(&it, entry);
+    if (!postingAdvanceTo(&it, songId) || it.id != songId) {
+        return false;
+    }
+    *freq = it.freq;
+    return true;
+}
+
+size_t invertedIndexMemory(InvertedIndex* index) {
+    size_t bytes = sizeof(InvertedIndex) + sizeof(WordEntry) * WORD_CHUNK_SIZE * index->chunkCount +
+                   (sizeof(uint64_t) + sizeof(int)) * index->table->capacity;
+    for (int i = 0; i < index->count; i++) {
+        PostingList* postings = wordEntryAt(index, i)->postings;
+        if (postings) {
+            bytes += postingMemory(postings);
+        }
+    }
+    return bytes;
+}
+
 // ===== AÑADIR PALABRA + SONG ID AL ÍNDICE =====
-void insertWordIndex(InvertedIndex* index, string wordString, int songId) {
+WordEntry* insertWordIndex(InvertedIndex* index, string wordString, int songId, uint16_t freq,
+                           const uint8_t* positions, int positionBytes) {
     const char* word = wordString.c_str();
-    if (!index || !word || word[0] == '\0') return;
+    if (!index || !word || word[0] == '\0') return nullptr;
     
     // Buscar si la palabra ya existe
     WordEntry* entry = findWord(index, word);
     
     if (!entry) {
         // ===== PALABRA NUEVA =====
-        
-        // Expandir array de entradas si es necesario
-        if (index->count >= index->capacity) {
-            int newCapacity = index->capacity * 2;
-            WordEntry* newEntries = new WordEntry[newCapacity]();
-            
-            // Copiar entradas existentes
-            memcpy(newEntries, index->entries, sizeof(WordEntry) * index->count);
-            
-            // Inicializar nuevas entradas
-            for (int i = index->count; i < newCapacity; i++) {
-                newEntries[i].word[0] = '\0';
-                newEntries[i].songIds = nullptr;
-                newEntries[i].count = 0;
-                newEntries[i].capacity = 0;
+        entry = appendWordEntry(index, word);
+        publishWordEntry(index, entry);
+    }
+    
+    if (entry->inlineCount == 0 && !entry->postings && !positions) {
+        EPOCH_PUBLISH(entry->inlinePositionBytes, -1);
+    }
+    // Sin posiciones en un índice que las tiene se guarda la lista vacía
+    uint8_t empty[2] = {0, 0};
+    if (!positions || positionBytes <= 0) {
+        positions = empty;
+        positionBytes = sizeof(empty);
+    }
+    
+    // ===== CASO NORMAL: id mayor que todos (canción nueva) =====
+    PostingList* postings = entry->postings;
+    if (postings) {
+        if (appendPosting(postings, songId, freq, positions, positionBytes)) {
+            if (!entry->mergePending && postingNeedsMerge(postings)) {
+                queueSegmentMerge(index, entry);
             }
-            
-            delete[] index->entries;
-            index->entries = newEntries;
-            index->capacity = newCapacity;
+            return entry;
+        }
+    } else {
+        int count = entry->inlineCount;
+        int usedBytes = entry->inlinePositionBytes;
+        bool fits = usedBytes < 0 || usedBytes + positionBytes <= POSTING_INLINE_POSITION_BYTES;
+        if (count < POSTING_INLINE && fits && (count == 0 || songId > entry->inlineIds[count - 1])) {
+            if (usedBytes >= 0) {
+                memcpy(entry->inlinePositions + usedBytes, positions, positionBytes);
+                EPOCH_PUBLISH(entry->inlinePositionBytes, usedBytes + positionBytes);
+            }
+            entry->inlineIds[count] = songId;
+            entry->inlineFreqs[count] = freq;
+            EPOCH_PUBLISH(entry->inlineCount, count + 1);
+            return entry;
         }
-        
-        // Crear nueva entrada
-        entry = &index->entries[index->count];
-        index->count++;
-        
-        // Copiar palabra
-        size_t wordLen = strlen(word);
-        memcpy(entry->word, word, min(wordLen + 1, (size_t)64));
-        entry->word[63] = '\0';
-        
-        // Inicializar array de songIds
-        entry->capacity = 4;
-        entry->songIds = new int[entry->capacity];
-        entry->count = 0;
     }
     
-    // ===== VERIFICAR DUPLICADOS =====
-    for (int i = 0; i < entry->count; i++) {
-        if (entry->songIds[i] == songId) {
-            return;  // Ya existe
+    // ===== NO CABE, FUERA DE ORDEN O YA ESTABA (UPDATE de una canción vieja): lista nueva =====
+    vector<int> ids;
+    vector<uint16_t> freqs;
+    vector<uint8_t> allPositions;
+    vector<uint32_t> offsets;
+    bool hasPositions = wordPostings(entry, ids, freqs, allPositions, offsets);
+    size_t position = lower_bound(ids.begin(), ids.end(), songId) - ids.begin();
+    size_t start = hasPositions ? offsets[position] : 0;
+    if (position < ids.size() && ids[position] == songId) {
+        size_t oldBytes = hasPositions ? offsets[position + 1] - start : 0;
+        bool samePositions = !hasPositions || (oldBytes == (size_t)positionBytes &&
+                                               memcmp(&allPositions[start], positions, oldBytes) == 0);
+        if (freqs[position] == freq && samePositions) {
+            return entry;
+        }
+        freqs[position] = freq;
+        if (hasPositions) {
+            allPositions.erase(allPositions.begin() + start, allPositions.begin() + start + oldBytes);
         }
+    } else {
+        ids.insert(ids.begin() + position, songId);
+        freqs.insert(freqs.begin() + position, freq);
     }
-    
-    // ===== AÑADIR SONG ID =====
-    
-    // Expandir array de songIds si es necesario
-    if (entry->count >= entry->capacity) {
-        int newCapacity = entry->capacity * 2;
-        int* newSongIds = new int[newCapacity];
-        
-        // Copiar IDs existentes
-        memcpy(newSongIds, entry->songIds, sizeof(int) * entry->count);
-        
-        delete[] entry->songIds;
-        entry->songIds = newSongIds;
-        entry->capacity = newCapacity;
+    if (hasPositions) {
+        allPositions.insert(allPositions.begin() + start, positions, positions + positionBytes);
     }
-    
-    // Añadir nuevo songId
-    entry->songIds[entry->count] = songId;
-    entry->count++;
-}
\ No newline at end of file
+    replaceWordPostings(entry, buildPostingList(ids.data(), freqs.data(),
+                                                hasPositions ? allPositions.data() : nullptr,
+                                                allPositions.size(), ids.size()));
+    return entry;
+}
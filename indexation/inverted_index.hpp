@@ -1,25 +1,63 @@
 #pragma once
 
+#include "postings.hpp"
+#include <cstdint>
 #include <string>
+#include <vector>
 
 using std::string;
 
+struct BKNode;
+
+// IDs que caben dentro de la propia entrada, y bytes para sus posiciones
+#define POSTING_INLINE 3
+#define POSTING_INLINE_POSITION_BYTES 16
+
 // ===== ENTRADA DEL ÍNDICE INVERTIDO =====
-#pragma pack(1)
+// postings se publica para lectores concurrentes (ver epoch.hpp)
 struct WordEntry {
     char word[64];      // La palabra indexada (ej: "bohemian")
-    int* songIds;       // Array dinámico de IDs de canciones
-    int count;          // Cantidad ACTUAL de IDs en el array
-    int capacity;       // Capacidad MÁXIMA del array (memoria alocada)
-    int documentFrequency = 0;  // Frecuencia con la que aparece
-    double inverseDocumentFrequency = 0.0;    // lo que dice su nombre
+    uint64_t hash;      // hashWord(word), para crecer la tabla sin releer palabras
+    PostingList* postings;      // IDs de canciones, ordenados y comprimidos
+    // Mientras postings es nullptr los ids van aquí (la mayoría de palabras
+    // salen en muy pocas canciones); inlineCount se publica después del id
+    // y de sus posiciones (inlinePositionBytes = -1: la palabra no las tiene)
+    int inlineIds[POSTING_INLINE];
+    uint16_t inlineFreqs[POSTING_INLINE];
+    uint8_t inlinePositions[POSTING_INLINE_POSITION_BYTES];
+    int inlinePositionBytes;
+    int inlineCount;
+    bool mergePending;  // en la cola de fusión de segmentos (solo el escritor)
+    BKNode* bkNode;     // su nodo en el BK-tree (solo el escritor; nullptr = aún no)
+    // La frecuencia de documento es el nº de postings (wordPostingCount); el
+    // IDF depende del total de canciones y se calcula al puntuar (ranking.hpp)
+};
+
+// Entradas por bloque: los bloques no se mueven nunca, así que un WordEntry*
+// sigue siendo válido aunque el diccionario crezca
+#define WORD_CHUNK_SHIFT 9
+#define WORD_CHUNK_SIZE (1 << WORD_CHUNK_SHIFT)
+
+// ===== TABLA HASH palabra -> número de entrada (direccionamiento abierto) =====
+// Al crecer se construye una tabla nueva, se publica y la vieja se retira
+struct WordTable {
+    uint64_t* hashes;   // 0 = hueco libre; se publica después del término
+    int* terms;         // número de entrada (orden de inserción)
+    int capacity;       // potencia de 2, ocupación <= 50%
 };
-#pragma pack()
 
 struct InvertedIndex {
-    WordEntry* entries;  // Array dinámico de palabras
+    WordEntry** chunks;  // Directorio de bloques de WORD_CHUNK_SIZE entradas
+    int chunkCount;
+    int chunkCapacity;
     int count;           // Cantidad actual de palabras
-    int capacity;        // Capacidad máxima del array
+    WordTable* table;
+
+    // Palabras cuya lista tiene segmentos por fusionar (ver postings.hpp);
+    // solo las usa el escritor
+    WordEntry** pendingMerges;
+    int pendingMergeCount;
+    int pendingMergeCapacity;
 };
 
 // ===== FUNCIONES =====
@@ -27,9 +65,52 @@ struct InvertedIndex {
 InvertedIndex* createInvertedIndex();
 void freeInvertedIndex(InvertedIndex* index);
 
-void insertWordIndex(InvertedIndex* index, string word, int songId);
+// freq: veces en título y artista y largo de cada campo (makePostingFreq);
+// positions: encodePostingPositions (nullptr = índice sin posiciones).
+// Devuelve la entrada de la palabra (nullptr si está vacía)
+WordEntry* insertWordIndex(InvertedIndex* index, string word, int songId, uint16_t freq,
+                           const uint8_t* positions, int positionBytes);
 WordEntry* findWord(InvertedIndex* index, const char* word);
+WordEntry* wordEntryAt(InvertedIndex* index, int term);   // 0 <= term < count
+uint64_t hashWord(const char* word);
+// positions (nullptr = sin ellas) se usan sin copiar si no caben en la
+// entrada: deben durar lo que el índice (el archivo mapeado); blockEnds es el
+// fin de las de cada bloque completo
+WordEntry* adoptWordEntry(InvertedIndex* index, const char* word, const int* songIds,
+                          const uint16_t* freqs, int count, const uint8_t* positions,
+                          uint32_t positionBytes, const uint32_t* blockEnds);
+// Sustituir la lista de una palabra (la vieja se retira)
+void replaceWordPostings(WordEntry* entry, PostingList* postings);
+// Fusionar los segmentos pendientes de hasta maxWords palabras; devuelve
+// cuántas quedan
+int mergePendingSegments(InvertedIndex* index, int maxWords);
+
+// IDs de una palabra, estén dentro de la entrada o en su PostingList
+void wordPostingsBegin(PostingIterator* it, WordEntry* entry);
+int wordPostingCount(WordEntry* entry);
+void wordPostingIds(WordEntry* entry, std::vector<int>& ids);
+// Con las posiciones de cada id seguidas en positions (la de ids[i] empieza
+// en positionOffsets[i], con una más al final); false si la palabra no tiene
+bool wordPostings(WordEntry* entry, std::vector<int>& ids, std::vector<uint16_t>& freqs,
+                  std::vector<uint8_t>& positions, std::vector<uint32_t>& positionOffsets);
+// freq de songId en la palabra (false si no tiene ese posting)
+bool findWordPosting(WordEntry* entry, int songId, uint16_t* freq);
+size_t invertedIndexMemory(InvertedIndex* index);
 
 // Helper para palabras
 void extractWords(const char* text, char words[][64], int* wordCount, int maxWords);
 bool isStopWord(const char* word);
+
+// ===== POSTINGS DE UNA CANCIÓN =====
+// Cada palabra distinta del título y el artista con su freq y sus posiciones
+// codificadas, tal como se indexa
+#define SONG_MAX_WORDS 100
+struct SongWordPosting {
+    char word[64];
+    uint16_t freq;
+    int positionBytes;
+    uint8_t positions[POSTING_MAX_POSITION_BYTES];
+};
+// out necesita SONG_MAX_WORDS entradas; devuelve cuántas escribe
+int songWordPostings(const char* title, const char* artist, SongWordPosting* out,
+                     int* titleWords, int* artistWords);
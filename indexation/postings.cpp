@@ -0,0 +1,816 @@
+#include "postings.hpp"
+#include "epoch.hpp"
+#include <cstring>
+
+using namespace std;
+
+// Un varint de 32 bits ocupa como mucho 5 bytes
+#define VARINT_MAX_BYTES 5
+
+// ===== VARINT (7 bits por byte, el bit alto indica que sigue otro) =====
+static int encodeVarint(uint32_t value, uint8_t* out) {
+    int bytes = 0;
+    while (value >= 0x80) {
+        out[bytes++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[bytes++] = (uint8_t)value;
+    return bytes;
+}
+
+static const uint8_t* decodeVarint(const uint8_t* in, uint32_t* value) {
+    uint32_t result = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        result |= (uint32_t)(*in++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *value = result | ((uint32_t)*in++ << shift);
+    return in;
+}
+
+// Saltar un varint sin pasar de end (nullptr si no acaba antes)
+static const uint8_t* skipVarint(const uint8_t* in, const uint8_t* end) {
+    while (in < end && (*in & 0x80)) {
+        in++;
+    }
+    return in < end ? in + 1 : nullptr;
+}
+
+// ===== POSICIONES =====
+int encodePostingPositions(const PostingPositions* positions, uint8_t* out) {
+    int bytes = 0;
+    const uint8_t* fields[2] = {positions->title, positions->artist};
+    int counts[2] = {positions->titleCount, positions->artistCount};
+    for (int f = 0; f < 2; f++) {
+        int count = min(counts[f], POSTING_MAX_POSITIONS);
+        bytes += encodeVarint((uint32_t)count, out + bytes);
+        uint32_t previous = 0;
+        for (int i = 0; i < count; i++) {
+            bytes += encodeVarint(fields[f][i] - previous, out + bytes);
+            previous = fields[f][i];
+        }
+    }
+    return bytes;
+}
+
+int postingPositionsSize(const uint8_t* data, const uint8_t* end) {
+    const uint8_t* in = data;
+    for (int f = 0; f < 2; f++) {
+        uint32_t count;
+        const uint8_t* next = skipVarint(in, end);
+        if (!next) return -1;
+        decodeVarint(in, &count);
+        in = next;
+        for (uint32_t i = 0; i < count; i++) {
+            in = skipVarint(in, end);
+            if (!in) return -1;
+        }
+    }
+    return (int)(in - data);
+}
+
+// Como postingPositionsSize, sin pasar de end (las guardadas no se verifican
+// al cargar para no leer el archivo entero)
+static bool decodePostingPositions(const uint8_t* in, const uint8_t* end, PostingPositions* out) {
+    int* counts[2] = {&out->titleCount, &out->artistCount};
+    uint8_t* fields[2] = {out->title, out->artist};
+    for (int f = 0; f < 2; f++) {
+        if (!skipVarint(in, end)) return false;
+        uint32_t count;
+        in = decodeVarint(in, &count);
+        if (count > POSTING_MAX_POSITIONS) return false;
+        uint32_t previous = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!skipVarint(in, end)) return false;
+            uint32_t delta;
+            in = decodeVarint(in, &delta);
+            previous += delta;
+            fields[f][i] = (uint8_t)previous;
+        }
+        *counts[f] = (int)count;
+    }
+    return true;
+}
+
+// ===== CREAR / LIBERAR =====
+PostingList* createPostingList(bool withPositions) {
+    PostingList* list = new PostingList();
+    list->sealed = nullptr;
+    list->sealSequence = 0;
+    list->data = nullptr;
+    list->dataBytes = 0;
+    list->dataCapacity = 0;
+    list->skips = nullptr;
+    list->skipCapacity = 0;
+    list->tailCapacity = 4;
+    list->tail = new int[list->tailCapacity];
+    list->freqCapacity = 4;
+    list->freqs = new uint16_t[list->freqCapacity];
+    list->positionCapacity = withPositions ? 16 : 0;
+    list->positions = withPositions ? new uint8_t[list->positionCapacity] : nullptr;
+    list->positionBytes = 0;
+    list->count = 0;
+    list->lastId = -1;
+    list->bestFreq = POSTING_FREQ_WORST;
+    return list;
+}
+
+// El directorio sin los segmentos (siguen en el que lo sustituye)
+static void freeSegmentDirectory(void* pointer) {
+    PostingSegments* sealed = (PostingSegments*)pointer;
+    delete[] sealed->segments;
+    delete sealed;
+}
+
+void freePostingList(PostingList* list) {
+    if (!list) return;
+    if (list->sealed) {
+        for (int i = 0; i < list->sealed->count; i++) {
+            delete[] list->sealed->segments[i].buffer;
+        }
+        freeSegmentDirectory(list->sealed);
+    }
+    delete[] list->data;
+    delete[] list->skips;
+    delete[] list->tail;
+    delete[] list->freqs;
+    delete[] list->positions;
+    delete list;
+}
+
+void retirePostingList(PostingList* list) {
+    if (list) retireMemory(list, [](void* p) { freePostingList((PostingList*)p); });
+}
+
+// ===== COMPRIMIR UN BLOQUE =====
+// Diferencia con el id anterior (previous: el último del bloque de antes)
+static int encodeBlock(const int* ids, uint32_t previous, uint8_t* out) {
+    int bytes = 0;
+    for (int i = 0; i < POSTING_BLOCK; i++) {
+        bytes += encodeVarint((uint32_t)ids[i] - previous, out + bytes);
+        previous = ids[i];
+    }
+    return bytes;
+}
+
+static uint16_t blockBestFreq(const uint16_t* freqs) {
+    uint16_t bestFreq = POSTING_FREQ_WORST;
+    for (int i = 0; i < POSTING_BLOCK; i++) {
+        bestFreq = bestPostingFreq(bestFreq, freqs[i]);
+    }
+    return bestFreq;
+}
+
+// ===== SEGMENTOS =====
+// Nivel por tamaño: 0 hasta POSTING_SEGMENT_BLOCKS * POSTING_MERGE_FANOUT
+// bloques, y uno más cada vez que se multiplica por POSTING_MERGE_FANOUT
+static int segmentLevel(int blockCount) {
+    int level = 0;
+    for (long size = POSTING_SEGMENT_BLOCKS * POSTING_MERGE_FANOUT; size <= blockCount;
+         size *= POSTING_MERGE_FANOUT) {
+        level++;
+    }
+    return level;
+}
+
+// Una sola reserva: skips, frecuencias, datos y (si no van mapeadas) posiciones
+static PostingSegment allocSegment(int blockCount, uint32_t dataBytes, uint32_t positionBytes,
+                                   bool ownPositions) {
+    size_t skipBytes = sizeof(PostingSkip) * blockCount;
+    size_t freqBytes = sizeof(uint16_t) * blockCount * POSTING_BLOCK;
+
+    PostingSegment segment;
+    segment.bufferBytes = skipBytes + freqBytes + dataBytes + (ownPositions ? positionBytes : 0);
+    segment.buffer = new uint8_t[segment.bufferBytes];
+    segment.skips = (PostingSkip*)segment.buffer;
+    segment.freqs = (uint16_t*)(segment.buffer + skipBytes);
+    segment.data = segment.buffer + skipBytes + freqBytes;
+    segment.dataBytes = dataBytes;
+    segment.positions = ownPositions ? segment.data + dataBytes : nullptr;
+    segment.positionBytes = positionBytes;
+    segment.blockCount = blockCount;
+    segment.firstBlock = 0;
+    segment.previousId = 0;
+    segment.level = segmentLevel(blockCount);
+    return segment;
+}
+
+// Directorio nuevo: los de old sin los que empiezan en keep, más segment
+static PostingSegments* replaceSegments(const PostingSegments* old, int keep,
+                                        const PostingSegment& segment) {
+    PostingSegments* sealed = new PostingSegments();
+    sealed->count = keep + 1;
+    sealed->segments = new PostingSegment[sealed->count];
+    for (int i = 0; i < keep; i++) {
+        sealed->segments[i] = old->segments[i];
+    }
+    PostingSegment& last = sealed->segments[keep];
+    last = segment;
+    last.firstBlock = keep > 0 ? old->segments[keep - 1].firstBlock + old->segments[keep - 1].blockCount : 0;
+    sealed->blockCount = last.firstBlock + last.blockCount;
+    sealed->lastId = last.skips[last.blockCount - 1].lastId;
+    return sealed;
+}
+
+// ===== SELLAR LA CABEZA =====
+// Justo al completar el bloque POSTING_SEGMENT_BLOCKS (la cola está vacía):
+// todo lo de la cabeza pasa a un segmento y la cabeza vuelve a empezar
+static void sealHead(PostingList* list, int headBlocks) {
+    PostingSegments* old = list->sealed;
+    PostingSegment segment = allocSegment(headBlocks, list->dataBytes, list->positionBytes,
+                                          list->positions != nullptr);
+    memcpy(segment.skips, list->skips, sizeof(PostingSkip) * headBlocks);
+    memcpy(segment.freqs, list->freqs, sizeof(uint16_t) * headBlocks * POSTING_BLOCK);
+    memcpy(segment.data, list->data, list->dataBytes);
+    if (list->positions) {
+        memcpy((uint8_t*)segment.positions, list->positions, list->positionBytes);
+    }
+    segment.previousId = old ? old->lastId : 0;
+    PostingSegments* sealed = replaceSegments(old, old ? old->count : 0, segment);
+
+    // Directorio y cabeza cambian a la vez: impar mientras tanto (cada
+    // publicación es release, así que quien vea algo nuevo ve también el impar)
+    EPOCH_PUBLISH(list->sealSequence, list->sealSequence + 1);
+    EPOCH_PUBLISH(list->sealed, sealed);
+
+    retireArray(list->data);
+    retireArray(list->skips);
+    retireArray(list->freqs);
+    EPOCH_PUBLISH(list->data, (uint8_t*)nullptr);
+    EPOCH_PUBLISH(list->skips, (PostingSkip*)nullptr);
+    list->dataBytes = 0;
+    list->dataCapacity = 0;
+    list->skipCapacity = 0;
+    list->freqCapacity = 4;
+    EPOCH_PUBLISH(list->freqs, new uint16_t[list->freqCapacity]);
+    if (list->positions) {
+        retireArray(list->positions);
+        list->positionCapacity = 16;
+        EPOCH_PUBLISH(list->positions, new uint8_t[list->positionCapacity]);
+        EPOCH_PUBLISH(list->positionBytes, (uint32_t)0);
+    }
+
+    EPOCH_PUBLISH(list->sealSequence, list->sealSequence + 1);
+    if (old) {
+        retireMemory(old, freeSegmentDirectory);
+    }
+}
+
+// ===== FUSIÓN POR NIVELES =====
+bool postingNeedsMerge(const PostingList* list) {
+    const PostingSegments* sealed = list->sealed;
+    if (!sealed || sealed->count < POSTING_MERGE_FANOUT) {
+        return false;
+    }
+    int level = sealed->segments[sealed->count - 1].level;
+    for (int i = 2; i <= POSTING_MERGE_FANOUT; i++) {
+        if (sealed->segments[sealed->count - i].level != level) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Los ids no cambian: basta con copiar seguidos y mover offsets y fines de
+// posiciones. Los lectores ven el directorio viejo o el nuevo, los dos enteros
+void mergePostingSegments(PostingList* list) {
+    while (postingNeedsMerge(list)) {
+        PostingSegments* old = list->sealed;
+        int first = old->count - POSTING_MERGE_FANOUT;
+
+        int blockCount = 0;
+        uint32_t dataBytes = 0;
+        uint32_t positionBytes = 0;
+        for (int i = first; i < old->count; i++) {
+            blockCount += old->segments[i].blockCount;
+            dataBytes += old->segments[i].dataBytes;
+            positionBytes += old->segments[i].positionBytes;
+        }
+        bool withPositions = old->segments[first].positions != nullptr;
+        PostingSegment merged = allocSegment(blockCount, dataBytes, positionBytes, withPositions);
+        merged.previousId = old->segments[first].previousId;
+
+        int block = 0;
+        uint32_t dataOffset = 0;
+        uint32_t positionOffset = 0;
+        for (int i = first; i < old->count; i++) {
+            const PostingSegment& part = old->segments[i];
+            memcpy(merged.freqs + block * POSTING_BLOCK, part.freqs,
+                   sizeof(uint16_t) * part.blockCount * POSTING_BLOCK);
+            memcpy(merged.data + dataOffset, part.data, part.dataBytes);
+            if (withPositions) {
+                memcpy((uint8_t*)merged.positions + positionOffset, part.positions,
+                       part.positionBytes);
+            }
+            for (int b = 0; b < part.blockCount; b++) {
+                PostingSkip skip = part.skips[b];
+                skip.offset += dataOffset;
+                skip.positionEnd += positionOffset;
+                merged.skips[block++] = skip;
+            }
+            dataOffset += part.dataBytes;
+            positionOffset += part.positionBytes;
+        }
+
+        EPOCH_PUBLISH(list->sealed, replaceSegments(old, first, merged));
+        for (int i = first; i < old->count; i++) {
+            retireArray(old->segments[i].buffer);
+        }
+        retireMemory(old, freeSegmentDirectory);
+    }
+}
+
+// ===== COMPRIMIR UN BLOQUE COMPLETO AL FINAL DE LA CABEZA =====
+// Los lectores no lo ven hasta que el llamador publica count; positionEnd es
+// dónde acaban las posiciones de sus ids (en las de la cabeza)
+static void writeBlock(PostingList* list, const int* ids, const uint16_t* freqs, int blockIndex,
+                       uint32_t positionEnd) {
+    uint8_t encoded[POSTING_BLOCK * VARINT_MAX_BYTES];
+    uint32_t previous = blockIndex > 0 ? list->skips[blockIndex - 1].lastId
+                        : list->sealed ? list->sealed->lastId
+                                       : 0;
+    int bytes = encodeBlock(ids, previous, encoded);
+
+    if (list->dataBytes + bytes > list->dataCapacity) {
+        uint32_t newCapacity = list->dataCapacity ? list->dataCapacity * 2 : 256;
+        while (newCapacity < list->dataBytes + bytes) {
+            newCapacity *= 2;
+        }
+        uint8_t* newData = new uint8_t[newCapacity];
+        if (list->dataBytes > 0) {
+            memcpy(newData, list->data, list->dataBytes);
+        }
+        retireArray(list->data);
+        EPOCH_PUBLISH(list->data, newData);
+        list->dataCapacity = newCapacity;
+    }
+
+    if (blockIndex >= list->skipCapacity) {
+        int newCapacity = list->skipCapacity ? list->skipCapacity * 2 : 4;
+        PostingSkip* newSkips = new PostingSkip[newCapacity];
+        if (blockIndex > 0) {
+            memcpy(newSkips, list->skips, sizeof(PostingSkip) * blockIndex);
+        }
+        retireArray(list->skips);
+        EPOCH_PUBLISH(list->skips, newSkips);
+        list->skipCapacity = newCapacity;
+    }
+
+    memcpy(list->data + list->dataBytes, encoded, bytes);
+    list->skips[blockIndex].lastId = ids[POSTING_BLOCK - 1];
+    list->skips[blockIndex].offset = list->dataBytes;
+    list->skips[blockIndex].positionEnd = positionEnd;
+    list->skips[blockIndex].bestFreq = blockBestFreq(freqs);
+    list->dataBytes += bytes;
+}
+
+// ===== CONSTRUIR DE UNA VEZ (carga, ids fuera de orden, compactación) =====
+// Los bloques completos van a un solo segmento de su tamaño; el resto, a la cola
+PostingList* buildPostingList(const int* ids, const uint16_t* freqs, const uint8_t* positions,
+                              uint32_t positionBytes, int count) {
+    PostingList* list = createPostingList(positions != nullptr);
+
+    int blocks = count / POSTING_BLOCK;
+    uint32_t positionEnd = 0;
+    if (blocks > 0) {
+        vector<uint8_t> data((size_t)blocks * POSTING_BLOCK * VARINT_MAX_BYTES);
+        vector<PostingSkip> skips(blocks);
+        uint32_t dataBytes = 0;
+        uint32_t previous = 0;
+        for (int b = 0; b < blocks; b++) {
+            const int* blockIds = ids + b * POSTING_BLOCK;
+            for (int i = 0; positions && i < POSTING_BLOCK; i++) {
+                int size = postingPositionsSize(positions + positionEnd, positions + positionBytes);
+                positionEnd += size > 0 ? size : 0;
+            }
+            skips[b].lastId = blockIds[POSTING_BLOCK - 1];
+            skips[b].offset = dataBytes;
+            skips[b].positionEnd = positionEnd;
+            skips[b].bestFreq = blockBestFreq(freqs + b * POSTING_BLOCK);
+            dataBytes += encodeBlock(blockIds, previous, data.data() + dataBytes);
+            previous = skips[b].lastId;
+        }
+
+        PostingSegment segment = allocSegment(blocks, dataBytes, positionEnd, positions != nullptr);
+        memcpy(segment.skips, skips.data(), sizeof(PostingSkip) * blocks);
+        memcpy(segment.freqs, freqs, sizeof(uint16_t) * blocks * POSTING_BLOCK);
+        memcpy(segment.data, data.data(), dataBytes);
+        if (positions) {
+            memcpy((uint8_t*)segment.positions, positions, positionEnd);
+        }
+        list->sealed = replaceSegments(nullptr, 0, segment);
+    }
+
+    // La cola y sus posiciones en la cabeza
+    int rest = count % POSTING_BLOCK;
+    if (rest > list->tailCapacity) {
+        while (list->tailCapacity < rest) {
+            list->tailCapacity *= 2;
+        }
+        delete[] list->tail;
+        list->tail = new int[list->tailCapacity];
+    }
+    memcpy(list->tail, ids + blocks * POSTING_BLOCK, sizeof(int) * rest);
+
+    if (rest > list->freqCapacity) {
+        delete[] list->freqs;
+        list->freqCapacity = rest;
+        list->freqs = new uint16_t[list->freqCapacity];
+    }
+    memcpy(list->freqs, freqs + blocks * POSTING_BLOCK, sizeof(uint16_t) * rest);
+
+    if (positions && positionBytes - positionEnd > list->positionCapacity) {
+        delete[] list->positions;
+        list->positionCapacity = positionBytes - positionEnd;
+        list->positions = new uint8_t[list->positionCapacity];
+    }
+    if (positions) {
+        memcpy(list->positions, positions + positionEnd, positionBytes - positionEnd);
+        list->positionBytes = positionBytes - positionEnd;
+    }
+
+    for (int i = 0; i < count; i++) {
+        list->bestFreq = bestPostingFreq(list->bestFreq, freqs[i]);
+    }
+    list->count = count;
+    list->lastId = count > 0 ? ids[count - 1] : -1;
+    return list;
+}
+
+// Las de los bloques completos (el segmento de buildPostingList) se quedan
+// en el archivo; las de la cola se copian a la cabeza, que sí crece
+void mapPostingPositions(PostingList* list, const uint8_t* positions, uint32_t positionBytes,
+                         const uint32_t* blockEnds) {
+    int blocks = list->count / POSTING_BLOCK;
+    uint32_t sealedEnd = blocks > 0 ? blockEnds[blocks - 1] : 0;
+    if (list->sealed) {
+        PostingSegment& segment = list->sealed->segments[0];
+        segment.positions = positions;
+        segment.positionBytes = sealedEnd;
+        for (int b = 0; b < blocks; b++) {
+            segment.skips[b].positionEnd = blockEnds[b];
+        }
+    }
+
+    delete[] list->positions;
+    list->positionBytes = positionBytes - sealedEnd;
+    list->positionCapacity = max(list->positionBytes, (uint32_t)16);
+    list->positions = new uint8_t[list->positionCapacity];
+    memcpy(list->positions, positions + sealedEnd, list->positionBytes);
+}
+
+// ===== AÑADIR AL FINAL =====
+// Las posiciones van al final de las de la cabeza y se publican antes que count
+static void appendPositions(PostingList* list, const uint8_t* positions, int positionBytes) {
+    uint8_t empty[2] = {0, 0};
+    if (!positions || positionBytes <= 0) {
+        positions = empty;
+        positionBytes = sizeof(empty);
+    }
+
+    if (list->positionBytes + positionBytes > list->positionCapacity) {
+        uint32_t newCapacity = list->positionCapacity * 2;
+        while (newCapacity < list->positionBytes + positionBytes) {
+            newCapacity *= 2;
+        }
+        uint8_t* newPositions = new uint8_t[newCapacity];
+        memcpy(newPositions, list->positions, list->positionBytes);
+        retireArray(list->positions);
+        EPOCH_PUBLISH(list->positions, newPositions);
+        list->positionCapacity = newCapacity;
+    }
+    memcpy(list->positions + list->positionBytes, positions, positionBytes);
+    EPOCH_PUBLISH(list->positionBytes, list->positionBytes + positionBytes);
+}
+
+bool appendPosting(PostingList* list, int id, uint16_t freq, const uint8_t* positions,
+                   int positionBytes) {
+    if (id <= list->lastId) {
+        return false;
+    }
+    if (list->positions) {
+        appendPositions(list, positions, positionBytes);
+    }
+
+    // La frecuencia va antes que el count que la hace visible
+    int headCount = list->count - (list->sealed ? list->sealed->blockCount * POSTING_BLOCK : 0);
+    if (headCount >= list->freqCapacity) {
+        int newCapacity = list->freqCapacity * 2;
+        uint16_t* newFreqs = new uint16_t[newCapacity];
+        memcpy(newFreqs, list->freqs, sizeof(uint16_t) * headCount);
+        retireArray(list->freqs);
+        EPOCH_PUBLISH(list->freqs, newFreqs);
+        list->freqCapacity = newCapacity;
+    }
+    list->freqs[headCount] = freq;
+    EPOCH_PUBLISH(list->bestFreq, bestPostingFreq(list->bestFreq, freq));
+
+    int tailCount = list->count % POSTING_BLOCK;
+    if (tailCount + 1 == POSTING_BLOCK) {
+        // La cola se llena: pasa a ser un bloque comprimido y empieza otra.
+        // Primero count (el bloque ya está) y después la cola nueva: quien
+        // vea la cola nueva ya ve el count que no la usa (ver postingBegin)
+        int ids[POSTING_BLOCK];
+        memcpy(ids, list->tail, sizeof(int) * tailCount);
+        ids[tailCount] = id;
+        int blockIndex = headCount / POSTING_BLOCK;
+        writeBlock(list, ids, list->freqs + blockIndex * POSTING_BLOCK, blockIndex,
+                   list->positionBytes);
+
+        int* oldTail = list->tail;
+        list->tailCapacity = 4;
+        EPOCH_PUBLISH(list->count, list->count + 1);
+        EPOCH_PUBLISH(list->tail, new int[list->tailCapacity]);
+        retireArray(oldTail);
+
+        if (blockIndex + 1 == POSTING_SEGMENT_BLOCKS) {
+            sealHead(list, blockIndex + 1);
+        }
+    } else {
+        if (tailCount >= list->tailCapacity) {
+            int newCapacity = list->tailCapacity * 2;
+            int* newTail = new int[newCapacity];
+            memcpy(newTail, list->tail, sizeof(int) * tailCount);
+            retireArray(list->tail);
+            EPOCH_PUBLISH(list->tail, newTail);
+            list->tailCapacity = newCapacity;
+        }
+        list->tail[tailCount] = id;
+        EPOCH_PUBLISH(list->count, list->count + 1);
+    }
+
+    list->lastId = id;
+    return true;
+}
+
+bool containsPosting(const PostingList* list, int id) {
+    PostingIterator it;
+    postingBegin(&it, list);
+    return postingAdvanceTo(&it, id) && it.id == id;
+}
+
+int postingCount(const PostingList* list) {
+    return EPOCH_LOAD(list->count);
+}
+
+size_t postingMemory(const PostingList* list) {
+    size_t bytes = sizeof(PostingList) + list->dataCapacity +
+                   sizeof(PostingSkip) * list->skipCapacity + sizeof(int) * list->tailCapacity +
+                   sizeof(uint16_t) * list->freqCapacity + list->positionCapacity;
+    if (list->sealed) {
+        bytes += sizeof(PostingSegments) + sizeof(PostingSegment) * list->sealed->count;
+        for (int i = 0; i < list->sealed->count; i++) {
+            bytes += list->sealed->segments[i].bufferBytes;
+        }
+    }
+    return bytes;
+}
+
+void postingIds(const PostingList* list, vector<int>& ids) {
+    PostingIterator it;
+    postingBegin(&it, list);
+    ids.reserve(ids.size() + it.blockCount * POSTING_BLOCK + it.tailCount);
+    while (postingNext(&it)) {
+        ids.push_back(it.id);
+    }
+}
+
+// ===== RECORRIDO =====
+static void resetIterator(PostingIterator* it) {
+    it->positionBlock = -1;
+    it->block = -1;
+    it->segment = 0;
+    it->decodedCount = 0;
+    it->position = 0;
+    it->id = -1;
+    it->freq = 0;
+    it->boundBlock = 0;
+    it->boundSegment = 0;
+    it->tailBestFreq = -1;
+}
+
+void postingBegin(PostingIterator* it, const PostingList* list) {
+    const PostingSegments* sealed;
+    const int* tail;
+    int count;
+    int sequence;
+    do {
+        do {
+            sequence = EPOCH_LOAD(list->sealSequence);
+        } while (sequence & 1);
+
+        // Cola y count del mismo momento: si la cola cambió mientras se leía
+        // count, puede que count ya cuente ids de la cola nueva
+        do {
+            tail = EPOCH_LOAD(list->tail);
+            count = EPOCH_LOAD(list->count);
+        } while (tail != EPOCH_LOAD(list->tail));
+
+        sealed = EPOCH_LOAD(list->sealed);
+        it->head.data = EPOCH_LOAD(list->data);
+        it->head.skips = EPOCH_LOAD(list->skips);
+        // Después de count: tiene al menos las frecuencias de esos ids
+        it->head.freqs = EPOCH_LOAD(list->freqs);
+        // positionBytes después de count y el array después de positionBytes
+        it->head.positionBytes = EPOCH_LOAD(list->positionBytes);
+        it->head.positions = EPOCH_LOAD(list->positions);
+    } while (EPOCH_LOAD(list->sealSequence) != sequence);
+
+    it->segments = sealed ? sealed->segments : nullptr;
+    it->segmentCount = sealed ? sealed->count : 0;
+    it->tail = tail;
+    it->blockCount = count / POSTING_BLOCK;
+    it->tailCount = count % POSTING_BLOCK;
+    it->head.firstBlock = sealed ? sealed->blockCount : 0;
+    it->head.blockCount = it->blockCount - it->head.firstBlock;
+    it->head.previousId = sealed ? sealed->lastId : 0;
+    it->bestFreq = EPOCH_LOAD(list->bestFreq);
+    it->hasPositions = it->head.positions != nullptr;
+    resetIterator(it);
+}
+
+void postingBeginIds(PostingIterator* it, const int* ids, const uint16_t* freqs, int count,
+                     const uint8_t* positions, uint32_t positionBytes) {
+    it->segments = nullptr;
+    it->segmentCount = 0;
+    it->tail = ids;
+    it->blockCount = 0;
+    it->tailCount = count;
+    it->head.data = nullptr;
+    it->head.skips = nullptr;
+    it->head.freqs = (uint16_t*)freqs;
+    it->head.positions = positions;
+    it->head.positionBytes = positionBytes;
+    it->head.firstBlock = 0;
+    it->head.blockCount = 0;
+    it->head.previousId = 0;
+    it->bestFreq = POSTING_FREQ_WORST;
+    for (int i = 0; i < count; i++) {
+        it->bestFreq = bestPostingFreq(it->bestFreq, freqs[i]);
+    }
+    it->hasPositions = positions != nullptr;
+    resetIterator(it);
+    it->tailBestFreq = it->bestFreq;
+}
+
+static const PostingSegment* segmentAt(const PostingIterator* it, int segment) {
+    return segment < it->segmentCount ? &it->segments[segment] : &it->head;
+}
+
+// Segmento de block (la cola es de la cabeza) buscando hacia delante desde segment
+static int segmentOf(const PostingIterator* it, int block, int segment) {
+    while (segment < it->segmentCount &&
+           block >= it->segments[segment].firstBlock + it->segments[segment].blockCount) {
+        segment++;
+    }
+    return segment;
+}
+
+// Primer bloque desde block (< blockCount) cuyo último id llega a target;
+// los segmentos que acaban por debajo se saltan sin mirar sus skips.
+// blockCount si no hay ninguno
+static int findBlock(const PostingIterator* it, int block, int* segment, int target) {
+    while (block < it->blockCount) {
+        *segment = segmentOf(it, block, *segment);
+        const PostingSegment* current = segmentAt(it, *segment);
+        if (current->skips[current->blockCount - 1].lastId < (uint32_t)target) {
+            block = current->firstBlock + current->blockCount;
+            continue;
+        }
+        while (current->skips[block - current->firstBlock].lastId < (uint32_t)target) {
+            block++;
+        }
+        return block;
+    }
+    return block;
+}
+
+static void loadBlock(PostingIterator* it, int block) {
+    it->block = block;
+    it->position = -1;
+    it->segment = segmentOf(it, block, it->segment);
+    const PostingSegment* segment = segmentAt(it, it->segment);
+    int local = block - segment->firstBlock;
+    it->blockFreqs = segment->freqs + local * POSTING_BLOCK;
+
+    if (block == it->blockCount) {
+        memcpy(it->ids, it->tail, sizeof(int) * it->tailCount);
+        it->decodedCount = it->tailCount;
+        return;
+    }
+
+    const uint8_t* in = segment->data + segment->skips[local].offset;
+    uint32_t previous = local > 0 ? segment->skips[local - 1].lastId : segment->previousId;
+    for (int i = 0; i < POSTING_BLOCK; i++) {
+        uint32_t delta;
+        in = decodeVarint(in, &delta);
+        previous += delta;
+        it->ids[i] = (int)previous;
+    }
+    it->decodedCount = POSTING_BLOCK;
+}
+
+bool postingNext(PostingIterator* it) {
+    while (++it->position >= it->decodedCount) {
+        if (it->block >= it->blockCount) {
+            it->id = -1;
+            return false;
+        }
+        loadBlock(it, it->block + 1);
+    }
+    it->id = it->ids[it->position];
+    it->freq = it->blockFreqs[it->position];
+    return true;
+}
+
+bool postingAdvanceTo(PostingIterator* it, int target) {
+    if (it->id >= target) {
+        return true;
+    }
+
+    // Saltar los bloques cuyo último id queda por debajo
+    if (it->block < it->blockCount) {
+        int segment = it->segment;
+        int block = findBlock(it, it->block < 0 ? 0 : it->block, &segment, target);
+        if (block != it->block) {
+            loadBlock(it, block);
+        }
+    }
+
+    while (postingNext(it)) {
+        if (it->id >= target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool postingAdvanceInField(PostingIterator* it, int target, int field) {
+    if (!postingAdvanceTo(it, target)) {
+        return false;
+    }
+    while (!postingInField(it->freq, field)) {
+        if (!postingNext(it)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool postingBlockBound(PostingIterator* it, int target, int* lastId, uint16_t* bestFreq) {
+    int block = findBlock(it, it->boundBlock, &it->boundSegment, target);
+    it->boundBlock = block;
+
+    if (block < it->blockCount) {
+        const PostingSegment* segment = segmentAt(it, it->boundSegment);
+        const PostingSkip& skip = segment->skips[block - segment->firstBlock];
+        *lastId = (int)skip.lastId;
+        *bestFreq = skip.bestFreq;
+        return true;
+    }
+
+    // La cola: su cota se calcula la primera vez que hace falta
+    if (it->tailCount == 0 || it->tail[it->tailCount - 1] < target) {
+        return false;
+    }
+    if (it->tailBestFreq < 0) {
+        uint16_t tailBest = POSTING_FREQ_WORST;
+        const uint16_t* freqs = it->head.freqs + it->head.blockCount * POSTING_BLOCK;
+        for (int i = 0; i < it->tailCount; i++) {
+            tailBest = bestPostingFreq(tailBest, freqs[i]);
+        }
+        it->tailBestFreq = tailBest;
+    }
+    *lastId = it->tail[it->tailCount - 1];
+    *bestFreq = (uint16_t)it->tailBestFreq;
+    return true;
+}
+
+bool postingPositions(PostingIterator* it, PostingPositions* positions) {
+    if (!it->hasPositions || it->id < 0) {
+        return false;
+    }
+
+    // Las de un bloque empiezan donde acaban las del anterior del segmento;
+    // dentro del bloque se avanza desde la última leída (el recorrido va en orden)
+    const PostingSegment* segment = segmentAt(it, it->segment);
+    int local = it->block - segment->firstBlock;
+    const uint8_t* end = segment->positions + (it->block < it->blockCount
+                                                   ? segment->skips[local].positionEnd
+                                                   : segment->positionBytes);
+    if (it->positionBlock != it->block || it->positionIndex > it->position) {
+        it->positionBlock = it->block;
+        it->positionIndex = 0;
+        it->positionOffset = local > 0 ? segment->skips[local - 1].positionEnd : 0;
+    }
+    while (it->positionIndex < it->position) {
+        int size = postingPositionsSize(segment->positions + it->positionOffset, end);
+        if (size < 0) {
+            return false;
+        }
+        it->positionOffset += size;
+        it->positionIndex++;
+    }
+    return decodePostingPositions(segment->positions + it->positionOffset, end, positions);
+}
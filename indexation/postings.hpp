@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ===== LISTAS DE POSTINGS COMPRIMIDAS =====
+// Ids ordenados de menor a mayor y sin repetir. Cada POSTING_BLOCK ids forman
+// un bloque comprimido (diferencia con el id anterior en varint) con una
+// entrada de salto (último id del bloque + offset), así se pueden saltar
+// bloques enteros sin descomprimirlos. Los ids más recientes esperan sin
+// comprimir en la cola hasta completar un bloque.
+//
+// Cada id lleva además 16 bits para BM25, sin comprimir en freqs: cuántas
+// veces sale la palabra en el título y en el artista de la canción y cuántas
+// palabras tenían esos campos al indexarla. Cada bloque y la lista entera
+// guardan su mejor combinación posible (ver bestPostingFreq): es la cota de
+// puntuación con la que el top-k se salta bloques sin abrirlos.
+//
+// Opcionalmente, cada id lleva también sus posiciones (ver PostingPositions)
+// en un array aparte que solo leen las frases; cada bloque apunta en su skip
+// a dónde acaban las suyas. Las de una lista cargada pueden quedarse en el
+// archivo mapeado: el sistema trae las páginas cuando una frase las lee.
+//
+// Segmentos (como un LSM): los bloques completos no se quedan en arrays que
+// crecen copiándose. Cada POSTING_SEGMENT_BLOCKS bloques la cabeza (la parte
+// que aún crece, con la cola) se sella en un segmento inmutable de tamaño
+// justo, una sola reserva con skips, frecuencias, datos y posiciones, y se
+// empieza otra vacía. Los segmentos tienen ids crecientes, así que el
+// recorrido los encadena sin mezclar. Cada segmento tiene un nivel según su
+// tamaño y la fusión (mergePostingSegments, desde el tick) junta los
+// POSTING_MERGE_FANOUT últimos cuando son del mismo nivel en uno del
+// siguiente, para que una lista nunca tenga muchos.
+//
+// Concurrencia (ver epoch.hpp): el escritor solo añade al final y publica
+// count; un id fuera de orden o la compactación construyen una lista nueva
+// que se publica entera en su lugar. Sellar cambia a la vez el directorio de
+// segmentos y la cabeza: el lector lo detecta con sealSequence y repite.
+
+#define POSTING_BLOCK 128
+#define POSTING_SEGMENT_BLOCKS 16
+#define POSTING_MERGE_FANOUT 4
+
+// ===== FRECUENCIA: 4 bits por dato (máx 15) =====
+// De abajo a arriba: veces en el título, veces en el artista, palabras del
+// título y palabras del artista
+inline uint16_t makePostingFreq(int titleCount, int artistCount, int titleLength, int artistLength) {
+    return (uint16_t)(std::min(titleCount, 15) | std::min(artistCount, 15) << 4 |
+                      std::min(titleLength, 15) << 8 | std::min(artistLength, 15) << 12);
+}
+inline int postingTitleFreq(uint16_t freq) { return freq & 0x0f; }
+inline int postingArtistFreq(uint16_t freq) { return freq >> 4 & 0x0f; }
+inline int postingTitleLength(uint16_t freq) { return freq >> 8 & 0x0f; }
+inline int postingArtistLength(uint16_t freq) { return freq >> 12; }
+
+// ===== CAMPO (consultas con title: / artist:) =====
+#define POSTING_FIELD_ANY    0
+#define POSTING_FIELD_TITLE  1
+#define POSTING_FIELD_ARTIST 2
+
+// ¿Sale la palabra en ese campo de la canción?
+inline bool postingInField(uint16_t freq, int field) {
+    return field == POSTING_FIELD_ANY ||
+           (field == POSTING_FIELD_TITLE ? postingTitleFreq(freq) : postingArtistFreq(freq)) > 0;
+}
+
+// Sin apariciones y con los campos más largos: la peor posible
+#define POSTING_FREQ_WORST 0xff00
+// Campo a campo, más apariciones y menos palabras: BM25 puntúa esta al menos
+// tanto como cualquiera de las dos
+inline uint16_t bestPostingFreq(uint16_t a, uint16_t b) {
+    return (uint16_t)(std::max(a & 0x000f, b & 0x000f) | std::max(a & 0x00f0, b & 0x00f0) |
+                      std::min(a & 0x0f00, b & 0x0f00) | std::min(a & 0xf000, b & 0xf000));
+}
+
+// ===== POSICIONES: en qué palabra de cada campo sale (contando desde 0, como extractWords) =====
+// Codificadas como nº de posiciones del título y diferencias con la anterior,
+// y lo mismo del artista, todo en varint
+#define POSTING_MAX_POSITIONS 64
+#define POSTING_MAX_POSITION_BYTES (2 * (1 + 2 * POSTING_MAX_POSITIONS))
+
+struct PostingPositions {
+    int titleCount;
+    int artistCount;
+    uint8_t title[POSTING_MAX_POSITIONS];
+    uint8_t artist[POSTING_MAX_POSITIONS];
+};
+
+// out necesita POSTING_MAX_POSITION_BYTES; devuelve los bytes escritos
+int encodePostingPositions(const PostingPositions* positions, uint8_t* out);
+// Bytes de las posiciones que empiezan en data (-1 si se salen de end)
+int postingPositionsSize(const uint8_t* data, const uint8_t* end);
+
+struct PostingSkip {
+    uint32_t lastId;        // último id del bloque
+    uint32_t offset;        // inicio del bloque en data
+    uint32_t positionEnd;   // fin de las posiciones del bloque
+    uint16_t bestFreq;      // mejor frecuencia posible del bloque
+};
+
+// ===== SEGMENTO SELLADO (no cambia nunca una vez publicado) =====
+// Los offsets y positionEnd de sus skips son relativos a su data / positions
+struct PostingSegment {
+    uint8_t* buffer;            // la reserva con todo (se libera con el segmento)
+    size_t bufferBytes;
+    PostingSkip* skips;
+    uint16_t* freqs;            // POSTING_BLOCK por bloque
+    uint8_t* data;
+    uint32_t dataBytes;
+    const uint8_t* positions;   // en buffer o en el archivo mapeado (nullptr = sin ellas)
+    uint32_t positionBytes;
+    int blockCount;
+    int firstBlock;             // nº del primero contando los de los anteriores
+    uint32_t previousId;        // último id antes del segmento (base del primer delta)
+    int level;
+};
+
+// Directorio publicado entero: se sustituye al sellar y al fusionar
+struct PostingSegments {
+    PostingSegment* segments;
+    int count;
+    int blockCount;             // suma de los de todos
+    uint32_t lastId;            // último id del último segmento
+};
+
+struct PostingList {
+    PostingSegments* sealed;    // nullptr = ninguno todavía
+    int sealSequence;           // impar mientras se sella
+
+    // ===== CABEZA: bloques desde el último sellado + cola =====
+    uint8_t* data;          // bloques comprimidos, uno detrás de otro
+    uint32_t dataBytes;
+    uint32_t dataCapacity;
+
+    PostingSkip* skips;     // una entrada por bloque
+    int skipCapacity;
+
+    int* tail;              // últimos count % POSTING_BLOCK ids, sin comprimir
+    int tailCapacity;
+
+    uint16_t* freqs;        // una por id de la cabeza, en el mismo orden
+    int freqCapacity;
+
+    uint8_t* positions;         // las de cada id seguidas (nullptr = lista sin posiciones)
+    uint32_t positionBytes;     // se publica antes que count
+    uint32_t positionCapacity;
+
+    int count;              // todos: los bloques sellados, los de la cabeza y la cola
+    int lastId;             // -1 si está vacía (solo la usa el escritor)
+    uint16_t bestFreq;      // mejor posible de toda la lista
+};
+
+// ===== RECORRIDO =====
+// Los bloques se numeran seguidos a través de los segmentos; la cabeza va
+// como un segmento más (el último) y la cola es su bloque blockCount
+struct PostingIterator {
+    const PostingSegment* segments;     // sellados
+    int segmentCount;
+    PostingSegment head;
+    const int* tail;
+    int blockCount;             // todos los completos
+    int tailCount;
+
+    int block;                  // bloque decodificado (blockCount = la cola)
+    int segment;                // su segmento (segmentCount = la cabeza)
+    const uint16_t* blockFreqs;
+    int ids[POSTING_BLOCK];
+    int decodedCount;
+    int position;
+
+    int id;                     // id actual (-1 antes de empezar o al acabar)
+    uint16_t freq;              // su frecuencia
+
+    uint16_t bestFreq;          // de toda la lista
+    int boundBlock;             // bloque de la última postingBlockBound
+    int boundSegment;
+    int tailBestFreq;           // de la cola (-1 = sin calcular)
+
+    bool hasPositions;
+    int positionBlock;          // dónde se quedó postingPositions
+    int positionIndex;
+    uint32_t positionOffset;
+};
+
+// ===== FUNCIONES =====
+
+PostingList* createPostingList(bool withPositions);
+// ids ordenados y sin repetir, freqs y posiciones en el mismo orden
+// (positions = nullptr: lista sin posiciones)
+PostingList* buildPostingList(const int* ids, const uint16_t* freqs, const uint8_t* positions,
+                              uint32_t positionBytes, int count);
+// Usar sin copiar las posiciones guardadas de una lista recién construida sin
+// ellas (blockEnds: fin de las de cada bloque completo)
+void mapPostingPositions(PostingList* list, const uint8_t* positions, uint32_t positionBytes,
+                         const uint32_t* blockEnds);
+void freePostingList(PostingList* list);
+// Liberar cuando ningún lector pueda tenerla (tras publicar la que la sustituye)
+void retirePostingList(PostingList* list);
+
+// Añadir un id mayor que todos los de la lista (false si no lo es); las
+// posiciones se ignoran si la lista no las lleva
+bool appendPosting(PostingList* list, int id, uint16_t freq, const uint8_t* positions,
+                   int positionBytes);
+bool containsPosting(const PostingList* list, int id);
+
+int postingCount(const PostingList* list);
+size_t postingMemory(const PostingList* list);
+// ¿Hay POSTING_MERGE_FANOUT segmentos del mismo nivel al final?
+bool postingNeedsMerge(const PostingList* list);
+// Fusionarlos (y los que eso encadene); los viejos se retiran
+void mergePostingSegments(PostingList* list);
+// Todos los ids, en orden
+void postingIds(const PostingList* list, std::vector<int>& ids);
+
+void postingBegin(PostingIterator* it, const PostingList* list);
+// Recorrer ids ordenados sueltos (listas cortas guardadas fuera de una PostingList)
+void postingBeginIds(PostingIterator* it, const int* ids, const uint16_t* freqs, int count,
+                     const uint8_t* positions, uint32_t positionBytes);
+// Avanza al siguiente id (it->id); false al acabar
+bool postingNext(PostingIterator* it);
+// Avanza al primer id >= target saltando bloques; false si no hay
+bool postingAdvanceTo(PostingIterator* it, int target);
+// Lo mismo, saltando los ids que no tienen la palabra en field
+bool postingAdvanceInField(PostingIterator* it, int target, int field);
+// Sin descomprimir: del bloque donde estaría el primer id >= target, su
+// último id y su mejor frecuencia. false si no quedan ids >= target.
+// target no puede bajar entre llamadas
+bool postingBlockBound(PostingIterator* it, int target, int* lastId, uint16_t* bestFreq);
+// Posiciones del id actual; false si la lista no las tiene
+bool postingPositions(PostingIterator* it, PostingPositions* positions);
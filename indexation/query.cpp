@@ -0,0 +1,639 @@
+#include "query.hpp"
+#include "bktree.hpp"
+#include "epoch.hpp"
+#include "inverted_index.hpp"
+#include "postings.hpp"
+#include "roaring.hpp"
+#include "sorted_ids.hpp"
+#include "trie.hpp"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <strings.h>
+
+using namespace std;
+
+// Trozo de consulta entre espacios (o entre comillas)
+#define QUERY_MAX_TOKEN 256
+
+// ===== TOLERANCIA FUZZY SEGÚN EL LARGO =====
+// Con distancia 2 una palabra de 3-4 letras se parece a medio diccionario y
+// el AND deja de filtrar nada
+static int fuzzyTolerance(const char* word) {
+    size_t length = strlen(word);
+    if (length <= 3) return 0;
+    if (length <= 6) return 1;
+    return 2;
+}
+
+// ===== PARSEAR =====
+// word es una fila de extractWords (64 bytes con su '\0')
+static void addQueryTerm(Query* query, const char word[64], bool exact, int clause, int phrase,
+                         int field) {
+    QueryTerm* term = &query->terms[query->termCount++];
+    memcpy(term->word, word, sizeof(term->word));
+    term->exact = exact;
+    term->clause = clause;
+    term->phrase = phrase;
+    term->field = field;
+}
+
+// "title:" / "artist:" delante del trozo (el resto no puede estar vacío)
+static int parseField(const char** p) {
+    const char* names[] = {"title:", "artist:"};
+    int fields[] = {POSTING_FIELD_TITLE, POSTING_FIELD_ARTIST};
+    for (int i = 0; i < 2; i++) {
+        size_t length = strlen(names[i]);
+        if (strncasecmp(*p, names[i], length) == 0 && (*p)[length] &&
+            !isspace((unsigned char)(*p)[length])) {
+            *p += length;
+            return fields[i];
+        }
+    }
+    return POSTING_FIELD_ANY;
+}
+
+bool parseQuery(const char* text, Query* query) {
+    query->termCount = 0;
+    query->clauseCount = 0;
+    query->phraseCount = 0;
+    if (!text) {
+        return false;
+    }
+
+    bool pendingOr = false;
+    bool pendingNot = false;
+    int lastClause = -1;    // grupo de la última palabra no excluida
+
+    const char* p = text;
+    while (*p && query->termCount < QUERY_MAX_TERMS) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+
+        bool negated = false;
+        if (*p == '-' && p[1] && !isspace((unsigned char)p[1])) {
+            negated = true;
+            p++;
+        }
+        int field = parseField(&p);
+
+        // Trozo entre comillas o hasta el siguiente espacio
+        char raw[QUERY_MAX_TOKEN];
+        int length = 0;
+        bool quoted = (*p == '"');
+        if (quoted) {
+            p++;
+            while (*p && *p != '"') {
+                if (length < QUERY_MAX_TOKEN - 1) raw[length++] = *p;
+                p++;
+            }
+            if (*p == '"') p++;
+        } else {
+            while (*p && !isspace((unsigned char)*p) && *p != '"') {
+                if (length < QUERY_MAX_TOKEN - 1) raw[length++] = *p;
+                p++;
+            }
+        }
+        raw[length] = '\0';
+
+        // "..."~N: proximidad
+        int slop = 0;
+        if (quoted && *p == '~' && isdigit((unsigned char)p[1])) {
+            p++;
+            while (isdigit((unsigned char)*p)) {
+                slop = min(slop * 10 + (*p - '0'), POSTING_MAX_POSITIONS);
+                p++;
+            }
+        }
+
+        // Operadores: solo en mayúsculas ("or" y "not" son palabras normales)
+        if (!quoted && !negated && strcmp(raw, "OR") == 0) {
+            pendingOr = true;
+            continue;
+        }
+        if (!quoted && !negated && strcmp(raw, "NOT") == 0) {
+            pendingNot = true;
+            continue;
+        }
+
+        char words[QUERY_MAX_TERMS][64];
+        int wordCount = 0;
+        extractWords(raw, words, &wordCount, QUERY_MAX_TERMS - query->termCount);
+        if (wordCount == 0) {
+            continue;
+        }
+
+        bool excluded = negated || pendingNot;
+        if (quoted && wordCount > 1 && query->phraseCount < QUERY_MAX_PHRASES) {
+            // Frase: cada palabra es un grupo del AND (o un término de la
+            // exclusión) y la frase se comprueba aparte
+            QueryPhrase* phrase = &query->phrases[query->phraseCount];
+            phrase->firstTerm = query->termCount;
+            phrase->termCount = wordCount;
+            phrase->slop = slop;
+            phrase->excluded = excluded;
+            for (int i = 0; i < wordCount; i++) {
+                addQueryTerm(query, words[i], true, excluded ? -1 : query->clauseCount++,
+                             query->phraseCount, field);
+            }
+            query->phraseCount++;
+            lastClause = -1;
+            pendingOr = false;
+            pendingNot = false;
+            continue;
+        }
+
+        for (int i = 0; i < wordCount; i++) {
+            if (excluded) {
+                addQueryTerm(query, words[i], true, -1, -1, field);
+            } else if (i == 0 && pendingOr && lastClause >= 0) {
+                addQueryTerm(query, words[i], quoted, lastClause, -1, field);
+            } else {
+                lastClause = query->clauseCount++;
+                addQueryTerm(query, words[i], quoted, lastClause, -1, field);
+            }
+        }
+        if (excluded) {
+            lastClause = -1;
+        }
+        pendingOr = false;
+        pendingNot = false;
+    }
+
+    return query->clauseCount > 0;
+}
+
+// ===== IDS DE UN TÉRMINO / DE UN GRUPO OR (sin ordenar) =====
+// Los postings de una palabra con los que la tienen en field
+static void collectFieldIds(WordEntry* entry, int field, vector<int>& ids) {
+    PostingIterator it;
+    wordPostingsBegin(&it, entry);
+    while (postingNext(&it)) {
+        if (postingInField(it.freq, field)) {
+            ids.push_back(it.id);
+        }
+    }
+}
+
+static void collectTermIds(SongDatabase* db, const QueryTerm* term, vector<int>& ids) {
+    // Con campo: la palabra y cada una de las que valen por prefijo o
+    // parecido, filtrando sus postings (el trie y el BK-tree no saben de campos)
+    if (term->field != POSTING_FIELD_ANY) {
+        vector<string> words;
+        expandQueryTerm(db, term, words, INT_MAX);
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+        for (const string& word : words) {
+            WordEntry* entry = findWord(db->invertedIndex, word.c_str());
+            if (entry) {
+                collectFieldIds(entry, term->field, ids);
+            }
+        }
+        return;
+    }
+
+    if (term->exact) {
+        WordEntry* entry = findWord(db->invertedIndex, term->word);
+        if (entry) {
+            wordPostingIds(entry, ids);
+        }
+        return;
+    }
+
+    // El prefijo incluye la palabra exacta
+    if (db->trie) {
+        searchPrefix(db->trie, term->word, ids);
+    }
+    BKNode* bkTree = EPOCH_LOAD(db->bkTree);
+    int tolerance = fuzzyTolerance(term->word);
+    if (bkTree && tolerance > 0) {
+        recursiveBKSearch(bkTree, term->word, tolerance, ids);
+    }
+}
+
+bool expandQueryTerm(SongDatabase* db, const QueryTerm* term, vector<string>& words,
+                     int maxWords) {
+    if (term->exact) {
+        words.push_back(term->word);
+        return true;
+    }
+
+    if (db->trie && !collectPrefixWords(db->trie, term->word, words, maxWords)) {
+        return false;
+    }
+    BKNode* bkTree = EPOCH_LOAD(db->bkTree);
+    int tolerance = fuzzyTolerance(term->word);
+    if (bkTree && tolerance > 0) {
+        recursiveBKSearchWords(bkTree, term->word, tolerance, words);
+    }
+    return (int)words.size() <= maxWords;
+}
+
+// ¿Tantos ids (con repetidos) que sale mejor un mapa de bits que ordenarlos?
+static bool denseIdCount(SongDatabase* db, size_t count) {
+    return count >= ROARING_MIN_IDS &&
+           count * ROARING_DENSITY >= (size_t)EPOCH_LOAD(db->rankedSongCount);
+}
+
+// Ordenados en ids, o en dense si son muchos (devuelve true y deja ids vacío)
+static bool collectClauseIds(SongDatabase* db, const Query* query, int clause, vector<int>& ids,
+                             RoaringBitmap* dense) {
+    int sources = 0;
+    for (int i = 0; i < query->termCount; i++) {
+        if (query->terms[i].clause == clause) {
+            collectTermIds(db, &query->terms[i], ids);
+            sources += query->terms[i].exact ? 1 : 2;
+        }
+    }
+    if (denseIdCount(db, ids.size())) {
+        roaringFromIds(dense, ids.data(), ids.size());
+        vector<int>().swap(ids);
+        return true;
+    }
+    // Una sola lista exacta ya sale ordenada
+    if (sources > 1) {
+        sortUniqueIds(ids);
+    }
+    return false;
+}
+
+// ===== FILTRAR CANDIDATOS CONTRA POSTINGS (sin descomprimirlos enteros) =====
+// Los candidatos van en orden, así que cada lista solo avanza: los bloques
+// que no pueden contener el siguiente candidato se saltan por su skip
+struct TermCursor {
+    PostingIterator it;
+    int field;
+};
+
+static void openClauseCursors(SongDatabase* db, const Query* query, int clause,
+                              vector<TermCursor>& cursors) {
+    for (int i = 0; i < query->termCount; i++) {
+        if (query->terms[i].clause != clause || (clause < 0 && query->terms[i].phrase >= 0)) {
+            continue;
+        }
+        WordEntry* entry = findWord(db->invertedIndex, query->terms[i].word);
+        if (entry) {
+            cursors.emplace_back();
+            wordPostingsBegin(&cursors.back().it, entry);
+            cursors.back().field = query->terms[i].field;
+        }
+    }
+}
+
+static bool cursorsContain(vector<TermCursor>& cursors, int id) {
+    bool found = false;
+    for (TermCursor& cursor : cursors) {
+        // Todas avanzan hasta id aunque ya se haya encontrado
+        if (postingAdvanceInField(&cursor.it, id, cursor.field) && cursor.it.id == id) {
+            found = true;
+        }
+    }
+    return found;
+}
+
+// ===== NOT SOBRE UN RESULTADO DENSO =====
+// Se restan los postings de las palabras excluidas como otro mapa de bits;
+// las quitadas con postings viejos vuelven (las decide el llamador). Deja el
+// resultado ordenado en ids
+static void excludeDenseIds(SongDatabase* db, const Query* query, RoaringBitmap* running,
+                            vector<int>& ids) {
+    vector<int> excludedIds;
+    for (int i = 0; i < query->termCount; i++) {
+        if (!isExcludedTerm(&query->terms[i])) {
+            continue;
+        }
+        WordEntry* entry = findWord(db->invertedIndex, query->terms[i].word);
+        if (entry && query->terms[i].field != POSTING_FIELD_ANY) {
+            collectFieldIds(entry, query->terms[i].field, excludedIds);
+        } else if (entry) {
+            wordPostingIds(entry, excludedIds);
+        }
+    }
+    if (excludedIds.empty()) {
+        roaringToIds(running, ids);
+        return;
+    }
+
+    RoaringBitmap excluded;
+    roaringFromIds(&excluded, excludedIds.data(), excludedIds.size());
+    RoaringBitmap kept;
+    RoaringBitmap removed;
+    roaringAndNot(running, &excluded, &kept);
+    roaringAnd(running, &excluded, &removed);
+    roaringToIds(&kept, ids);
+
+    roaringToIds(&removed, excludedIds);
+    size_t before = ids.size();
+    for (int id : excludedIds) {
+        if (songHasStalePostings(db, id)) {
+            ids.push_back(id);
+        }
+    }
+    if (ids.size() > before) {
+        sort(ids.begin(), ids.end());
+    }
+}
+
+// ===== EVALUAR =====
+// Los grupos densos (ver roaring.hpp) se cruzan como mapas de bits mientras
+// el resultado también lo sea; con el primer grupo que no lo es se pasa a
+// lista ordenada
+void evaluateQuery(SongDatabase* db, const Query* query, vector<int>& ids) {
+    ids.clear();
+    if (!db || !db->invertedIndex || query->clauseCount == 0) {
+        return;
+    }
+
+    // Grupos con solo palabras exactas: basta con sus postings, no se
+    // descomprimen salvo que sea el grupo más corto. Los demás se materializan
+    vector<bool> exactOnly(query->clauseCount, true);
+    vector<long long> estimate(query->clauseCount, 0);
+    vector<vector<int>> clauseIds(query->clauseCount);
+    vector<RoaringBitmap> clauseBitmaps(query->clauseCount);
+    vector<bool> dense(query->clauseCount, false);
+    for (int i = 0; i < query->termCount; i++) {
+        if (query->terms[i].clause >= 0 && !query->terms[i].exact) {
+            exactOnly[query->terms[i].clause] = false;
+        }
+    }
+
+    for (int c = 0; c < query->clauseCount; c++) {
+        if (exactOnly[c]) {
+            for (int i = 0; i < query->termCount; i++) {
+                if (query->terms[i].clause == c) {
+                    WordEntry* entry = findWord(db->invertedIndex, query->terms[i].word);
+                    estimate[c] += entry ? wordPostingCount(entry) : 0;
+                }
+            }
+        } else {
+            dense[c] = collectClauseIds(db, query, c, clauseIds[c], &clauseBitmaps[c]);
+            estimate[c] = dense[c] ? roaringCardinality(&clauseBitmaps[c]) : clauseIds[c].size();
+        }
+        // AND con un grupo vacío: no hay nada
+        if (estimate[c] == 0) {
+            return;
+        }
+    }
+
+    // Del grupo más corto al más largo
+    vector<int> order(query->clauseCount);
+    for (int c = 0; c < query->clauseCount; c++) {
+        order[c] = c;
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) { return estimate[a] < estimate[b]; });
+
+    int first = order[0];
+    if (exactOnly[first]) {
+        dense[first] = collectClauseIds(db, query, first, clauseIds[first], &clauseBitmaps[first]);
+    }
+    bool runningDense = dense[first];
+    RoaringBitmap running;
+    if (runningDense) {
+        running.containers.swap(clauseBitmaps[first].containers);
+    } else {
+        ids.swap(clauseIds[first]);
+    }
+
+    vector<int> buffer;
+    for (int k = 1; k < query->clauseCount; k++) {
+        if (runningDense ? running.containers.empty() : ids.empty()) {
+            break;
+        }
+        int c = order[k];
+        if (runningDense && dense[c]) {
+            RoaringBitmap both;
+            roaringAnd(&running, &clauseBitmaps[c], &both);
+            running.containers.swap(both.containers);
+            continue;
+        }
+        if (runningDense) {
+            roaringToIds(&running, ids);
+            runningDense = false;
+        }
+
+        if (dense[c]) {
+            size_t kept = 0;
+            for (size_t i = 0; i < ids.size(); i++) {
+                if (roaringContains(&clauseBitmaps[c], ids[i])) {
+                    ids[kept++] = ids[i];
+                }
+            }
+            ids.resize(kept);
+        } else if (exactOnly[c]) {
+            vector<TermCursor> cursors;
+            openClauseCursors(db, query, c, cursors);
+            size_t kept = 0;
+            for (size_t i = 0; i < ids.size(); i++) {
+                if (cursorsContain(cursors, ids[i])) {
+                    ids[kept++] = ids[i];
+                }
+            }
+            ids.resize(kept);
+        } else {
+            buffer.resize(min(ids.size(), clauseIds[c].size()));
+            int count = intersectSortedIds(ids.data(), (int)ids.size(), clauseIds[c].data(),
+                                           (int)clauseIds[c].size(), buffer.data());
+            buffer.resize(count);
+            ids.swap(buffer);
+        }
+    }
+
+    // NOT: fuera las que tengan alguna palabra excluida. Las que tienen
+    // postings viejos se quedan y las decide el llamador con su texto actual
+    vector<TermCursor> excluded;
+    if (runningDense) {
+        excludeDenseIds(db, query, &running, ids);
+    } else {
+        openClauseCursors(db, query, -1, excluded);
+    }
+    if (!excluded.empty()) {
+        size_t kept = 0;
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (!cursorsContain(excluded, ids[i]) || songHasStalePostings(db, ids[i])) {
+                ids[kept++] = ids[i];
+            }
+        }
+        ids.resize(kept);
+    }
+
+    // Frases: solo las que han pasado el AND
+    if (query->phraseCount > 0) {
+        PhraseCursors phrases;
+        openPhraseCursors(db, query, &phrases);
+        size_t kept = 0;
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (phrasesMatch(db, query, &phrases, ids[i])) {
+                ids[kept++] = ids[i];
+            }
+        }
+        ids.resize(kept);
+    }
+}
+
+// ===== FRASES =====
+// positions[k]: posiciones (crecientes) de la palabra k de la frase en un
+// campo. Para cada inicio se toma la primera posición posible de cada palabra
+// siguiente: es el final más cercano, así que si esa no cabe en slop no cabe ninguna
+static bool positionsMatchPhrase(const uint8_t* const* positions, const int* counts,
+                                 int termCount, int slop) {
+    for (int s = 0; s < counts[0]; s++) {
+        int first = positions[0][s];
+        int previous = first;
+        bool complete = true;
+        for (int k = 1; k < termCount && complete; k++) {
+            int j = 0;
+            while (j < counts[k] && positions[k][j] <= previous) {
+                j++;
+            }
+            complete = j < counts[k];
+            if (complete) {
+                previous = positions[k][j];
+            }
+        }
+        if (!complete) {
+            return false;   // con un inicio más tarde tampoco habrá
+        }
+        if (previous - first - (termCount - 1) <= slop) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void openPhraseCursors(SongDatabase* db, const Query* query, PhraseCursors* cursors) {
+    cursors->cursors.clear();
+    cursors->indexed.clear();
+    for (int p = 0; p < query->phraseCount; p++) {
+        const QueryPhrase* phrase = &query->phrases[p];
+        for (int k = 0; k < phrase->termCount; k++) {
+            WordEntry* entry = findWord(db->invertedIndex, query->terms[phrase->firstTerm + k].word);
+            cursors->cursors.emplace_back();
+            cursors->indexed.push_back(entry != nullptr);
+            if (entry) {
+                wordPostingsBegin(&cursors->cursors.back(), entry);
+            }
+        }
+    }
+}
+
+bool phrasesMatch(SongDatabase* db, const Query* query, PhraseCursors* cursors, int id) {
+    if (songHasStalePostings(db, id)) {
+        return true;
+    }
+
+    int cursor = 0;
+    for (int p = 0; p < query->phraseCount; p++) {
+        const QueryPhrase* phrase = &query->phrases[p];
+        PostingPositions positions[QUERY_MAX_TERMS];
+        bool present = true;
+        bool missing = false;   // alguna lista sin posiciones
+        for (int k = 0; k < phrase->termCount; k++, cursor++) {
+            PostingIterator* it = &cursors->cursors[cursor];
+            // Todas avanzan hasta id aunque ya se sepa que falta alguna
+            if (!cursors->indexed[cursor] || !postingAdvanceTo(it, id) || it->id != id) {
+                present = false;
+            } else if (present && !postingPositions(it, &positions[k])) {
+                missing = true;
+            }
+        }
+
+        bool matched = false;
+        if (present && missing) {
+            return songMatchesText(db, id, query);
+        }
+        if (present) {
+            const uint8_t* title[QUERY_MAX_TERMS];
+            const uint8_t* artist[QUERY_MAX_TERMS];
+            int titleCounts[QUERY_MAX_TERMS];
+            int artistCounts[QUERY_MAX_TERMS];
+            for (int k = 0; k < phrase->termCount; k++) {
+                title[k] = positions[k].title;
+                titleCounts[k] = positions[k].titleCount;
+                artist[k] = positions[k].artist;
+                artistCounts[k] = positions[k].artistCount;
+            }
+            int field = query->terms[phrase->firstTerm].field;
+            matched = (field != POSTING_FIELD_ARTIST &&
+                       positionsMatchPhrase(title, titleCounts, phrase->termCount, phrase->slop)) ||
+                      (field != POSTING_FIELD_TITLE &&
+                       positionsMatchPhrase(artist, artistCounts, phrase->termCount, phrase->slop));
+        }
+        if (matched == phrase->excluded) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===== COMPROBAR CONTRA EL TEXTO DE UNA CANCIÓN =====
+static bool termMatchesWords(const QueryTerm* term, char words[][64], int titleWordCount,
+                             int wordCount) {
+    size_t length = strlen(term->word);
+    int tolerance = term->exact ? 0 : fuzzyTolerance(term->word);
+    int first = term->field == POSTING_FIELD_ARTIST ? titleWordCount : 0;
+    int end = term->field == POSTING_FIELD_TITLE ? titleWordCount : wordCount;
+    for (int j = first; j < end; j++) {
+        if (term->exact) {
+            if (strcmp(words[j], term->word) == 0) return true;
+        } else if (strncmp(words[j], term->word, length) == 0 ||
+                   (tolerance > 0 && levenshteinDistance(term->word, words[j]) <= tolerance)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Lo mismo con las posiciones sacadas de las palabras de un campo
+static bool wordsMatchPhrase(const Query* query, const QueryPhrase* phrase, char words[][64],
+                             int wordCount) {
+    uint8_t positions[QUERY_MAX_TERMS][POSTING_MAX_POSITIONS];
+    const uint8_t* lists[QUERY_MAX_TERMS];
+    int counts[QUERY_MAX_TERMS];
+    for (int k = 0; k < phrase->termCount; k++) {
+        counts[k] = 0;
+        lists[k] = positions[k];
+        const char* word = query->terms[phrase->firstTerm + k].word;
+        for (int j = 0; j < wordCount && j < POSTING_MAX_POSITIONS; j++) {
+            if (strcmp(words[j], word) == 0) {
+                positions[k][counts[k]++] = (uint8_t)j;
+            }
+        }
+    }
+    return positionsMatchPhrase(lists, counts, phrase->termCount, phrase->slop);
+}
+
+bool queryMatchesWords(const Query* query, char words[][64], int titleWordCount, int wordCount) {
+    for (int c = 0; c < query->clauseCount; c++) {
+        bool matched = false;
+        for (int i = 0; i < query->termCount && !matched; i++) {
+            if (query->terms[i].clause == c) {
+                matched = termMatchesWords(&query->terms[i], words, titleWordCount, wordCount);
+            }
+        }
+        if (!matched) {
+            return false;
+        }
+    }
+    for (int i = 0; i < query->termCount; i++) {
+        if (isExcludedTerm(&query->terms[i]) &&
+            termMatchesWords(&query->terms[i], words, titleWordCount, wordCount)) {
+            return false;
+        }
+    }
+    for (int p = 0; p < query->phraseCount; p++) {
+        const QueryPhrase* phrase = &query->phrases[p];
+        int field = query->terms[phrase->firstTerm].field;
+        bool matched = (field != POSTING_FIELD_ARTIST &&
+                        wordsMatchPhrase(query, phrase, words, titleWordCount)) ||
+                       (field != POSTING_FIELD_TITLE &&
+                        wordsMatchPhrase(query, phrase, words + titleWordCount,
+                                         wordCount - titleWordCount));
+        if (matched == phrase->excluded) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "database.hpp"
+#include "postings.hpp"
+#include <string>
+#include <vector>
+
+// ===== CONSULTAS BOOLEANAS =====
+// Sintaxis de SEARCH:
+//   queen live          -> las dos palabras (AND implícito)
+//   queen OR abba       -> cualquiera de las dos (OR une la palabra de antes y la de después)
+//   queen NOT live      -> queen y no live (también vale -live)
+//   "bohemian rhapsody" -> frase: las palabras exactas, seguidas y en orden
+//   "queen live"~2      -> en orden con hasta 2 palabras en medio
+//   "queen"             -> palabra exacta, sin prefijo ni fuzzy
+//   artist:queen        -> queen en el artista (title: en el título; también
+//                          con comillas, frases y NOT: -artist:"a b")
+// Una palabra suelta vale por prefijo (trie) o por parecido (BK-tree); las de
+// un NOT y las entre comillas solo valen exactas (índice invertido).
+// OR se aplica antes que el AND: "a b OR c" es a AND (b OR c). Junto a una
+// frase OR cuenta como AND. Una frase tiene que estar entera en el título o
+// entera en el artista; -"a b" descarta las canciones que tienen la frase.
+// Las palabras de una frase se buscan como un AND y la frase solo se
+// comprueba con las posiciones (postings.hpp) de las que cumplen el AND.
+// Con campo se recorren los postings de la palabra quedándose con los que la
+// tienen en ese campo (cada posting lleva sus apariciones por campo).
+
+#define QUERY_MAX_TERMS 50
+#define QUERY_MAX_PHRASES (QUERY_MAX_TERMS / 2)
+
+struct QueryTerm {
+    char word[64];
+    bool exact;     // solo la palabra tal cual
+    int clause;     // grupo OR al que pertenece (-1 = excluida con NOT)
+    int phrase;     // frase de la que forma parte (-1 = ninguna)
+    int field;      // POSTING_FIELD_* (ANY = título o artista)
+};
+
+// Palabras terms[firstTerm .. firstTerm + termCount - 1] en orden
+struct QueryPhrase {
+    int firstTerm;
+    int termCount;
+    int slop;       // palabras de más permitidas entre la primera y la última
+    bool excluded;  // -"...": fuera las que la tienen (sus términos no son NOT sueltos)
+};
+
+// AND de clauseCount grupos; cada grupo es el OR de sus términos
+struct Query {
+    QueryTerm terms[QUERY_MAX_TERMS];
+    int termCount;
+    int clauseCount;
+    QueryPhrase phrases[QUERY_MAX_PHRASES];
+    int phraseCount;
+};
+
+// ¿Descarta el término por sí solo las canciones que lo tienen?
+inline bool isExcludedTerm(const QueryTerm* term) {
+    return term->clause < 0 && term->phrase < 0;
+}
+
+// false si no queda ninguna palabra que buscar (vacía o solo NOT)
+bool parseQuery(const char* text, Query* query);
+
+// Ids (ordenados) que cumplen la consulta según los índices. Puede incluir
+// canciones borradas o con postings viejos: el llamador las comprueba
+void evaluateQuery(SongDatabase* db, const Query* query, std::vector<int>& ids);
+
+// Palabras del índice que valen por term (la exacta, por prefijo o por
+// parecido, alguna puede repetirse); false si son más de maxWords
+bool expandQueryTerm(SongDatabase* db, const QueryTerm* term, std::vector<std::string>& words,
+                     int maxWords);
+
+// ===== FRASES CONTRA LAS POSICIONES =====
+// Un iterador por palabra de frase (en el orden de terms), para comprobar
+// ids crecientes sin volver atrás
+struct PhraseCursors {
+    std::vector<PostingIterator> cursors;
+    std::vector<bool> indexed;      // la palabra está en el índice
+};
+void openPhraseCursors(SongDatabase* db, const Query* query, PhraseCursors* cursors);
+// ¿Cumple id (ya comprobado el AND) las frases de la consulta? Sin
+// posiciones se mira el texto; con postings viejos lo decide el llamador
+bool phrasesMatch(SongDatabase* db, const Query* query, PhraseCursors* cursors, int id);
+
+// ¿Cumplen la consulta estas palabras (las de una canción, de extractWords:
+// las titleWordCount primeras del título y el resto del artista)?
+bool queryMatchesWords(const Query* query, char words[][64], int titleWordCount, int wordCount);
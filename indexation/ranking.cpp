@@ -0,0 +1,350 @@
+#include "ranking.hpp"
+#include "epoch.hpp"
+#include "inverted_index.hpp"
+#include "postings.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// Margen para comparar cotas con puntuaciones (redondeo de double; el paso
+// a float se come el resto)
+#define RANK_BOUND_SLACK 1e-12
+
+double bm25Idf(int documentFrequency, int songCount) {
+    if (documentFrequency > songCount) {
+        documentFrequency = songCount;   // postings viejos aún sin compactar
+    }
+    return log(1.0 + (songCount - documentFrequency + 0.5) / (documentFrequency + 0.5));
+}
+
+// ===== UNA LISTA DE POSTINGS QUE PUNTÚA PARA UN GRUPO =====
+struct RankedList {
+    int clause;
+    WordEntry* entry;
+    int field;          // POSTING_FIELD_*: solo puntúa (y cuenta) ese campo
+    double weight;      // IDF x peso de la palabra (1 o BM25_EXPANDED_WEIGHT)
+    double bound;       // la mayor puntuación que puede dar
+    PostingIterator it;
+};
+
+// Las medias y el total se leen una vez por consulta
+struct FieldStats {
+    int songCount;
+    double averageTitle;
+    double averageArtist;
+};
+
+static void loadFieldStats(SongDatabase* db, FieldStats& stats) {
+    stats.songCount = max(EPOCH_LOAD(db->rankedSongCount), 1);
+    stats.averageTitle = max((double)EPOCH_LOAD(db->titleWordTotal) / stats.songCount, 1.0);
+    stats.averageArtist = max((double)EPOCH_LOAD(db->artistWordTotal) / stats.songCount, 1.0);
+}
+
+// Las longitudes son las del posting (las de cuando se indexó la palabra).
+// Un campo tiene al menos tantas palabras como apariciones: así la mejor
+// frecuencia de un bloque (bestPostingFreq) da una cota válida. Con field
+// solo cuenta ese campo
+static double termWeight(const FieldStats& stats, uint16_t freq, int field) {
+    int titleFreq = postingTitleFreq(freq);
+    int artistFreq = postingArtistFreq(freq);
+    int titleLength = max(postingTitleLength(freq), titleFreq);
+    int artistLength = max(postingArtistLength(freq), artistFreq);
+    double titleNorm = 1.0 - BM25_B + BM25_B * titleLength / stats.averageTitle;
+    double artistNorm = 1.0 - BM25_B + BM25_B * artistLength / stats.averageArtist;
+    double tf = (field != POSTING_FIELD_ARTIST ? BM25_TITLE_WEIGHT * titleFreq / titleNorm : 0.0) +
+                (field != POSTING_FIELD_TITLE ? BM25_ARTIST_WEIGHT * artistFreq / artistNorm : 0.0);
+    return tf * (BM25_K1 + 1.0) / (tf + BM25_K1);
+}
+
+// Mayor puntuación primero; a igualdad, el id más bajo (la más antigua)
+static bool betterScore(const ScoredSong& a, const ScoredSong& b) {
+    return a.score > b.score || (a.score == b.score && a.id < b.id);
+}
+
+// ¿Puede una puntuación de como mucho bound entrar en un top lleno? Las que
+// empatan con la peor no entran: llegan después y tienen un id mayor
+static bool boundBeats(double bound, const vector<ScoredSong>& top) {
+    return (float)(bound * (1.0 + RANK_BOUND_SLACK)) > top.front().score;
+}
+
+static void pushTopSong(vector<ScoredSong>& top, size_t capacity, const ScoredSong& song) {
+    if (top.size() < capacity) {
+        top.push_back(song);
+        push_heap(top.begin(), top.end(), betterScore);
+    } else if (betterScore(song, top.front())) {
+        pop_heap(top.begin(), top.end(), betterScore);
+        top.back() = song;
+        push_heap(top.begin(), top.end(), betterScore);
+    }
+}
+
+// ===== ABRIR LAS LISTAS DE CADA GRUPO =====
+// Cada palabra del índice que vale por un término es una lista; si sale por
+// varios términos del grupo se queda con el mayor peso. Un término que se
+// expande demasiado deja solo su palabra exacta y una fracción fija de su IDF
+// en broadCredit (false: la consulta no se puede podar)
+static void addRankedList(vector<RankedList>& lists, const FieldStats& stats, int clause,
+                          WordEntry* entry, int field, double weight) {
+    for (RankedList& list : lists) {
+        if (list.clause == clause && list.entry == entry && list.field == field) {
+            list.weight = max(list.weight, weight);
+            list.bound = list.weight * termWeight(stats, list.it.bestFreq, field);
+            return;
+        }
+    }
+    lists.emplace_back();
+    RankedList& list = lists.back();
+    list.clause = clause;
+    list.entry = entry;
+    list.field = field;
+    list.weight = weight;
+    wordPostingsBegin(&list.it, entry);
+    list.bound = weight * termWeight(stats, list.it.bestFreq, field);
+}
+
+static bool openRankedLists(SongDatabase* db, const Query* query, const FieldStats& stats,
+                            vector<RankedList>& lists, vector<double>& broadCredit) {
+    bool expanded = true;
+    broadCredit.assign(query->clauseCount, 0.0);
+
+    vector<string> words;
+    for (int i = 0; i < query->termCount; i++) {
+        const QueryTerm& term = query->terms[i];
+        if (term.clause < 0) {
+            continue;
+        }
+
+        WordEntry* written = findWord(db->invertedIndex, term.word);
+        double writtenIdf = bm25Idf(written ? wordPostingCount(written) : 0, stats.songCount);
+
+        words.clear();
+        if (!expandQueryTerm(db, &term, words, RANK_MAX_EXPANSION)) {
+            expanded = false;
+            broadCredit[term.clause] = max(broadCredit[term.clause],
+                                           BM25_EXPANDED_WEIGHT * writtenIdf);
+            if (written) {
+                addRankedList(lists, stats, term.clause, written, term.field, writtenIdf);
+            }
+            continue;
+        }
+
+        for (const string& word : words) {
+            WordEntry* entry = findWord(db->invertedIndex, word.c_str());
+            if (!entry) {
+                continue;
+            }
+            if (entry == written) {
+                addRankedList(lists, stats, term.clause, entry, term.field, writtenIdf);
+                continue;
+            }
+            // Una palabra rara parecida no puede valer más que la escrita
+            double idf = bm25Idf(wordPostingCount(entry), stats.songCount);
+            if (written) {
+                idf = min(idf, writtenIdf);
+            }
+            addRankedList(lists, stats, term.clause, entry, term.field, BM25_EXPANDED_WEIGHT * idf);
+        }
+    }
+    return expanded;
+}
+
+// ===== PUNTUACIÓN DE UNA CANCIÓN (las listas ya están en id o después) =====
+static double scoreSong(const FieldStats& stats, vector<RankedList>& lists,
+                        const vector<double>& broadCredit, vector<double>& clauseScore, int id) {
+    fill(clauseScore.begin(), clauseScore.end(), 0.0);
+    for (RankedList& list : lists) {
+        if (list.it.id == id) {
+            double score = list.weight * termWeight(stats, list.it.freq, list.field);
+            clauseScore[list.clause] = max(clauseScore[list.clause], score);
+        }
+    }
+
+    double total = 0.0;
+    for (size_t c = 0; c < clauseScore.size(); c++) {
+        total += clauseScore[c] > 0.0 ? clauseScore[c] : broadCredit[c];
+    }
+    return total;
+}
+
+// ===== RANKING DE CANDIDATAS YA EVALUADAS =====
+void rankSongs(SongDatabase* db, const Query* query, const vector<int>& ids, int limit,
+               vector<ScoredSong>& top) {
+    top.clear();
+    if (ids.empty()) {
+        return;
+    }
+
+    FieldStats stats;
+    loadFieldStats(db, stats);
+    vector<RankedList> lists;
+    vector<double> broadCredit;
+    openRankedLists(db, query, stats, lists, broadCredit);
+
+    // Montículo de mínimos con las limit mejores: la peor está en top[0]
+    size_t capacity = limit > 0 ? (size_t)limit : ids.size();
+    top.reserve(min(capacity, ids.size()));
+    vector<double> clauseScore(query->clauseCount);
+
+    for (int id : ids) {
+        // Los ids van en orden: cada lista solo avanza
+        for (RankedList& list : lists) {
+            postingAdvanceInField(&list.it, id, list.field);
+        }
+        ScoredSong song = {id, (float)scoreSong(stats, lists, broadCredit, clauseScore, id)};
+        pushTopSong(top, capacity, song);
+    }
+
+    sort_heap(top.begin(), top.end(), betterScore);
+}
+
+// ===== TOP-K CON BLOCK-MAX WAND =====
+// AND entre grupos y OR dentro de cada uno, canción a canción en orden de id.
+// target es el primer id que queda por mirar
+static bool excludedSong(SongDatabase* db, vector<PostingIterator>& excluded,
+                         const vector<int>& excludedFields, int id) {
+    bool found = false;
+    for (size_t i = 0; i < excluded.size(); i++) {
+        if (postingAdvanceInField(&excluded[i], id, excludedFields[i]) && excluded[i].id == id) {
+            found = true;
+        }
+    }
+    // Con postings viejos la decide accept con el texto actual
+    return found && !songHasStalePostings(db, id);
+}
+
+bool searchTopSongs(SongDatabase* db, const Query* query, int limit, SongFilter accept,
+                    vector<ScoredSong>& top) {
+    top.clear();
+    if (limit <= 0 || query->clauseCount == 0) {
+        return false;
+    }
+
+    FieldStats stats;
+    loadFieldStats(db, stats);
+    vector<RankedList> lists;
+    vector<double> broadCredit;
+    if (!openRankedLists(db, query, stats, lists, broadCredit)) {
+        return false;
+    }
+
+    // Listas agrupadas: las de un grupo van de clauseStart[c] a clauseStart[c + 1]
+    stable_sort(lists.begin(), lists.end(),
+                [](const RankedList& a, const RankedList& b) { return a.clause < b.clause; });
+    int clauseCount = query->clauseCount;
+    vector<int> clauseStart(clauseCount + 1, 0);
+    vector<double> clauseBound(clauseCount, 0.0);
+    for (const RankedList& list : lists) {
+        clauseStart[list.clause + 1]++;
+        clauseBound[list.clause] = max(clauseBound[list.clause], list.bound);
+    }
+    for (int c = 0; c < clauseCount; c++) {
+        clauseStart[c + 1] += clauseStart[c];
+        // AND con un grupo sin palabras: no hay nada
+        if (clauseStart[c + 1] == clauseStart[c]) {
+            return true;
+        }
+    }
+    double listBound = 0.0;
+    for (int c = 0; c < clauseCount; c++) {
+        listBound += clauseBound[c];
+    }
+
+    vector<PostingIterator> excluded;
+    vector<int> excludedFields;
+    for (int i = 0; i < query->termCount; i++) {
+        if (isExcludedTerm(&query->terms[i])) {
+            WordEntry* entry = findWord(db->invertedIndex, query->terms[i].word);
+            if (entry) {
+                excluded.emplace_back();
+                wordPostingsBegin(&excluded.back(), entry);
+                excludedFields.push_back(query->terms[i].field);
+            }
+        }
+    }
+    // Las frases solo se miran en las que entrarían en el top
+    PhraseCursors phrases;
+    openPhraseCursors(db, query, &phrases);
+
+    size_t capacity = limit;
+    top.reserve(capacity);
+    vector<double> clauseScore(clauseCount);
+
+    int target = 0;
+    int boundEnd = -1;          // hasta dónde vale blockBound
+    double blockBound = 0.0;
+    while (true) {
+        bool full = top.size() == capacity;
+        if (full && !boundBeats(listBound, top)) {
+            break;
+        }
+
+        // Cota de los bloques donde cae target: vale hasta el primero que acaba
+        if (full && target > boundEnd) {
+            blockBound = 0.0;
+            boundEnd = INT_MAX;
+            bool exhausted = false;
+            for (int c = 0; c < clauseCount && !exhausted; c++) {
+                double best = 0.0;
+                bool live = false;
+                for (int l = clauseStart[c]; l < clauseStart[c + 1]; l++) {
+                    int lastId;
+                    uint16_t bestFreq;
+                    if (postingBlockBound(&lists[l].it, target, &lastId, &bestFreq)) {
+                        live = true;
+                        best = max(best, lists[l].weight * termWeight(stats, bestFreq, lists[l].field));
+                        boundEnd = min(boundEnd, lastId);
+                    }
+                }
+                exhausted = !live;
+                blockBound += best;
+            }
+            if (exhausted) {
+                break;
+            }
+        }
+        if (full && !boundBeats(blockBound, top)) {
+            if (boundEnd == INT_MAX) {
+                break;
+            }
+            target = boundEnd + 1;
+            continue;
+        }
+
+        // Primer id >= target de cada grupo; si no coinciden se sigue desde el mayor
+        int next = target;
+        bool exhausted = false;
+        for (int c = 0; c < clauseCount && !exhausted; c++) {
+            int first = INT_MAX;
+            for (int l = clauseStart[c]; l < clauseStart[c + 1]; l++) {
+                if (postingAdvanceInField(&lists[l].it, target, lists[l].field)) {
+                    first = min(first, lists[l].it.id);
+                }
+            }
+            exhausted = first == INT_MAX;
+            next = max(next, first);
+        }
+        if (exhausted) {
+            break;
+        }
+        if (next != target) {
+            target = next;
+            continue;
+        }
+
+        ScoredSong song = {target, (float)scoreSong(stats, lists, broadCredit, clauseScore, target)};
+        if ((!full || betterScore(song, top.front())) && !excludedSong(db, excluded, excludedFields, target) &&
+            phrasesMatch(db, query, &phrases, target) && accept(db, target, query)) {
+            pushTopSong(top, capacity, song);
+        }
+        if (target == INT_MAX) {
+            break;
+        }
+        target++;
+    }
+
+    sort_heap(top.begin(), top.end(), betterScore);
+    return true;
+}
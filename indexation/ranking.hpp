@@ -0,0 +1,50 @@
+#pragma once
+
+#include "database.hpp"
+#include "query.hpp"
+#include <vector>
+
+// ===== RANKING BM25 =====
+// BM25 por campos (título y artista con su peso y su longitud media): la
+// frecuencia de cada campo se normaliza por la longitud del campo y las dos
+// se suman antes de saturar con k1. Cada grupo OR de la consulta aporta la
+// mejor de sus palabras; las que valen por prefijo o fuzzy puntúan con su
+// propia frecuencia pero a BM25_EXPANDED_WEIGHT y sin pasar del IDF de la
+// palabra escrita. Si un grupo se expande a más de RANK_MAX_EXPANSION
+// palabras, solo puntúa la exacta y las demás aportan una fracción fija.
+// Un término con campo (artist:, title:) solo puntúa con la parte de su
+// campo, con el peso de ese campo (BM25_TITLE_WEIGHT / BM25_ARTIST_WEIGHT).
+//
+// Top-k con block-max WAND (searchTopSongs): la cota de cada bloque y de cada
+// lista es la puntuación de su mejor frecuencia (más apariciones y campos más
+// cortos, ver postings.hpp). Mientras el montículo está lleno, los tramos de ids donde la
+// suma de las cotas de bloque no supera a la peor del top se saltan sin
+// descomprimir, y la búsqueda acaba cuando ni las cotas de lista llegan.
+
+#define BM25_K1 1.2
+#define BM25_B 0.75
+#define BM25_TITLE_WEIGHT 1.0
+#define BM25_ARTIST_WEIGHT 1.0
+#define BM25_EXPANDED_WEIGHT 0.5
+#define RANK_MAX_EXPANSION 64
+
+struct ScoredSong {
+    int id;
+    float score;
+};
+
+double bm25Idf(int documentFrequency, int songCount);
+
+// ¿Sigue valiendo la canción? (borrada, postings viejos...)
+typedef bool (*SongFilter)(SongDatabase* db, uint32_t id, const Query* query);
+
+// De ids (ordenados, ya comprobados) se queda con las limit mejores, de mayor
+// a menor puntuación (limit <= 0: todas)
+void rankSongs(SongDatabase* db, const Query* query, const std::vector<int>& ids, int limit,
+               std::vector<ScoredSong>& top);
+
+// Las limit mejores directamente de los postings, sin evaluar la consulta
+// entera; accept solo se llama con las que entrarían en el top. false si no
+// se puede (limit <= 0 o un grupo demasiado amplio): usar evaluateQuery + rankSongs
+bool searchTopSongs(SongDatabase* db, const Query* query, int limit, SongFilter accept,
+                    std::vector<ScoredSong>& top);
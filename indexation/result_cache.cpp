@@ -0,0 +1,235 @@
+#include "result_cache.hpp"
+#include <cstdio>
+#include <cstring>
+
+// ===== HASH DE LA CLAVE (FNV-1a, como las URLs) =====
+static uint64_t hashKey(const char* key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char* ptr = (const unsigned char*)key; *ptr; ptr++) {
+        hash = (hash ^ *ptr) * 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+// ===== LOCK SIN ESPERA =====
+static bool tryLockCache(ResultCache* cache) {
+    if (__atomic_exchange_n(&cache->locked, 1, __ATOMIC_ACQUIRE) == 0) {
+        return true;
+    }
+    __atomic_fetch_add(&cache->stats.busy, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+// Las métricas sí esperan: el lock solo se tiene lo que dura una copia
+static void lockCache(ResultCache* cache) {
+    while (__atomic_exchange_n(&cache->locked, 1, __ATOMIC_ACQUIRE) != 0) {
+    }
+}
+
+static void unlockCache(ResultCache* cache) {
+    __atomic_store_n(&cache->locked, 0, __ATOMIC_RELEASE);
+}
+
+// ===== CREAR / LIBERAR =====
+ResultCache* createResultCache() {
+    ResultCache* cache = new ResultCache();
+    cache->entries = new ResultCacheEntry[RESULT_CACHE_ENTRIES];
+    cache->count = 0;
+
+    int bucketCount = 1;
+    while (bucketCount < RESULT_CACHE_ENTRIES * 2) {
+        bucketCount <<= 1;
+    }
+    cache->buckets = new int[bucketCount];
+    memset(cache->buckets, -1, sizeof(int) * bucketCount);
+    cache->bucketMask = bucketCount - 1;
+
+    cache->newest = -1;
+    cache->oldest = -1;
+    cache->locked = 0;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    return cache;
+}
+
+void freeResultCache(ResultCache* cache) {
+    if (!cache) {
+        return;
+    }
+    for (int i = 0; i < cache->count; i++) {
+        delete[] cache->entries[i].songIds;
+    }
+    delete[] cache->entries;
+    delete[] cache->buckets;
+    delete cache;
+}
+
+// ===== CLAVE NORMALIZADA =====
+// Por término: campo, exacta, grupo, frase y la palabra (ya en minúsculas y
+// sin acentos); después cada frase con su slop y el límite
+bool resultCacheKey(const Query* query, int limit, char* key) {
+    int length = 0;
+    for (int i = 0; i < query->termCount; i++) {
+        const QueryTerm& term = query->terms[i];
+        length += snprintf(key + length, RESULT_CACHE_KEY_BYTES - length, "%d%c%d,%d:%s ",
+                           term.field, term.exact ? 'e' : 'p', term.clause, term.phrase, term.word);
+        if (length >= RESULT_CACHE_KEY_BYTES) {
+            return false;
+        }
+    }
+    for (int i = 0; i < query->phraseCount; i++) {
+        const QueryPhrase& phrase = query->phrases[i];
+        length += snprintf(key + length, RESULT_CACHE_KEY_BYTES - length, "~%d%c",
+                           phrase.slop, phrase.excluded ? '-' : '+');
+        if (length >= RESULT_CACHE_KEY_BYTES) {
+            return false;
+        }
+    }
+    length += snprintf(key + length, RESULT_CACHE_KEY_BYTES - length, "#%d", limit);
+    return length < RESULT_CACHE_KEY_BYTES;
+}
+
+// ===== LISTA LRU =====
+static void unlinkEntry(ResultCache* cache, int index) {
+    ResultCacheEntry& entry = cache->entries[index];
+    if (entry.newer >= 0) {
+        cache->entries[entry.newer].older = entry.older;
+    } else {
+        cache->newest = entry.older;
+    }
+    if (entry.older >= 0) {
+        cache->entries[entry.older].newer = entry.newer;
+    } else {
+        cache->oldest = entry.newer;
+    }
+}
+
+static void pushNewest(ResultCache* cache, int index) {
+    ResultCacheEntry& entry = cache->entries[index];
+    entry.newer = -1;
+    entry.older = cache->newest;
+    if (cache->newest >= 0) {
+        cache->entries[cache->newest].newer = index;
+    } else {
+        cache->oldest = index;
+    }
+    cache->newest = index;
+}
+
+// ===== TABLA HASH (encadenada por índice de entrada) =====
+static int findEntry(ResultCache* cache, const char* key, uint64_t hash) {
+    int index = cache->buckets[hash & cache->bucketMask];
+    while (index >= 0) {
+        ResultCacheEntry& entry = cache->entries[index];
+        if (entry.hash == hash && strcmp(entry.key, key) == 0) {
+            return index;
+        }
+        index = entry.hashNext;
+    }
+    return -1;
+}
+
+static void unhashEntry(ResultCache* cache, int index) {
+    int* link = &cache->buckets[cache->entries[index].hash & cache->bucketMask];
+    while (*link != index) {
+        link = &cache->entries[*link].hashNext;
+    }
+    *link = cache->entries[index].hashNext;
+}
+
+static void hashEntry(ResultCache* cache, int index) {
+    int* bucket = &cache->buckets[cache->entries[index].hash & cache->bucketMask];
+    cache->entries[index].hashNext = *bucket;
+    *bucket = index;
+}
+
+// ===== BUSCAR =====
+bool lookupResultCache(ResultCache* cache, const char* key, uint64_t generation,
+                       SearchResult* result) {
+    if (!tryLockCache(cache)) {
+        return false;
+    }
+
+    int index = findEntry(cache, key, hashKey(key));
+    if (index < 0 || cache->entries[index].generation != generation) {
+        cache->stats.misses++;
+        if (index >= 0) {
+            cache->stats.stale++;
+        }
+        unlockCache(cache);
+        return false;
+    }
+
+    ResultCacheEntry& entry = cache->entries[index];
+    if (entry.count > result->capacity) {
+        delete[] result->songIds;
+        result->capacity = entry.count;
+        result->songIds = new int[result->capacity];
+    }
+    if (entry.count > 0) {
+        memcpy(result->songIds, entry.songIds, sizeof(int) * entry.count);
+    }
+    result->count = entry.count;
+    result->totalMatches = entry.totalMatches;
+
+    unlinkEntry(cache, index);
+    pushNewest(cache, index);
+    cache->stats.hits++;
+    unlockCache(cache);
+    return true;
+}
+
+// ===== GUARDAR =====
+void storeResultCache(ResultCache* cache, const char* key, uint64_t generation,
+                      const SearchResult* result) {
+    if (result->count > RESULT_CACHE_MAX_IDS || !tryLockCache(cache)) {
+        return;
+    }
+
+    // La misma clave (de otra generación) se reutiliza; si no, una libre o la
+    // menos usada
+    uint64_t hash = hashKey(key);
+    int index = findEntry(cache, key, hash);
+    if (index >= 0) {
+        unlinkEntry(cache, index);
+    } else {
+        if (cache->count < RESULT_CACHE_ENTRIES) {
+            index = cache->count++;
+            cache->entries[index].songIds = nullptr;
+            cache->entries[index].capacity = 0;
+        } else {
+            index = cache->oldest;
+            unlinkEntry(cache, index);
+            unhashEntry(cache, index);
+        }
+        ResultCacheEntry& entry = cache->entries[index];
+        strcpy(entry.key, key);
+        entry.hash = hash;
+        hashEntry(cache, index);
+    }
+
+    ResultCacheEntry& entry = cache->entries[index];
+    if (result->count > entry.capacity) {
+        delete[] entry.songIds;
+        entry.capacity = result->count;
+        entry.songIds = new int[entry.capacity];
+    }
+    if (result->count > 0) {
+        memcpy(entry.songIds, result->songIds, sizeof(int) * result->count);
+    }
+    entry.count = result->count;
+    entry.totalMatches = result->totalMatches;
+    entry.generation = generation;
+    pushNewest(cache, index);
+    unlockCache(cache);
+}
+
+// ===== MÉTRICAS =====
+void resultCacheStats(ResultCache* cache, ResultCacheStats* stats) {
+    lockCache(cache);
+    stats->hits = cache->stats.hits;
+    stats->misses = cache->stats.misses;
+    stats->stale = cache->stats.stale;
+    stats->busy = __atomic_load_n(&cache->stats.busy, __ATOMIC_RELAXED);
+    stats->entries = cache->count;
+    unlockCache(cache);
+}
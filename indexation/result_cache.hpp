@@ -0,0 +1,69 @@
+#pragma once
+
+#include "database.hpp"
+#include "query.hpp"
+#include <cstdint>
+
+// ===== CACHÉ DE RESULTADOS DE BÚSQUEDA (LRU) =====
+// La clave es la consulta ya analizada (palabras con sus grupos, frases y
+// campos, más el límite): "Queen  LIVE" y "queen live" comparten entrada.
+// Cada entrada guarda la generación de la base con la que se calculó; si
+// desde entonces se añadió, borró o corrigió algo (db->generation cambió) ya
+// no vale. Un acierto es buscar en la tabla y copiar los ids.
+//
+// La usan los lectores: un lock por intento (try-lock), sin esperas. Si otro
+// hilo la tiene ocupada la consulta se calcula sin caché.
+
+#define RESULT_CACHE_ENTRIES 512
+#define RESULT_CACHE_MAX_IDS 1024        // resultados más grandes no se guardan
+#define RESULT_CACHE_KEY_BYTES 1024      // consultas con clave más larga tampoco
+
+struct ResultCacheEntry {
+    char key[RESULT_CACHE_KEY_BYTES];
+    uint64_t hash;
+    uint64_t generation;
+    int* songIds;
+    int count;
+    int capacity;
+    int totalMatches;
+    int hashNext;       // siguiente en el mismo cubo (-1 = fin)
+    int older;          // lista LRU: hacia la menos usada (-1 = fin)
+    int newer;
+};
+
+struct ResultCacheStats {
+    uint64_t hits;
+    uint64_t misses;    // incluye las que estaban pero de otra generación
+    uint64_t stale;
+    uint64_t busy;      // consultas que no esperaron por el lock
+    int entries;
+};
+
+struct ResultCache {
+    ResultCacheEntry* entries;
+    int count;
+    int* buckets;       // potencia de 2, -1 = vacío
+    int bucketMask;
+    int newest;         // cabeza de la LRU
+    int oldest;         // la que se reemplaza cuando está llena
+    int locked;
+
+    ResultCacheStats stats;
+};
+
+// ===== FUNCIONES =====
+
+ResultCache* createResultCache();
+void freeResultCache(ResultCache* cache);
+
+// Clave normalizada de la consulta; false si no cabe en RESULT_CACHE_KEY_BYTES
+bool resultCacheKey(const Query* query, int limit, char* key);
+
+// true si estaba con esta generación: deja los ids y el total en result
+bool lookupResultCache(ResultCache* cache, const char* key, uint64_t generation,
+                       SearchResult* result);
+// Guarda (o reemplaza) el resultado calculado con esa generación
+void storeResultCache(ResultCache* cache, const char* key, uint64_t generation,
+                      const SearchResult* result);
+
+void resultCacheStats(ResultCache* cache, ResultCacheStats* stats);
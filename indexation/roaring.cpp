@@ -0,0 +1,219 @@
+#include "roaring.hpp"
+#include <algorithm>
+
+using namespace std;
+
+// ===== MAPA DE BITS -> LISTA SI CABE =====
+static void setContainerWords(RoaringContainer& container, const uint64_t* words) {
+    int cardinality = 0;
+    for (int i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        cardinality += __builtin_popcountll(words[i]);
+    }
+    container.cardinality = cardinality;
+    container.values.clear();
+    container.words.clear();
+
+    if (cardinality > ROARING_ARRAY_MAX) {
+        container.words.assign(words, words + ROARING_BITMAP_WORDS);
+        return;
+    }
+    container.values.reserve(cardinality);
+    for (int i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        for (uint64_t word = words[i]; word; word &= word - 1) {
+            container.values.push_back(i * 64 + __builtin_ctzll(word));
+        }
+    }
+}
+
+static bool isBitmap(const RoaringContainer& container) {
+    return !container.words.empty();
+}
+
+static bool testBit(const RoaringContainer& container, uint16_t low) {
+    return (container.words[low >> 6] >> (low & 63)) & 1;
+}
+
+static bool containerHas(const RoaringContainer& container, uint16_t low) {
+    if (isBitmap(container)) {
+        return testBit(container, low);
+    }
+    return binary_search(container.values.begin(), container.values.end(), low);
+}
+
+// Copia en words (ROARING_BITMAP_WORDS, a cero) los bits del bloque
+static void containerToWords(const RoaringContainer& container, uint64_t* words) {
+    if (isBitmap(container)) {
+        copy(container.words.begin(), container.words.end(), words);
+        return;
+    }
+    for (uint16_t low : container.values) {
+        words[low >> 6] |= 1ull << (low & 63);
+    }
+}
+
+// ===== CONSTRUIR (unión de ids sueltos) =====
+// Un mapa plano hasta el id más alto y después cada bloque de 65536 a su
+// formato: dos pasadas lineales, sin ordenar
+void roaringFromIds(RoaringBitmap* bitmap, const int* ids, size_t count) {
+    bitmap->containers.clear();
+    if (count == 0) {
+        return;
+    }
+
+    int maxId = 0;
+    for (size_t i = 0; i < count; i++) {
+        maxId = max(maxId, ids[i]);
+    }
+    int blockCount = (maxId >> 16) + 1;
+    vector<uint64_t> bits((size_t)blockCount * ROARING_BITMAP_WORDS, 0);
+    for (size_t i = 0; i < count; i++) {
+        bits[ids[i] >> 6] |= 1ull << (ids[i] & 63);
+    }
+
+    for (int block = 0; block < blockCount; block++) {
+        const uint64_t* words = bits.data() + (size_t)block * ROARING_BITMAP_WORDS;
+        uint64_t any = 0;
+        for (int i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            any |= words[i];
+        }
+        if (any) {
+            bitmap->containers.emplace_back();
+            bitmap->containers.back().key = block;
+            setContainerWords(bitmap->containers.back(), words);
+        }
+    }
+}
+
+void roaringToIds(const RoaringBitmap* bitmap, vector<int>& ids) {
+    ids.clear();
+    ids.reserve(roaringCardinality(bitmap));
+    for (const RoaringContainer& container : bitmap->containers) {
+        int base = container.key << 16;
+        if (!isBitmap(container)) {
+            for (uint16_t low : container.values) {
+                ids.push_back(base | low);
+            }
+            continue;
+        }
+        for (int i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            for (uint64_t word = container.words[i]; word; word &= word - 1) {
+                ids.push_back(base | (i * 64 + __builtin_ctzll(word)));
+            }
+        }
+    }
+}
+
+size_t roaringCardinality(const RoaringBitmap* bitmap) {
+    size_t cardinality = 0;
+    for (const RoaringContainer& container : bitmap->containers) {
+        cardinality += container.cardinality;
+    }
+    return cardinality;
+}
+
+bool roaringContains(const RoaringBitmap* bitmap, int id) {
+    uint16_t key = id >> 16;
+    auto it = lower_bound(bitmap->containers.begin(), bitmap->containers.end(), key,
+                          [](const RoaringContainer& c, uint16_t k) { return c.key < k; });
+    return it != bitmap->containers.end() && it->key == key && containerHas(*it, id & 0xffff);
+}
+
+// ===== INTERSECCIÓN POR BLOQUE =====
+static void andContainers(const RoaringContainer& a, const RoaringContainer& b,
+                          RoaringContainer& out) {
+    out.key = a.key;
+    out.values.clear();
+    out.words.clear();
+
+    if (isBitmap(a) && isBitmap(b)) {
+        uint64_t words[ROARING_BITMAP_WORDS];
+        for (int i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            words[i] = a.words[i] & b.words[i];
+        }
+        setContainerWords(out, words);
+        return;
+    }
+
+    // Con una lista el resultado también lo es (no puede tener más)
+    if (isBitmap(a) || isBitmap(b)) {
+        const RoaringContainer& list = isBitmap(a) ? b : a;
+        const RoaringContainer& bits = isBitmap(a) ? a : b;
+        for (uint16_t low : list.values) {
+            if (testBit(bits, low)) {
+                out.values.push_back(low);
+            }
+        }
+    } else {
+        set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                         back_inserter(out.values));
+    }
+    out.cardinality = out.values.size();
+}
+
+static void andNotContainers(const RoaringContainer& a, const RoaringContainer& b,
+                             RoaringContainer& out) {
+    out.key = a.key;
+    out.values.clear();
+    out.words.clear();
+
+    if (isBitmap(a)) {
+        uint64_t removed[ROARING_BITMAP_WORDS] = {};
+        containerToWords(b, removed);
+        uint64_t words[ROARING_BITMAP_WORDS];
+        for (int i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            words[i] = a.words[i] & ~removed[i];
+        }
+        setContainerWords(out, words);
+        return;
+    }
+
+    for (uint16_t low : a.values) {
+        if (!containerHas(b, low)) {
+            out.values.push_back(low);
+        }
+    }
+    out.cardinality = out.values.size();
+}
+
+// ===== OPERACIONES ENTRE CONJUNTOS (mezcla por key) =====
+void roaringAnd(const RoaringBitmap* a, const RoaringBitmap* b, RoaringBitmap* out) {
+    out->containers.clear();
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a->containers.size() && j < b->containers.size()) {
+        const RoaringContainer& x = a->containers[i];
+        const RoaringContainer& y = b->containers[j];
+        if (x.key < y.key) {
+            i++;
+        } else if (x.key > y.key) {
+            j++;
+        } else {
+            out->containers.emplace_back();
+            andContainers(x, y, out->containers.back());
+            if (out->containers.back().cardinality == 0) {
+                out->containers.pop_back();
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+void roaringAndNot(const RoaringBitmap* a, const RoaringBitmap* b, RoaringBitmap* out) {
+    out->containers.clear();
+    size_t j = 0;
+    for (const RoaringContainer& x : a->containers) {
+        while (j < b->containers.size() && b->containers[j].key < x.key) {
+            j++;
+        }
+        if (j == b->containers.size() || b->containers[j].key != x.key) {
+            out->containers.push_back(x);
+            continue;
+        }
+        out->containers.emplace_back();
+        andNotContainers(x, b->containers[j], out->containers.back());
+        if (out->containers.back().cardinality == 0) {
+            out->containers.pop_back();
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ===== CONJUNTOS DE IDS DENSOS (ROARING) =====
+// Para los grupos de una consulta que cubren buena parte de la base (un
+// prefijo corto, una palabra muy común): los ids se reparten en bloques de
+// 65536 por sus 16 bits altos y cada bloque guarda los 16 bajos como lista
+// ordenada si tiene pocos o como mapa de bits si tiene más de
+// ROARING_ARRAY_MAX. Unir (construir desde ids sueltos con repetidos),
+// intersecar y restar son operaciones entre palabras de 64 bits, sin ordenar.
+
+#define ROARING_ARRAY_MAX 4096          // hasta aquí lista; más, mapa de bits
+#define ROARING_BITMAP_WORDS 1024       // 65536 bits
+
+// Un grupo pasa a mapa de bits con al menos un id por cada ROARING_DENSITY
+// ids de la base (y no menos de ROARING_MIN_IDS); por debajo sale más barato
+// ordenar la lista
+#define ROARING_DENSITY 64
+#define ROARING_MIN_IDS 4096
+
+struct RoaringContainer {
+    uint16_t key;                   // 16 bits altos
+    int cardinality;
+    std::vector<uint16_t> values;   // cardinality <= ROARING_ARRAY_MAX
+    std::vector<uint64_t> words;    // si no: ROARING_BITMAP_WORDS palabras
+};
+
+struct RoaringBitmap {
+    std::vector<RoaringContainer> containers;   // ordenados por key
+};
+
+// ===== FUNCIONES =====
+
+// ids sin ordenar y con repetidos (>= 0)
+void roaringFromIds(RoaringBitmap* bitmap, const int* ids, size_t count);
+// ids ordenados (sustituye el contenido de ids)
+void roaringToIds(const RoaringBitmap* bitmap, std::vector<int>& ids);
+
+size_t roaringCardinality(const RoaringBitmap* bitmap);
+bool roaringContains(const RoaringBitmap* bitmap, int id);
+
+// out = a AND b / a AND NOT b (out no puede ser a ni b)
+void roaringAnd(const RoaringBitmap* a, const RoaringBitmap* b, RoaringBitmap* out);
+void roaringAndNot(const RoaringBitmap* a, const RoaringBitmap* b, RoaringBitmap* out);
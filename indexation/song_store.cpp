@@ -0,0 +1,203 @@
+#include "song_store.hpp"
+#include "epoch.hpp"
+#include <cstring>
+
+// ===== ARENA DE TEXTO =====
+// Offset global = bloque * ARENA_BLOCK_SIZE + posición; un registro nunca
+// cruza de bloque, así que sus textos siempre están contiguos.
+static uint64_t arenaAppend(StringArena* arena, const char* data, size_t length) {
+    if (arena->blockCount == 0 || arena->used + length > ARENA_BLOCK_SIZE) {
+        if (arena->blockCount >= arena->blockCapacity) {
+            // Los lectores pueden estar usando el directorio viejo: se retira
+            int newCapacity = arena->blockCapacity * 2;
+            char** newBlocks = new char*[newCapacity];
+            memcpy(newBlocks, arena->blocks, sizeof(char*) * arena->blockCount);
+            retireArray(arena->blocks);
+            EPOCH_PUBLISH(arena->blocks, newBlocks);
+            arena->blockCapacity = newCapacity;
+        }
+        // El hueco final del bloque también se guarda en disco: dejarlo a cero
+        if (arena->blockCount > 0) {
+            memset(arena->blocks[arena->blockCount - 1] + arena->used, 0,
+                   ARENA_BLOCK_SIZE - arena->used);
+        }
+        arena->blocks[arena->blockCount++] = new char[ARENA_BLOCK_SIZE];
+        arena->used = 0;
+    }
+
+    uint64_t offset = (uint64_t)(arena->blockCount - 1) * ARENA_BLOCK_SIZE + arena->used;
+    memcpy(arena->blocks[arena->blockCount - 1] + arena->used, data, length);
+    arena->used += length;
+    arena->totalBytes += length;
+    return offset;
+}
+
+static const char* arenaGet(StringArena* arena, uint64_t offset) {
+    return EPOCH_LOAD(arena->blocks)[offset / ARENA_BLOCK_SIZE] + offset % ARENA_BLOCK_SIZE;
+}
+
+// ===== CREAR / LIBERAR =====
+SongStore* createSongStore() {
+    SongStore* store = new SongStore();
+    memset(&store->base, 0, sizeof(SongStoreBase));
+
+    store->chunkCapacity = 4;
+    store->chunks = new SongChunk*[store->chunkCapacity];
+    store->chunkCount = 0;
+    store->count = 0;
+
+    store->arena.blockCapacity = 4;
+    store->arena.blocks = new char*[store->arena.blockCapacity];
+    store->arena.blockCount = 0;
+    store->arena.used = 0;
+    store->arena.totalBytes = 0;
+
+    return store;
+}
+
+void freeSongStore(SongStore* store) {
+    if (!store) return;
+
+    for (int i = 0; i < store->chunkCount; i++) {
+        delete store->chunks[i];
+    }
+    delete[] store->chunks;
+
+    for (int i = 0; i < store->arena.blockCount; i++) {
+        delete[] store->arena.blocks[i];
+    }
+    delete[] store->arena.blocks;
+    delete store;
+}
+
+void attachSongStoreBase(SongStore* store, const SongStoreBase& base) {
+    store->base = base;
+    store->count = base.count;
+}
+
+// ===== AÑADIR CANCIÓN =====
+int appendSong(SongStore* store, uint32_t id, uint32_t duration, uint8_t state,
+               const char* texts[SONG_TEXT_FIELDS]) {
+    int slot = store->count;
+    int chunkIndex = (slot - store->base.count) / SONG_CHUNK_SIZE;
+
+    if (chunkIndex >= store->chunkCount) {
+        if (store->chunkCount >= store->chunkCapacity) {
+            int newCapacity = store->chunkCapacity * 2;
+            SongChunk** newChunks = new SongChunk*[newCapacity];
+            memcpy(newChunks, store->chunks, sizeof(SongChunk*) * store->chunkCount);
+            retireArray(store->chunks);
+            EPOCH_PUBLISH(store->chunks, newChunks);
+            store->chunkCapacity = newCapacity;
+        }
+        store->chunks[store->chunkCount++] = new SongChunk;
+    }
+
+    SongChunk* chunk = store->chunks[chunkIndex];
+    int row = (slot - store->base.count) % SONG_CHUNK_SIZE;
+
+    // Los cuatro textos juntos en un solo registro de la arena
+    char record[SONG_TEXT_FIELDS * (SONG_TEXT_MAX + 1)];
+    size_t recordLength = 0;
+    for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+        size_t length = strnlen(texts[field], SONG_TEXT_MAX);
+        memcpy(record + recordLength, texts[field], length);
+        record[recordLength + length] = '\0';
+        recordLength += length + 1;
+        chunk->textLengths[row][field] = (uint16_t)length;
+    }
+
+    chunk->ids[row] = id;
+    chunk->durations[row] = duration;
+    chunk->states[row] = state;
+    chunk->textOffsets[row] = arenaAppend(&store->arena, record, recordLength);
+
+    // La fila ya está completa: a partir de aquí la ven los lectores
+    EPOCH_PUBLISH(store->count, slot + 1);
+    return slot;
+}
+
+// ===== ACCESO POR POSICIÓN =====
+// Las posiciones por debajo de base.count están en el archivo mapeado
+#define OVERLAY_CHUNK(store, slot) \
+    (EPOCH_LOAD((store)->chunks)[((slot) - (store)->base.count) / SONG_CHUNK_SIZE])
+#define OVERLAY_ROW(store, slot) (((slot) - (store)->base.count) % SONG_CHUNK_SIZE)
+
+uint32_t storeId(SongStore* store, int slot) {
+    if (slot < store->base.count) return store->base.ids[slot];
+    return OVERLAY_CHUNK(store, slot)->ids[OVERLAY_ROW(store, slot)];
+}
+
+uint32_t storeDuration(SongStore* store, int slot) {
+    if (slot < store->base.count) return store->base.durations[slot];
+    return OVERLAY_CHUNK(store, slot)->durations[OVERLAY_ROW(store, slot)];
+}
+
+// El estado es lo único que cambia en una fila ya publicada
+uint8_t storeState(SongStore* store, int slot) {
+    if (slot < store->base.count) {
+        return __atomic_load_n(&store->base.states[slot], __ATOMIC_RELAXED);
+    }
+    return __atomic_load_n(&OVERLAY_CHUNK(store, slot)->states[OVERLAY_ROW(store, slot)],
+                           __ATOMIC_RELAXED);
+}
+
+void storeSetState(SongStore* store, int slot, uint8_t state) {
+    if (slot < store->base.count) {
+        __atomic_store_n(&store->base.states[slot], state, __ATOMIC_RELAXED);
+        return;
+    }
+    __atomic_store_n(&OVERLAY_CHUNK(store, slot)->states[OVERLAY_ROW(store, slot)], state,
+                     __ATOMIC_RELAXED);
+}
+
+// ¿Cae el registro de texto de una fila del archivo dentro de la arena, con
+// cada texto acabado en '\0'? Se mira al leer la fila, no todas al cargar:
+// recorrerlas traería la arena entera a memoria
+static bool baseTextValid(const SongStoreBase& base, int slot) {
+    uint64_t position = base.textOffsets[slot];
+    for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+        uint16_t length = base.textLengths[slot][field];
+        if (length > SONG_TEXT_MAX || position >= base.arenaBytes ||
+            length >= base.arenaBytes - position || base.arena[position + length] != '\0') {
+            return false;
+        }
+        position += length + 1;
+    }
+    return true;
+}
+
+// Una fila del archivo con el texto corrupto se lee con los textos vacíos
+const char* storeText(SongStore* store, int slot, int field) {
+    const char* text;
+    const uint16_t* lengths;
+
+    if (slot < store->base.count) {
+        if (!baseTextValid(store->base, slot)) {
+            return "";
+        }
+        text = store->base.arena + store->base.textOffsets[slot];
+        lengths = store->base.textLengths[slot];
+    } else {
+        SongChunk* chunk = OVERLAY_CHUNK(store, slot);
+        int row = OVERLAY_ROW(store, slot);
+        text = arenaGet(&store->arena, chunk->textOffsets[row]);
+        lengths = chunk->textLengths[row];
+    }
+
+    for (int i = 0; i < field; i++) {
+        text += lengths[i] + 1;
+    }
+    return text;
+}
+
+const uint16_t* storeTextLengths(SongStore* store, int slot) {
+    if (slot < store->base.count) return store->base.textLengths[slot];
+    return OVERLAY_CHUNK(store, slot)->textLengths[OVERLAY_ROW(store, slot)];
+}
+
+// ===== MEMORIA OCUPADA (columnas + arena) =====
+size_t songStoreMemory(SongStore* store) {
+    return (size_t)store->chunkCount * sizeof(SongChunk) +
+           (size_t)store->arena.blockCount * ARENA_BLOCK_SIZE;
+}
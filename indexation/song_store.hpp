@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ===== ALMACÉN DE CANCIONES EN COLUMNAS + ARENA DE TEXTO =====
+// Las columnas se guardan por bloques de tamaño fijo: añadir canciones nunca
+// copia las existentes, solo se duplica el directorio de bloques (punteros).
+
+#define SONG_CHUNK_SIZE 4096            // canciones por bloque de columnas
+#define ARENA_BLOCK_SIZE (1 << 20)      // bytes por bloque de la arena
+
+// Textos de una canción, guardados seguidos (con '\0') en la arena
+#define TEXT_TITLE    0
+#define TEXT_ARTIST   1
+#define TEXT_FILENAME 2
+#define TEXT_URL      3
+#define SONG_TEXT_FIELDS 4
+#define SONG_TEXT_MAX 1023              // bytes por texto (Song::url es el mayor: 511)
+
+struct SongChunk {
+    uint32_t ids[SONG_CHUNK_SIZE];
+    uint32_t durations[SONG_CHUNK_SIZE];
+    uint8_t states[SONG_CHUNK_SIZE];
+    uint64_t textOffsets[SONG_CHUNK_SIZE];                      // título en la arena
+    uint16_t textLengths[SONG_CHUNK_SIZE][SONG_TEXT_FIELDS];    // sin contar '\0'
+};
+
+struct StringArena {
+    char** blocks;
+    int blockCount;
+    int blockCapacity;
+    size_t used;            // bytes ocupados del último bloque
+    size_t totalBytes;
+};
+
+// ===== BASE DE SOLO LECTURA (columnas del archivo mapeado) =====
+// Las posiciones 0..count-1 se leen directamente del archivo; las canciones
+// nuevas van a los bloques en memoria, detrás de la base.
+struct SongStoreBase {
+    int count;
+    const uint32_t* ids;
+    const uint32_t* durations;
+    uint8_t* states;            // mapeo MAP_PRIVATE: escribir solo copia esa página
+    const uint64_t* textOffsets;
+    const uint16_t (*textLengths)[SONG_TEXT_FIELDS];
+    const char* arena;
+    uint64_t arenaBytes;
+};
+
+// Un escritor y varios lectores (ver epoch.hpp): count se publica cuando la
+// fila está completa y los directorios de bloques se retiran al crecer
+struct SongStore {
+    SongStoreBase base;
+    SongChunk** chunks;
+    int chunkCount;
+    int chunkCapacity;
+    int count;
+    StringArena arena;
+};
+
+// ===== FUNCIONES =====
+
+SongStore* createSongStore();
+void freeSongStore(SongStore* store);
+
+// Solo sobre un almacén vacío; la memoria de la base es del llamador
+void attachSongStoreBase(SongStore* store, const SongStoreBase& base);
+
+// Devuelve la posición (slot) de la canción añadida
+int appendSong(SongStore* store, uint32_t id, uint32_t duration, uint8_t state,
+               const char* texts[SONG_TEXT_FIELDS]);
+
+uint32_t storeId(SongStore* store, int slot);
+uint32_t storeDuration(SongStore* store, int slot);
+uint8_t storeState(SongStore* store, int slot);
+void storeSetState(SongStore* store, int slot, uint8_t state);
+// Una fila del archivo cuyo texto no cabe en la arena se lee vacía
+const char* storeText(SongStore* store, int slot, int field);
+const uint16_t* storeTextLengths(SongStore* store, int slot);
+
+size_t songStoreMemory(SongStore* store);
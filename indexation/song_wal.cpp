@@ -0,0 +1,320 @@
+#include "song_wal.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static long long walNowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// ===== CHECKSUM FNV-1a =====
+static uint32_t walChecksum(const WalRecordHeader& header, const char* texts) {
+    WalRecordHeader copy = header;
+    copy.checksum = 0;
+
+    size_t textBytes = 0;
+    for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+        textBytes += header.textLengths[field];
+    }
+
+    uint32_t hash = 2166136261u;
+    const unsigned char* bytes = (const unsigned char*)&copy;
+    for (size_t i = 0; i < sizeof(copy); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    for (size_t i = 0; i < textBytes; i++) {
+        hash = (hash ^ (unsigned char)texts[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t written = write(fd, data + total, size - total);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        total += written;
+    }
+    return true;
+}
+
+// ===== REPRODUCIR: devuelve los bytes válidos (lo que sigue es una escritura a medias) =====
+// -1 si el archivo existe y no se pudo leer: entonces no se recorta nada
+static ssize_t replaySongWal(const char* filepath, WalRecordHandler handler, void* owner) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        cerr << "[WAL] No se pudo leer el tamaño de " << filepath << ": " << strerror(errno) << endl;
+        close(fd);
+        return -1;
+    }
+    string data(st.st_size, '\0');
+    ssize_t bytesRead = read(fd, &data[0], st.st_size);
+    close(fd);
+    if (bytesRead != st.st_size) {
+        cerr << "[WAL] No se pudo leer el WAL" << endl;
+        return -1;
+    }
+
+    size_t pos = 0;
+    int records = 0;
+    while (pos + sizeof(WalRecordHeader) <= data.size()) {
+        WalRecordHeader header;
+        memcpy(&header, data.data() + pos, sizeof(header));
+        const char* texts = data.data() + pos + sizeof(header);
+
+        size_t textBytes = 0;
+        bool lengthsOk = true;
+        for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+            textBytes += header.textLengths[field];
+            lengthsOk = lengthsOk && header.textLengths[field] <= SONG_TEXT_MAX;
+        }
+
+        // Un registro truncado o corrupto marca el final válido
+        if (!lengthsOk || pos + sizeof(header) + textBytes > data.size() ||
+            walChecksum(header, texts) != header.checksum) {
+            cerr << "[WAL] Registro inválido en offset " << pos << ", se ignora el resto" << endl;
+            break;
+        }
+
+        char copies[SONG_TEXT_FIELDS][SONG_TEXT_MAX + 1];
+        const char* fields[SONG_TEXT_FIELDS];
+        for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+            memcpy(copies[field], texts, header.textLengths[field]);
+            copies[field][header.textLengths[field]] = '\0';
+            fields[field] = copies[field];
+            texts += header.textLengths[field];
+        }
+
+        handler(owner, header, fields);
+        pos += sizeof(header) + textBytes;
+        records++;
+    }
+
+    if (records > 0) {
+        cout << "[WAL] " << records << " registros reproducidos" << endl;
+    }
+    return pos;
+}
+
+SongWal* openSongWal(const char* filepath, WalRecordHandler handler, void* owner) {
+    // Un checkpoint que no terminó: sus registros son anteriores a los del WAL.
+    // Su cola a medias se quita también, o el siguiente rotateSongWal le
+    // añadiría el WAL detrás y al reproducir se perdería
+    string ckptPath = string(filepath) + ".ckpt";
+    ssize_t ckptBytes = replaySongWal(ckptPath.c_str(), handler, owner);
+    struct stat ckptStat;
+    if (ckptBytes >= 0 && stat(ckptPath.c_str(), &ckptStat) == 0 && ckptStat.st_size > ckptBytes &&
+        truncate(ckptPath.c_str(), ckptBytes) < 0) {
+        cerr << "[WAL] No se pudo recortar " << ckptPath << ": " << strerror(errno) << endl;
+    }
+    ssize_t validBytes = replaySongWal(filepath, handler, owner);
+    if (validBytes < 0) {
+        // Sin tocarlo: escribir detrás de lo que no se pudo leer lo perdería
+        return nullptr;
+    }
+
+    int fd = open(filepath, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        cerr << "[WAL] No se pudo abrir " << filepath << ": " << strerror(errno) << endl;
+        return nullptr;
+    }
+
+    // Quitar la cola a medias para que lo nuevo quede detrás de lo válido
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > validBytes) {
+        if (ftruncate(fd, validBytes) < 0) {
+            cerr << "[WAL] No se pudo recortar el WAL: " << strerror(errno) << endl;
+        }
+    }
+
+    SongWal* wal = new SongWal();
+    wal->fd = fd;
+    wal->path = filepath;
+    wal->fileBytes = validBytes;
+    wal->firstRecordMs = validBytes > 0 ? walNowMs() : 0;
+    return wal;
+}
+
+void closeSongWal(SongWal* wal) {
+    if (!wal) return;
+    flushSongWal(wal);
+    close(wal->fd);
+    delete wal;
+}
+
+static void appendRecord(SongWal* wal, WalRecordHeader& header, const char* texts) {
+    header.checksum = walChecksum(header, texts);
+    wal->buffer.append((const char*)&header, sizeof(header));
+
+    for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+        wal->buffer.append(texts, header.textLengths[field]);
+        texts += header.textLengths[field];
+    }
+
+    if (wal->firstRecordMs == 0) {
+        wal->firstRecordMs = walNowMs();
+    }
+    if (wal->buffer.size() >= WAL_FLUSH_BYTES) {
+        flushSongWal(wal);
+    }
+}
+
+static void appendSongRecord(SongWal* wal, uint8_t kind, uint32_t id, uint32_t duration,
+                             uint8_t state, const char* texts[SONG_TEXT_FIELDS]) {
+    if (!wal) return;
+
+    WalRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = kind;
+    header.state = state;
+    header.songId = id;
+    header.duration = duration;
+
+    char joined[SONG_TEXT_FIELDS * SONG_TEXT_MAX];
+    size_t joinedLength = 0;
+    for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+        size_t length = strnlen(texts[field], SONG_TEXT_MAX);
+        memcpy(joined + joinedLength, texts[field], length);
+        joinedLength += length;
+        header.textLengths[field] = (uint16_t)length;
+    }
+
+    appendRecord(wal, header, joined);
+}
+
+void walAppendSong(SongWal* wal, uint32_t id, uint32_t duration, uint8_t state,
+                   const char* texts[SONG_TEXT_FIELDS]) {
+    appendSongRecord(wal, WAL_ADD_SONG, id, duration, state, texts);
+}
+
+void walUpdateSong(SongWal* wal, uint32_t id, uint32_t duration, uint8_t state,
+                   const char* texts[SONG_TEXT_FIELDS]) {
+    appendSongRecord(wal, WAL_UPDATE_SONG, id, duration, state, texts);
+}
+
+void walSetState(SongWal* wal, uint32_t id, uint8_t state) {
+    if (!wal) return;
+
+    WalRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = WAL_SET_STATE;
+    header.state = state;
+    header.songId = id;
+    appendRecord(wal, header, "");
+}
+
+// ===== GROUP COMMIT: un write + fdatasync para todo lo acumulado =====
+// Si algo falla, el buffer se conserva y el archivo vuelve a fileBytes para
+// que el reintento no deje un registro a medias delante de los siguientes.
+bool flushSongWal(SongWal* wal) {
+    if (!wal || wal->buffer.empty()) return true;
+
+    bool written = writeAll(wal->fd, wal->buffer.data(), wal->buffer.size());
+    if (!written || fdatasync(wal->fd) < 0) {
+        cerr << "[WAL] Error " << (written ? "sincronizando" : "escribiendo")
+             << " el WAL: " << strerror(errno) << endl;
+        if (ftruncate(wal->fd, wal->fileBytes) < 0) {
+            cerr << "[WAL] No se pudo recortar el WAL: " << strerror(errno) << endl;
+        }
+        return false;
+    }
+    wal->fileBytes += wal->buffer.size();
+    wal->buffer.clear();
+    return true;
+}
+
+bool songWalNeedsCheckpoint(SongWal* wal) {
+    if (!wal || wal->firstRecordMs == 0) return false;
+    return wal->fileBytes + wal->buffer.size() >= WAL_CHECKPOINT_BYTES ||
+           walNowMs() - wal->firstRecordMs >= WAL_CHECKPOINT_INTERVAL_MS;
+}
+
+void resetSongWal(SongWal* wal) {
+    if (!wal) return;
+
+    wal->buffer.clear();
+    if (ftruncate(wal->fd, 0) < 0) {
+        cerr << "[WAL] No se pudo vaciar el WAL: " << strerror(errno) << endl;
+        return;
+    }
+    if (fdatasync(wal->fd) < 0) {
+        cerr << "[WAL] No se pudo sincronizar el WAL vacío: " << strerror(errno) << endl;
+    }
+    wal->fileBytes = 0;
+    wal->firstRecordMs = 0;
+}
+
+// ===== ROTAR PARA UN CHECKPOINT EN SEGUNDO PLANO =====
+bool rotateSongWal(SongWal* wal) {
+    if (!wal) return true;
+
+    if (!flushSongWal(wal)) {
+        return false;
+    }
+
+    string ckptPath = wal->path + ".ckpt";
+    if (access(ckptPath.c_str(), F_OK) != 0) {
+        // Caso normal: el WAL entero pasa a ser el .ckpt
+        if (rename(wal->path.c_str(), ckptPath.c_str()) < 0) {
+            cerr << "[WAL] No se pudo rotar el WAL: " << strerror(errno) << endl;
+            return false;
+        }
+        int fd = open(wal->path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            cerr << "[WAL] No se pudo reabrir el WAL: " << strerror(errno) << endl;
+            rename(ckptPath.c_str(), wal->path.c_str());
+            return false;
+        }
+        close(wal->fd);
+        wal->fd = fd;
+    } else if (wal->fileBytes > 0) {
+        // Queda el .ckpt de un checkpoint fallido: añadirle el WAL detrás
+        // (si la copia falla, el .ckpt vuelve a su tamaño para no dejar una cola a medias)
+        string data(wal->fileBytes, '\0');
+        int readFd = open(wal->path.c_str(), O_RDONLY);
+        int ckptFd = open(ckptPath.c_str(), O_WRONLY | O_APPEND);
+        struct stat ckptStat;
+        bool ok = readFd >= 0 && ckptFd >= 0 && fstat(ckptFd, &ckptStat) == 0 &&
+                  read(readFd, &data[0], data.size()) == (ssize_t)data.size();
+        if (ok && (!writeAll(ckptFd, data.data(), data.size()) || fdatasync(ckptFd) < 0)) {
+            if (ftruncate(ckptFd, ckptStat.st_size) < 0) {
+                cerr << "[WAL] No se pudo recortar " << ckptPath << ": " << strerror(errno) << endl;
+            }
+            ok = false;
+        }
+        if (readFd >= 0) close(readFd);
+        if (ckptFd >= 0) close(ckptFd);
+        if (!ok || ftruncate(wal->fd, 0) < 0) {
+            cerr << "[WAL] No se pudo pasar el WAL a " << ckptPath << endl;
+            return false;
+        }
+        if (fdatasync(wal->fd) < 0) {
+            cerr << "[WAL] No se pudo sincronizar el WAL vacío: " << strerror(errno) << endl;
+        }
+    }
+
+    wal->fileBytes = 0;
+    wal->firstRecordMs = 0;
+    return true;
+}
+
+void finishSongWalCheckpoint(SongWal* wal) {
+    if (!wal) return;
+    unlink((wal->path + ".ckpt").c_str());
+}
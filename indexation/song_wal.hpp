@@ -0,0 +1,69 @@
+#pragma once
+
+#include "song_store.hpp"
+#include <cstdint>
+#include <string>
+
+// ===== WRITE-AHEAD LOG DE LA BASE DE DATOS =====
+// Cada alta o cambio de estado se añade al WAL; el archivo de la base solo se
+// reescribe en los checkpoints, que luego vacían el WAL.
+
+// Tipos de registro
+#define WAL_ADD_SONG    1
+#define WAL_SET_STATE   2
+#define WAL_UPDATE_SONG 3    // metadatos corregidos: la fila completa de nuevo
+
+// Se fuerza escritura + fdatasync al superar este tamaño de buffer
+#define WAL_FLUSH_BYTES (64 * 1024)
+// Checkpoint al superar este tamaño de WAL o este tiempo con registros
+#define WAL_CHECKPOINT_BYTES (8 * 1024 * 1024)
+#define WAL_CHECKPOINT_INTERVAL_MS (5 * 60 * 1000)
+
+// Registro en disco (en WAL_ADD_SONG y WAL_UPDATE_SONG le siguen los textos, sin '\0')
+#pragma pack(1)
+struct WalRecordHeader {
+    uint8_t kind;
+    uint8_t state;
+    uint32_t songId;
+    uint32_t duration;
+    uint16_t textLengths[SONG_TEXT_FIELDS];
+    uint32_t checksum;      // FNV-1a de la cabecera (checksum = 0) + textos
+};
+#pragma pack()
+
+struct SongWal {
+    int fd;
+    std::string path;
+    std::string buffer;             // registros pendientes de escribir (group commit)
+    uint64_t fileBytes;             // bytes ya escritos en el archivo
+    long long firstRecordMs;        // primer registro desde el último checkpoint (0 = vacío)
+};
+
+// Recibe cada registro válido al reproducir (textos terminados en '\0')
+typedef void (*WalRecordHandler)(void* owner, const WalRecordHeader& header,
+                                 const char* texts[SONG_TEXT_FIELDS]);
+
+// ===== FUNCIONES =====
+
+// Reproduce <wal>.ckpt y el WAL existentes y deja el WAL abierto para añadir
+SongWal* openSongWal(const char* filepath, WalRecordHandler handler, void* owner);
+void closeSongWal(SongWal* wal);
+
+void walAppendSong(SongWal* wal, uint32_t id, uint32_t duration, uint8_t state,
+                   const char* texts[SONG_TEXT_FIELDS]);
+void walUpdateSong(SongWal* wal, uint32_t id, uint32_t duration, uint8_t state,
+                   const char* texts[SONG_TEXT_FIELDS]);
+void walSetState(SongWal* wal, uint32_t id, uint8_t state);
+
+// false si no se pudo escribir o sincronizar (el buffer se conserva para reintentar)
+bool flushSongWal(SongWal* wal);
+bool songWalNeedsCheckpoint(SongWal* wal);
+// Tras un checkpoint: todo lo registrado ya está en el archivo de la base
+void resetSongWal(SongWal* wal);
+
+// ===== CHECKPOINT EN SEGUNDO PLANO =====
+// Al empezar, lo escrito hasta ahora pasa a <wal>.ckpt (lo cubre la foto del
+// fork) y el WAL sigue vacío; si el checkpoint acaba bien se borra el .ckpt.
+// Si falla se conserva y se reproduce antes que el WAL al cargar.
+bool rotateSongWal(SongWal* wal);
+void finishSongWalCheckpoint(SongWal* wal);
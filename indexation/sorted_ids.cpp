@@ -0,0 +1,135 @@
+#include "sorted_ids.hpp"
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// ===== GALLOPING: cada id de la corta se busca en la larga =====
+// Búsqueda exponencial desde donde se quedó la anterior y binaria al final
+static int gallopIntersect(const int* small, int smallCount, const int* large, int largeCount,
+                           int* out) {
+    int count = 0;
+    int low = 0;
+    for (int i = 0; i < smallCount && low < largeCount; i++) {
+        int target = small[i];
+        int bound = 1;
+        while (low + bound < largeCount && large[low + bound] < target) {
+            bound *= 2;
+        }
+        int high = min(low + bound + 1, largeCount);
+        low = lower_bound(large + low + bound / 2, large + high, target) - large;
+        if (low < largeCount && large[low] == target) {
+            out[count++] = target;
+            low++;
+        }
+    }
+    return count;
+}
+
+// ===== MEZCLA NORMAL (y final de la versión SIMD) =====
+static int mergeIntersect(const int* a, int aCount, const int* b, int bCount, int* out,
+                          int i, int j, int count) {
+    while (i < aCount && j < bCount) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            out[count++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return count;
+}
+
+// ===== BLOQUES CON SIMD =====
+// Se compara un bloque de a con todas las rotaciones del bloque de b: cada bit
+// de la máscara es un id de a que está en b. Luego avanza el bloque que acaba
+// antes (o los dos si acaban en el mismo id).
+#if defined(__AVX2__)
+#define SIMD_LANES 8
+
+static int simdIntersect(const int* a, int aCount, const int* b, int bCount, int* out) {
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    int i = 0;
+    int j = 0;
+    int count = 0;
+    while (i + SIMD_LANES <= aCount && j + SIMD_LANES <= bCount) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        __m256i match = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < SIMD_LANES; r++) {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi32(va, vb));
+        }
+
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+        while (mask) {
+            out[count++] = a[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+
+        int aLast = a[i + SIMD_LANES - 1];
+        int bLast = b[j + SIMD_LANES - 1];
+        if (aLast <= bLast) i += SIMD_LANES;
+        if (bLast <= aLast) j += SIMD_LANES;
+    }
+    return mergeIntersect(a, aCount, b, bCount, out, i, j, count);
+}
+#elif defined(__SSE2__)
+#define SIMD_LANES 4
+
+static int simdIntersect(const int* a, int aCount, const int* b, int bCount, int* out) {
+    int i = 0;
+    int j = 0;
+    int count = 0;
+    while (i + SIMD_LANES <= aCount && j + SIMD_LANES <= bCount) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        __m128i match = _mm_cmpeq_epi32(va, vb);
+        for (int r = 1; r < SIMD_LANES; r++) {
+            vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            match = _mm_or_si128(match, _mm_cmpeq_epi32(va, vb));
+        }
+
+        unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(match));
+        while (mask) {
+            out[count++] = a[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+
+        int aLast = a[i + SIMD_LANES - 1];
+        int bLast = b[j + SIMD_LANES - 1];
+        if (aLast <= bLast) i += SIMD_LANES;
+        if (bLast <= aLast) j += SIMD_LANES;
+    }
+    return mergeIntersect(a, aCount, b, bCount, out, i, j, count);
+}
+#else
+static int simdIntersect(const int* a, int aCount, const int* b, int bCount, int* out) {
+    return mergeIntersect(a, aCount, b, bCount, out, 0, 0, 0);
+}
+#endif
+
+int intersectSortedIds(const int* a, int aCount, const int* b, int bCount, int* out) {
+    if (aCount > bCount) {
+        swap(a, b);
+        swap(aCount, bCount);
+    }
+    if (aCount == 0) {
+        return 0;
+    }
+    if ((long long)aCount * GALLOP_RATIO < bCount) {
+        return gallopIntersect(a, aCount, b, bCount, out);
+    }
+    return simdIntersect(a, aCount, b, bCount, out);
+}
+
+void sortUniqueIds(vector<int>& ids) {
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+}
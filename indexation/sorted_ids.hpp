@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+// ===== OPERACIONES SOBRE LISTAS DE IDS ORDENADAS =====
+// Listas de menor a mayor y sin repetidos (como las de postings.hpp).
+// La intersección elige sola el método: galloping si una lista es mucho más
+// corta que la otra; si no, comparación por bloques con SIMD (AVX2 si se
+// compila con -mavx2 o -march=native, SSE2 en cualquier x86-64) o mezcla
+// normal en otras arquitecturas.
+
+// Si la lista larga tiene más de este factor por elemento de la corta, galloping
+#define GALLOP_RATIO 32
+
+// Escribe en out (capacidad >= min(aCount, bCount)) los ids comunes; devuelve cuántos
+int intersectSortedIds(const int* a, int aCount, const int* b, int bCount, int* out);
+
+// Deja ids ordenado y sin repetidos
+void sortUniqueIds(std::vector<int>& ids);
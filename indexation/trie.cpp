@@ -1,13 +1,17 @@
 #include "trie.hpp"
+#include "epoch.hpp"
 #include <cctype>
 #include <cstring>
-#include <unordered_set>
+#include <vector>
 
 using namespace std;
 
 // ===== CREAR NODO =====
 TrieNode* createTrieNode() {
     TrieNode* node = new TrieNode();
+    node->childCapacity = 2;
+    node->children = new TrieChild[2];
+    node->childCount = 0;
     node->isEndOfWord = false;
     node->songIdCapacity = 4;
     node->songIds = new int[4];
@@ -22,10 +26,49 @@ Trie* createTrie() {
     return trie;
 }
 
-// ===== INSERTAR PALABRA =====
-void insertWordTrie(Trie* trie, string word, int songId) {
-    if (!trie || word.empty()) return;
-    
+// ===== HIJO POR CARÁCTER (lectores y escritor) =====
+static TrieNode* findChild(TrieNode* node, char c) {
+    int count = EPOCH_LOAD(node->childCount);
+    TrieChild* children = EPOCH_LOAD(node->children);
+    for (int i = 0; i < count; i++) {
+        if (children[i].c == c) {
+            return children[i].node;
+        }
+    }
+    return nullptr;
+}
+
+static TrieNode* addChild(TrieNode* node, char c) {
+    if (node->childCount >= node->childCapacity) {
+        int newCapacity = node->childCapacity * 2;
+        TrieChild* newChildren = new TrieChild[newCapacity];
+        memcpy(newChildren, node->children, node->childCount * sizeof(TrieChild));
+        retireArray(node->children);
+        EPOCH_PUBLISH(node->children, newChildren);
+        node->childCapacity = newCapacity;
+    }
+
+    TrieNode* child = createTrieNode();
+    node->children[node->childCount].c = c;
+    node->children[node->childCount].node = child;
+    EPOCH_PUBLISH(node->childCount, node->childCount + 1);
+    return child;
+}
+
+// ===== NODO DE UNA PALABRA COMPLETA =====
+TrieNode* findTrieWord(Trie* trie, const string& word) {
+    TrieNode* node = trie->root;
+    for (char c : word) {
+        node = findChild(node, tolower(c));
+        if (!node) {
+            return nullptr;
+        }
+    }
+    return EPOCH_LOAD(node->isEndOfWord) ? node : nullptr;
+}
+
+// ===== BAJAR POR LA PALABRA CREANDO LOS NODOS QUE FALTEN =====
+static TrieNode* walkCreating(Trie* trie, const string& word) {
     TrieNode* node = trie->root;
     
     // Convertir a minúsculas y recorrer
@@ -33,85 +76,133 @@ void insertWordTrie(Trie* trie, string word, int songId) {
         c = tolower(c);
         
         // Si no existe hijo con ese carácter, crearlo
-        if (node->children.find(c) == node->children.end()) {
-            node->children[c] = createTrieNode();
+        TrieNode* child = findChild(node, c);
+        if (!child) {
+            child = addChild(node, c);
         }
         
         // Bajar al hijo
-        node = node->children[c];
+        node = child;
     }
     
     // Marcar fin de palabra
-    node->isEndOfWord = true;
-    
-    // Verificar duplicados
-    for (int i = 0; i < node->songIdCount; i++) {
-        if (node->songIds[i] == songId) {
-            return;  // Ya existe
-        }
-    }
+    EPOCH_PUBLISH(node->isEndOfWord, true);
+    return node;
+}
+
+// ===== INSERTAR PALABRA =====
+void insertWordTrie(Trie* trie, string word, int songId) {
+    if (!trie || word.empty()) return;
     
-    // Expandir si es necesario
-    if (node->songIdCount >= node->songIdCapacity) {
-        int newCapacity = node->songIdCapacity * 2;
-        int* newIds = new int[newCapacity];
-        memcpy(newIds, node->songIds, node->songIdCount * sizeof(int));
-        delete[] node->songIds;
-        node->songIds = newIds;
-        node->songIdCapacity = newCapacity;
-    }
+    TrieNode* node = walkCreating(trie, word);
     
-    // Añadir songId
-    node->songIds[node->songIdCount++] = songId;
+    // Los ids llegan crecientes: solo un UPDATE busca si ya estaba
+    insertPublishedSorted(node->songIds, node->songIdCount, node->songIdCapacity, songId);
 }
 
 
+// ===== INSERTAR PALABRA CON TODOS SUS IDS (carga del índice guardado) =====
+// La palabra no debe tener ids todavía
+void insertPostingsTrie(Trie* trie, string word, const int* songIds, int count) {
+    if (!trie || word.empty() || count == 0) return;
+    
+    TrieNode* node = walkCreating(trie, word);
+    int* ids = new int[count];
+    memcpy(ids, songIds, count * sizeof(int));
+    retireArray(node->songIds);
+    EPOCH_PUBLISH(node->songIds, ids);
+    node->songIdCapacity = count;
+    EPOCH_PUBLISH(node->songIdCount, count);
+}
+
 // ===== BÚSQUEDA RECURSIVA DE TODOS LOS HIJOS =====
-void collectAllSongIds(TrieNode* node, unordered_set<int>& results) {
+void collectAllSongIds(TrieNode* node, vector<int>& results) {
     if (!node) return;
     
     // Si es fin de palabra, añadir IDs
-    if (node->isEndOfWord) {
-        for (int i = 0; i < node->songIdCount; i++) {
-            results.insert(node->songIds[i]);
-        }
+    if (EPOCH_LOAD(node->isEndOfWord)) {
+        int count = EPOCH_LOAD(node->songIdCount);
+        int* songIds = EPOCH_LOAD(node->songIds);
+        results.insert(results.end(), songIds, songIds + count);
     }
     
     // Recorrer todos los hijos
-    for (auto& pair : node->children) {
-        collectAllSongIds(pair.second, results);
+    int childCount = EPOCH_LOAD(node->childCount);
+    TrieChild* children = EPOCH_LOAD(node->children);
+    for (int i = 0; i < childCount; i++) {
+        collectAllSongIds(children[i].node, results);
     }
 }
 
 // ===== BUSCAR POR PREFIJO (AUTOCOMPLETAR) =====
-void searchPrefix(Trie* trie, string prefix, unordered_set<int>& results) {
+void searchPrefix(Trie* trie, string prefix, vector<int>& results) {
     if (!trie || prefix.empty()) return;
     
+    EpochGuard guard;
     TrieNode* node = trie->root;
     
     // Buscar el nodo del prefijo
     for (char c : prefix) {
         c = tolower(c);
         
-        if (node->children.find(c) == node->children.end()) {
+        node = findChild(node, c);
+        if (!node) {
             return;  // Prefijo no existe
         }
-        
-        node = node->children[c];
     }
     
     // Recolectar todos los IDs desde este nodo hacia abajo
     collectAllSongIds(node, results);
 }
 
+// ===== PALABRAS DESDE UN NODO (path = la palabra hasta ese nodo) =====
+static bool collectWords(TrieNode* node, string& path, vector<string>& words, int maxWords) {
+    if (EPOCH_LOAD(node->isEndOfWord)) {
+        if ((int)words.size() >= maxWords) {
+            return false;
+        }
+        words.push_back(path);
+    }
+
+    int childCount = EPOCH_LOAD(node->childCount);
+    TrieChild* children = EPOCH_LOAD(node->children);
+    for (int i = 0; i < childCount; i++) {
+        path.push_back(children[i].c);
+        bool ok = collectWords(children[i].node, path, words, maxWords);
+        path.pop_back();
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool collectPrefixWords(Trie* trie, const string& prefix, vector<string>& words, int maxWords) {
+    if (!trie || prefix.empty()) return true;
+
+    EpochGuard guard;
+    TrieNode* node = trie->root;
+    string path;
+    for (char c : prefix) {
+        c = tolower(c);
+        node = findChild(node, c);
+        if (!node) {
+            return true;
+        }
+        path.push_back(c);
+    }
+    return collectWords(node, path, words, maxWords);
+}
+
 // ===== LIBERAR NODO RECURSIVAMENTE =====
 void freeTrieNode(TrieNode* node) {
     if (!node) return;
     
     // Liberar todos los hijos
-    for (auto& pair : node->children) {
-        freeTrieNode(pair.second);
+    for (int i = 0; i < node->childCount; i++) {
+        freeTrieNode(node->children[i].node);
     }
+    delete[] node->children;
     
     // Liberar array de songIds
     delete[] node->songIds;
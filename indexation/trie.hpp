@@ -1,13 +1,23 @@
 #pragma once
 
-#include <unordered_map>
 #include <string>
-#include <unordered_set>
+#include <vector>
 
 using std::string;
 
+struct TrieNode;
+
+struct TrieChild {
+    char c;
+    TrieNode* node;
+};
+
+// Hijos y songIds son arrays que solo crecen: el elemento nuevo se escribe y
+// luego se publica el contador; al crecer se publica la copia (ver epoch.hpp)
 struct TrieNode {
-    std::unordered_map<char, TrieNode*> children;
+    TrieChild* children;
+    int childCount;
+    int childCapacity;
     bool isEndOfWord;
     int* songIds;
     int songIdCount;
@@ -21,5 +31,11 @@ struct Trie {
 
 Trie* createTrie();
 void insertWordTrie(Trie* trie, string word, int songId);
-void searchPrefix(Trie* trie, string prefix, std::unordered_set<int>& results);
-void freeTrie(Trie* trie);
\ No newline at end of file
+void insertPostingsTrie(Trie* trie, string word, const int* songIds, int count);
+TrieNode* findTrieWord(Trie* trie, const string& word);    // nullptr si no está
+// Añade a results los ids de todas las palabras con ese prefijo (sin ordenar,
+// puede haber repetidos)
+void searchPrefix(Trie* trie, string prefix, std::vector<int>& results);
+// Añade a words las palabras con ese prefijo; false si hay más de maxWords
+bool collectPrefixWords(Trie* trie, const string& prefix, std::vector<string>& words, int maxWords);
+void freeTrie(Trie* trie);
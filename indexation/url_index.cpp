@@ -0,0 +1,202 @@
+#include "url_index.hpp"
+#include "epoch.hpp"
+#include <cstring>
+
+// Número de bits del filtro de Bloom que se marcan por URL
+#define BLOOM_HASHES 4
+
+// ===== HASH DE 64 BITS (FNV-1a + finalizador de murmur3) =====
+uint64_t hashURL(const char* url) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char* ptr = (const unsigned char*)url; *ptr; ptr++) {
+        hash = (hash ^ *ptr) * 1099511628211ull;
+    }
+
+    // Mezclar para que los bits bajos (los que usa la máscara) sean buenos
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return hash == 0 ? 1 : hash;  // 0 está reservado para "hueco libre"
+}
+
+// ===== FILTRO DE BLOOM (doble hashing sobre el mismo hash de 64 bits) =====
+// Los bits solo pasan de 0 a 1; un lector que llega antes de tiempo ve la
+// URL como nueva, igual que si hubiera buscado un instante antes
+static void bloomAdd(UrlTable* table, uint64_t hash) {
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + i * h2) & (table->bloomBits - 1);
+        __atomic_fetch_or(&table->bloomWords[bit >> 6], 1ull << (bit & 63), __ATOMIC_RELAXED);
+    }
+}
+
+static bool bloomMayContain(UrlTable* table, uint64_t hash) {
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + i * h2) & (table->bloomBits - 1);
+        uint64_t word = __atomic_load_n(&table->bloomWords[bit >> 6], __ATOMIC_RELAXED);
+        if (!(word & (1ull << (bit & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===== RESERVAR TABLA + FILTRO (16 bits de Bloom por hueco) =====
+static UrlTable* createUrlTable(int capacity) {
+    UrlTable* table = new UrlTable();
+    table->capacity = capacity;
+    table->hashes = new uint64_t[capacity]();
+
+    table->slots = new int[capacity]();
+
+    table->bloomBits = (uint64_t)capacity * 16;
+    table->bloomWords = new uint64_t[table->bloomBits / 64]();
+    table->mapped = false;
+    return table;
+}
+
+static void freeUrlTable(void* pointer) {
+    UrlTable* table = (UrlTable*)pointer;
+    if (!table->mapped) {
+        delete[] table->hashes;
+        delete[] table->slots;
+        delete[] table->bloomWords;
+    }
+    delete table;
+}
+
+// Las sondas no pasan de capacity: una tabla mapeada puede venir llena de
+// basura; false si no queda hueco
+static bool placeEntry(UrlTable* table, uint64_t hash, int slot) {
+    int mask = table->capacity - 1;
+    int pos = (int)(hash & mask);
+    for (int probes = 0; table->hashes[pos] != 0; probes++) {
+        if (probes == table->capacity) {
+            return false;
+        }
+        pos = (pos + 1) & mask;
+    }
+    bloomAdd(table, hash);
+    table->slots[pos] = slot;
+    EPOCH_PUBLISH(table->hashes[pos], hash);
+    return true;
+}
+
+// ===== CRECER: los hashes ya están calculados, no hace falta releer URLs =====
+static void growUrlIndex(UrlIndex* index) {
+    UrlTable* oldTable = index->table;
+    UrlTable* newTable = createUrlTable(oldTable->capacity * 2);
+
+    for (int i = 0; i < oldTable->capacity; i++) {
+        if (oldTable->hashes[i] != 0) {
+            placeEntry(newTable, oldTable->hashes[i], oldTable->slots[i]);
+        }
+    }
+
+    EPOCH_PUBLISH(index->table, newTable);
+    retireMemory(oldTable, freeUrlTable);
+}
+
+UrlIndex* createUrlIndex(int expectedUrls, UrlBySlot urlBySlot, void* owner) {
+    UrlIndex* index = new UrlIndex();
+
+    int capacity = 64;
+    while (capacity < expectedUrls * 2) {
+        capacity *= 2;
+    }
+
+    index->table = createUrlTable(capacity);
+    index->count = 0;
+    index->urlBySlot = urlBySlot;
+    index->owner = owner;
+    return index;
+}
+
+void freeUrlIndex(UrlIndex* index) {
+    if (!index) return;
+    freeUrlTable(index->table);
+    delete index;
+}
+
+// ===== HUECO DE UNA URL EN LA TABLA (-1 si no está) =====
+static int findPosition(UrlIndex* index, UrlTable* table, uint64_t hash, const char* url) {
+    // Caso típico (URL nueva): el filtro responde sin tocar la tabla
+    if (!bloomMayContain(table, hash)) {
+        return -1;
+    }
+
+    int mask = table->capacity - 1;
+    int pos = (int)(hash & mask);
+    uint64_t stored;
+    for (int probes = 0; probes < table->capacity && (stored = EPOCH_LOAD(table->hashes[pos])) != 0;
+         probes++) {
+        // Mismo hash: confirmar con la URL real (colisiones de 64 bits)
+        if (stored == hash) {
+            const char* storedUrl = index->urlBySlot(index->owner, EPOCH_LOAD(table->slots[pos]));
+            if (storedUrl && strcmp(storedUrl, url) == 0) {
+                return pos;
+            }
+        }
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
+// Si la URL ya está (canción corregida o vuelta a añadir tras borrarla),
+// pasa a apuntar a la posición nueva
+void insertUrlIndex(UrlIndex* index, const char* url, int slot) {
+    uint64_t hash = hashURL(url);
+    int pos = findPosition(index, index->table, hash, url);
+    if (pos >= 0) {
+        EPOCH_PUBLISH(index->table->slots[pos], slot);
+        return;
+    }
+
+    if ((index->count + 1) * 2 > index->table->capacity) {
+        growUrlIndex(index);
+    }
+    // Sin hueco solo en una tabla mapeada corrupta: la del doble sí lo tiene
+    if (!placeEntry(index->table, hash, slot)) {
+        growUrlIndex(index);
+        placeEntry(index->table, hash, slot);
+    }
+    index->count++;
+}
+
+int findUrlIndex(UrlIndex* index, const char* url) {
+    EpochGuard guard;
+    UrlTable* table = EPOCH_LOAD(index->table);
+    int pos = findPosition(index, table, hashURL(url), url);
+    return pos >= 0 ? EPOCH_LOAD(table->slots[pos]) : -1;
+}
+
+// ===== TABLA GUARDADA EN EL ARCHIVO =====
+uint64_t urlTableBytes(int capacity) {
+    return (uint64_t)capacity * (sizeof(uint64_t) + sizeof(int)) + (uint64_t)capacity * 16 / 8;
+}
+
+bool mapUrlIndex(UrlIndex* index, char* data, uint64_t size, int capacity, int count) {
+    if (capacity < 64 || (capacity & (capacity - 1)) != 0 || count < 0 ||
+        (uint64_t)count * 2 > (uint64_t)capacity || size != urlTableBytes(capacity)) {
+        return false;
+    }
+
+    UrlTable* table = new UrlTable();
+    table->capacity = capacity;
+    table->hashes = (uint64_t*)data;
+    table->slots = (int*)(data + (uint64_t)capacity * sizeof(uint64_t));
+    table->bloomBits = (uint64_t)capacity * 16;
+    table->bloomWords = (uint64_t*)(data + (uint64_t)capacity * (sizeof(uint64_t) + sizeof(int)));
+    table->mapped = true;
+
+    freeUrlTable(index->table);
+    index->table = table;
+    index->count = count;
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// Devuelve la URL guardada en una posición de la base de datos (nullptr si
+// la posición no existe: una tabla mapeada del archivo no se valida al cargar)
+typedef const char* (*UrlBySlot)(void* owner, int slot);
+
+// ===== TABLA HASH (direccionamiento abierto) + FILTRO =====
+// Al crecer se construye una tabla nueva, se publica y la vieja se retira
+// (ver epoch.hpp); los lectores siempre ven una tabla completa.
+struct UrlTable {
+    uint64_t* hashes;       // 0 = hueco libre; se publica después del slot
+    int* slots;             // posición de la canción en la base de datos
+    int capacity;           // potencia de 2, ocupación <= 50%
+
+    // Filtro de Bloom delante de la tabla para el caso típico "URL nueva"
+    uint64_t* bloomWords;
+    uint64_t bloomBits;     // potencia de 2
+
+    bool mapped;            // arrays del archivo mapeado: no se liberan
+};
+
+struct UrlIndex {
+    UrlTable* table;
+    int count;
+
+    UrlBySlot urlBySlot;
+    void* owner;
+};
+
+// ===== FUNCIONES =====
+
+UrlIndex* createUrlIndex(int expectedUrls, UrlBySlot urlBySlot, void* owner);
+void freeUrlIndex(UrlIndex* index);
+
+uint64_t hashURL(const char* url);
+void insertUrlIndex(UrlIndex* index, const char* url, int slot);  // inserta o reemplaza
+int findUrlIndex(UrlIndex* index, const char* url);   // -1 si no está
+
+// ===== TABLA GUARDADA EN EL ARCHIVO =====
+// Bytes de una tabla de esa capacidad: hashes, slots y filtro seguidos
+uint64_t urlTableBytes(int capacity);
+// Usar sin copiar una tabla guardada (hashes, slots y filtro seguidos, como
+// los escribe la base); solo sobre un índice vacío. false si la capacidad
+// o count no son de una tabla válida
+bool mapUrlIndex(UrlIndex* index, char* data, uint64_t size, int capacity, int count);
@@ -123,6 +123,7 @@ void processCommands(int clientFd) {
 
 void disconnectClient(int clientFd, int epollFd) {
     removeFromEpoll(epollFd, clientFd);
+    detachClient(clientFd);
     close(clientFd);
     clientBuffers.erase(clientFd);
     cout << "[INFO] Cliente " << clientFd << " desconectado\n";
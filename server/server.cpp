@@ -34,14 +34,31 @@ int mainloop(int &serverSocket) {
 		return -1;
 	}
 
+	// Los checkpoints periódicos los escribe un hijo sin bloquear el reactor
+	initBackgroundCheckpoints(epollFd);
+
 	// Añadir server socket
 	int *epollFd_ptr = new int(epollFd);
 	addToEpoll(epollFd, serverSocket, handleServerEvent, epollFd_ptr);
 
 	// Inicializar comandos y workers
 	initializeCommandHandlers();
+	selectDownloader();
 	initializeWorkers(epollFd);
 
+	// Trabajos que quedaron a medias antes del último apagado
+	resumeJournaledJobs("jobs.journal");
+
+	// Tick periódico para tareas de mantenimiento
+	createPeriodicTimer(epollFd);
+	registerPeriodicTask(checkStalledDownloads);
+	registerPeriodicTask(flushJobJournal);
+	registerPeriodicTask(tickDownloadGuards);
+	registerPeriodicTask(tickDatabaseWal);
+	registerPeriodicTask(tickIndexCompaction);
+	registerPeriodicTask(tickSegmentMerges);
+	registerPeriodicTask(reclaimRetiredMemory);
+
 	struct epoll_event events[200];
 	serverRunning = true;
 
@@ -57,9 +74,11 @@ int mainloop(int &serverSocket) {
 	}
 	// Cleanup
 	
-	saveDatabase(globalDB, "db");
+	checkpointDatabase(globalDB);
 	freeDatabase(globalDB);
 	shutdownWorkers();
+	closeJobJournal();
+	closePeriodicTimer();
 	closeAllClients();
 	close(epollFd);
 	return 0;
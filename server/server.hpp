@@ -1,11 +1,17 @@
 #pragma once
 #include "epoll_handler.hpp"
 #include "client_handler.hpp"
+#include "timer_handler.hpp"
 #include "../worker/worker_manager.hpp"
+#include "../worker/job_journal.hpp"
+#include "../worker/downloader.hpp"
 #include "../commands/command_handler.hpp"
 #include "../network/upnp.hpp"
 #include <iostream>
 #include "../indexation/database.hpp"
+#include "../indexation/checkpoint.hpp"
+#include "../indexation/compaction.hpp"
+#include "../indexation/epoch.hpp"
 
 using namespace std;
 
@@ -0,0 +1,61 @@
+#include "timer_handler.hpp"
+#include "epoll_handler.hpp"
+#include <iostream>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+
+vector<void (*)()> periodicTasks;
+int timerFd = -1;
+
+int createPeriodicTimer(int epollFd, int intervalMs) {
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (timerFd < 0) {
+        cerr << "[ERROR] No se pudo crear el timer: " << strerror(errno) << "\n";
+        return -1;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = intervalMs / 1000;
+    spec.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(timerFd, 0, &spec, nullptr) < 0) {
+        cerr << "[ERROR] No se pudo armar el timer: " << strerror(errno) << "\n";
+        close(timerFd);
+        timerFd = -1;
+        return -1;
+    }
+
+    if (addToEpoll(epollFd, timerFd, handleTimerEvent, nullptr) < 0) {
+        close(timerFd);
+        timerFd = -1;
+        return -1;
+    }
+
+    return timerFd;
+}
+
+void registerPeriodicTask(void (*task)()) {
+    periodicTasks.push_back(task);
+}
+
+void handleTimerEvent(int fd, void* data) {
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return;
+    }
+
+    for (auto task : periodicTasks) {
+        task();
+    }
+}
+
+void closePeriodicTimer() {
+    if (timerFd >= 0) {
+        close(timerFd);
+        timerFd = -1;
+    }
+    periodicTasks.clear();
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+using namespace std;
+
+// Intervalo del tick periódico del servidor
+#define TIMER_INTERVAL_MS 1000
+
+// Funciones del timer (timerfd registrado en epoll)
+int createPeriodicTimer(int epollFd, int intervalMs = TIMER_INTERVAL_MS);
+void registerPeriodicTask(void (*task)());
+void closePeriodicTimer();
+
+// Handler para epoll
+void handleTimerEvent(int fd, void* data);
@@ -0,0 +1,65 @@
+// Pruebas de la reclamación por épocas: huecos de lectores que se reutilizan
+// al terminar cada hilo y memoria retenida mientras un lector sigue dentro.
+// Uso: make test
+#include "../indexation/epoch.hpp"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+
+static int failures = 0;
+static atomic<int> freed(0);
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        printf("[FALLO] %s\n", what);
+        failures++;
+    }
+}
+
+static void countFree(void* pointer) {
+    delete (int*)pointer;
+    freed++;
+}
+
+int main() {
+    // Más hilos que huecos, uno tras otro: cada uno devuelve el suyo
+    for (int i = 0; i < EPOCH_MAX_READERS * 2; i++) {
+        thread reader([] { EpochGuard guard; });
+        reader.join();
+    }
+
+    // Un lector dentro retiene lo retirado; al salir (y terminar) se libera
+    atomic<bool> inside(false);
+    atomic<bool> leave(false);
+    thread reader([&] {
+        EpochGuard guard;
+        inside = true;
+        while (!leave) {
+            this_thread::yield();
+        }
+    });
+    while (!inside) {
+        this_thread::yield();
+    }
+    retireMemory(new int(1), countFree);
+    for (int i = 0; i < 4; i++) {
+        reclaimRetiredMemory();
+    }
+    expect(freed == 0, "se liberó memoria con un lector dentro");
+
+    leave = true;
+    reader.join();
+    for (int i = 0; i < 4; i++) {
+        reclaimRetiredMemory();
+    }
+    expect(freed == 1 && retiredMemoryCount() == 0, "no se liberó tras salir el lector");
+
+    if (failures > 0) {
+        printf("[TEST] epoch: %d fallos\n", failures);
+        return 1;
+    }
+    printf("[TEST] epoch: OK\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Pruebas de la caché negativa (URL canónica, TTL y motivo devuelto a ADD) y
+// del circuit breaker (cerrado -> abierto -> semiabierto -> cerrado, DELAYED),
+// con un reloj falso.
+// Uso: make test
+#include "../commands/command_handler.hpp"
+#include "../worker/failure_guard.hpp"
+#include <cstdio>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+static int failures = 0;
+static uint64_t fakeNowMs = 1000000;
+
+static uint64_t fakeClock() {
+    return fakeNowMs;
+}
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        printf("[FALLO] %s\n", what);
+        failures++;
+    }
+}
+
+static void expectCanonical(const string& url, const string& expected) {
+    string got;
+    try {
+        got = canonicalizeURL(url);
+    } catch (const exception& e) {
+        got = string("<excepción: ") + e.what() + ">";
+    }
+    if (got != expected) {
+        printf("[FALLO] canonicalizeURL(\"%s\") = \"%s\", se esperaba \"%s\"\n",
+               url.c_str(), got.c_str(), expected.c_str());
+        failures++;
+    }
+}
+
+static void resetGuards() {
+    negativeCache.clear();
+    downloadBreaker = CircuitBreaker();
+    downloadQueue.clear();
+}
+
+// ADD por un socketpair: devuelve lo que recibe el cliente
+static string addResponse(const string& url) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        return "<sin socketpair>";
+    }
+    handleAddCommand(fds[0], url);
+
+    char buffer[256];
+    ssize_t got = recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+    detachClient(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+    return got > 0 ? string(buffer, got) : "";
+}
+
+static void testCanonicalURL() {
+    // youtu.be sin ID: no es un vídeo, se normaliza como cualquier otra
+    expectCanonical("https://youtu.be", "https://youtu.be");
+    expectCanonical("https://youtu.be?x", "https://youtu.be?x");
+    expectCanonical("https://youtu.be/", "https://youtu.be");
+
+    expectCanonical("https://youtu.be/abc123?t=10", "https://youtube.com/watch?v=abc123");
+    expectCanonical("https://m.youtube.com/watch?v=abc123&list=PL1", "https://youtube.com/watch?v=abc123");
+    expectCanonical("  https://www.YouTube.com/watch?feature=x&v=abc123#t  ",
+                    "https://youtube.com/watch?v=abc123");
+    expectCanonical("https://example.com/song/", "https://example.com/song");
+}
+
+// ===== CACHÉ NEGATIVA: entrada, caducidad y TTL exponencial =====
+static void testNegativeCache() {
+    resetGuards();
+    recordDownloadFailure("https://youtu.be/abc123", "private_video");
+
+    const NegativeEntry* entry = findRecentFailure("https://www.youtube.com/watch?v=abc123");
+    expect(entry != nullptr, "caché negativa: la URL canónica no encuentra el fallo");
+    expect(entry && entry->reason == "private_video", "caché negativa: se pierde el motivo");
+    expect(addResponse("https://youtube.com/watch?v=abc123") == "ERROR recent_failure private_video\n",
+           "caché negativa: ADD no devuelve el motivo del fallo");
+    expect(downloadQueue.empty(), "caché negativa: ADD encola una URL con fallo reciente");
+
+    fakeNowMs += NEGATIVE_TTL_MS - 1;
+    expect(findRecentFailure("https://youtu.be/abc123") != nullptr, "caché negativa: caduca antes del TTL");
+    fakeNowMs += 1;
+    expect(findRecentFailure("https://youtu.be/abc123") == nullptr, "caché negativa: no caduca con el TTL");
+    purgeNegativeCache();
+    expect(negativeCache.empty(), "caché negativa: purgeNegativeCache no quita lo caducado");
+
+    // Dos fallos seguidos: el segundo dobla el TTL
+    recordDownloadFailure("https://example.com/a", "timeout");
+    recordDownloadFailure("https://example.com/a", "timeout");
+    fakeNowMs += NEGATIVE_TTL_MS;
+    expect(findRecentFailure("https://example.com/a") != nullptr, "caché negativa: el TTL no crece");
+    fakeNowMs += NEGATIVE_TTL_MS;
+    expect(findRecentFailure("https://example.com/a") == nullptr, "caché negativa: el TTL crece de más");
+
+    // Muchos fallos: el TTL se queda en el tope
+    for (int i = 0; i < 30; i++) {
+        recordDownloadFailure("https://example.com/b", "timeout");
+    }
+    expect(negativeCache["https://example.com/b"].expiresMs == fakeNowMs + NEGATIVE_TTL_MAX_MS,
+           "caché negativa: el TTL pasa del tope");
+
+    recordDownloadSuccess("https://example.com/b");
+    expect(findRecentFailure("https://example.com/b") == nullptr, "caché negativa: un éxito no la limpia");
+}
+
+// ===== CIRCUIT BREAKER: cerrado -> abierto -> semiabierto -> cerrado =====
+static void testCircuitBreaker() {
+    resetGuards();
+
+    for (int i = 0; i < BREAKER_MIN_SAMPLES - 1; i++) {
+        recordDownloadFailure("https://example.com/" + to_string(i), "extractor");
+    }
+    expect(breakerAllowsDispatch(), "breaker: se abre sin las muestras mínimas");
+    recordDownloadFailure("https://example.com/last", "extractor");
+    expect(!breakerAllowsDispatch() && string(breakerStateName()) == "open",
+           "breaker: no se abre con todo fallos");
+
+    // Abierto: ADD avisa con DELAYED y la descarga espera en cola
+    expect(addResponse("https://example.com/new") == "DELAYED extractor_backoff\n",
+           "breaker: ADD no responde DELAYED");
+    expect(downloadQueue.size() == 1 && downloadQueue.front().url == "https://example.com/new",
+           "breaker: la descarga de un ADD DELAYED no queda en cola");
+    expect(downloadQueue.empty() || downloadQueue.front().clientFd == -1,
+           "breaker: la descarga en cola conserva el fd de un cliente desconectado");
+
+    // Pasada la espera: semiabierto, una sola descarga de prueba
+    fakeNowMs += BREAKER_COOLDOWN_MS - 1;
+    expect(!breakerAllowsDispatch(), "breaker: se semiabre antes de la espera");
+    fakeNowMs += 1;
+    expect(breakerAllowsDispatch() && string(breakerStateName()) == "half_open",
+           "breaker: no se semiabre tras la espera");
+    breakerOnDispatch();
+    expect(!breakerAllowsDispatch(), "breaker: semiabierto deja pasar más de una prueba");
+
+    // Prueba fallida: abierto otra vez con el doble de espera
+    recordDownloadFailure("https://example.com/probe", "extractor");
+    expect(string(breakerStateName()) == "open", "breaker: una prueba fallida no lo vuelve a abrir");
+    fakeNowMs += BREAKER_COOLDOWN_MS;
+    expect(!breakerAllowsDispatch(), "breaker: la espera no se dobla tras la prueba fallida");
+    fakeNowMs += BREAKER_COOLDOWN_MS;
+    expect(breakerAllowsDispatch(), "breaker: no se semiabre tras la espera doblada");
+
+    // Prueba buena: cerrado, con la espera y la ventana de nuevo a cero
+    breakerOnDispatch();
+    recordDownloadSuccess("https://example.com/probe");
+    expect(breakerAllowsDispatch() && string(breakerStateName()) == "closed",
+           "breaker: una prueba buena no lo cierra");
+    expect(downloadBreaker.cooldownMs == BREAKER_COOLDOWN_MS && downloadBreaker.recent.empty(),
+           "breaker: al cerrarse no reinicia la espera y la ventana");
+    expect(addResponse("https://example.com/other") == "", "breaker: ADD responde DELAYED cerrado");
+
+    // Por debajo de la proporción de fallos sigue cerrado
+    for (int i = 0; i < BREAKER_WINDOW; i++) {
+        if (i % 3 == 0) {
+            recordDownloadFailure("https://example.com/mixed", "extractor");
+        } else {
+            recordDownloadSuccess("https://example.com/mixed");
+        }
+    }
+    expect(string(breakerStateName()) == "closed", "breaker: se abre por debajo de la proporción");
+}
+
+int main() {
+    // Los handlers y el breaker escriben una línea por cada paso
+    cout.setstate(ios::badbit);
+    cerr.setstate(ios::badbit);
+    failureGuardClock = fakeClock;
+    globalDB = createDatabase();
+
+    testCanonicalURL();
+    testNegativeCache();
+    testCircuitBreaker();
+    resetGuards();
+    freeDatabase(globalDB);
+
+    if (failures > 0) {
+        printf("[TEST] failure_guard: %d fallos\n", failures);
+        return 1;
+    }
+    printf("[TEST] failure_guard: OK\n");
+    return 0;
+}
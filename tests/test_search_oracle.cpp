@@ -0,0 +1,391 @@
+// Oráculo de la búsqueda: cada consulta se compara con la fuerza bruta sobre
+// un modelo aparte (título y artista actuales de las canciones vivas), a lo
+// largo de altas, borrados, correcciones, guardado y recarga, compactación
+// (y guardado sin las filas compactadas), fusión de segmentos, reproducción
+// del WAL y checkpoint en segundo plano.
+// Las consultas son siempre las mismas en todas las fases: lo que la caché de
+// resultados no invalide sale como fallo en la fase siguiente.
+// Uso: make test
+#include "../indexation/database.hpp"
+#include "../indexation/checkpoint.hpp"
+#include "../indexation/compaction.hpp"
+#include "../indexation/inverted_index.hpp"
+#include "../indexation/query.hpp"
+#include "../server/epoll_handler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Con estas canciones las palabras más comunes pasan de 4 segmentos (hay
+// fusiones) y sus OR superan el mínimo de los mapas de bits
+#define ORACLE_SONGS 20000
+#define ORACLE_QUERIES 80
+#define ORACLE_PHRASE_QUERIES 60        // sin fuzzy: la fuerza bruta es barata
+#define ORACLE_VOCABULARY 600
+
+static int failures = 0;
+static mt19937 rng(2024);
+static vector<string> vocabulary;
+static char dbPath[64];
+
+// ===== MODELO: lo que la base tiene que devolver =====
+struct ModelSong {
+    bool alive;
+    string title;
+    string artist;
+    string url;
+    vector<char> words;     // extractWords del título y luego del artista (64 por palabra)
+    int titleWordCount;
+    int wordCount;
+};
+
+static vector<ModelSong> model;     // por id
+
+static void setModelText(ModelSong& song, const string& title, const string& artist) {
+    char words[SONG_MAX_WORDS][64];
+    int titleWordCount = 0;
+    int artistWordCount = 0;
+    extractWords(title.c_str(), words, &titleWordCount, SONG_MAX_WORDS / 2);
+    extractWords(artist.c_str(), words + titleWordCount, &artistWordCount, SONG_MAX_WORDS / 2);
+
+    song.title = title;
+    song.artist = artist;
+    song.titleWordCount = titleWordCount;
+    song.wordCount = titleWordCount + artistWordCount;
+    song.words.assign(&words[0][0], &words[0][0] + song.wordCount * 64);
+}
+
+// Zipf: unas pocas palabras salen en casi la mitad de las canciones
+static string zipfWord() {
+    double u = uniform_real_distribution<double>(0, 1)(rng);
+    int index = (int)pow((double)vocabulary.size(), u) - 1;
+    return vocabulary[max(index, 0)];
+}
+
+static string randomText(int minWords, int maxWords) {
+    string text;
+    int count = minWords + rng() % (maxWords - minWords + 1);
+    for (int i = 0; i < count; i++) {
+        text += (i ? " " : "") + zipfWord();
+    }
+    return text;
+}
+
+// ===== CAMBIOS: a la base y al modelo a la vez =====
+static void addSongs(SongDatabase* db, int count) {
+    for (int i = 0; i < count; i++) {
+        Song song;
+        memset(&song, 0, sizeof(song));
+        string title = randomText(2, 7);
+        string artist = randomText(1, 3);
+        snprintf(song.title, sizeof(song.title), "%s", title.c_str());
+        snprintf(song.artist, sizeof(song.artist), "%s", artist.c_str());
+        snprintf(song.url, sizeof(song.url), "https://youtube.com/watch?v=%08d", (int)model.size());
+        snprintf(song.filename, sizeof(song.filename), "songs/%d.mp3", (int)model.size());
+        song.duration = 180;
+        song.state = SONG_AVAILABLE;
+
+        int id = addSong(db, song);
+        if (id >= (int)model.size()) {
+            model.resize(id + 1);
+        }
+        model[id].alive = true;
+        model[id].url = song.url;
+        setModelText(model[id], title, artist);
+    }
+}
+
+static int randomAliveId() {
+    while (true) {
+        int id = rng() % model.size();
+        if (model[id].alive) return id;
+    }
+}
+
+// deletePercent: cuántos de cada 100 cambios son borrados (el resto correcciones)
+static void mutateSongs(SongDatabase* db, int count, int deletePercent = 25) {
+    for (int i = 0; i < count; i++) {
+        int id = randomAliveId();
+        int kind = (int)(rng() % 100) < deletePercent ? 0 : 1 + rng() % 3;
+        if (kind == 0) {
+            deleteSong(db, id);
+            model[id].alive = false;
+        } else {
+            // "" deja el campo como está
+            string title = kind == 2 ? "" : randomText(2, 5);
+            string artist = kind == 1 ? "" : randomText(1, 2);
+            updateSong(db, id, title.c_str(), artist.c_str());
+            setModelText(model[id], title.empty() ? model[id].title : title,
+                         artist.empty() ? model[id].artist : artist);
+        }
+    }
+}
+
+// ===== CONSULTAS =====
+static void wordsOf(const string& text, int* count, vector<string>& out) {
+    char words[SONG_MAX_WORDS][64];
+    extractWords(text.c_str(), words, count, SONG_MAX_WORDS / 2);
+    out.assign(words, words + *count);
+}
+
+// Frase sacada de una canción: en orden, al revés, con hueco o excluida. La
+// mitad lleva la palabra más común, la que acaba con segmentos fusionados
+static string randomPhrase() {
+    for (int tries = 0; tries < 100; tries++) {
+        const ModelSong& song = model[randomAliveId()];
+        vector<string> words;
+        int count = 0;
+        wordsOf(rng() % 2 ? song.title : song.artist, &count, words);
+        if (count < 2) continue;
+
+        int length = 2 + rng() % min(2, count - 1);
+        int start = rng() % (count - length + 1);
+        if (rng() % 2) {
+            int common = find(words.begin(), words.end(), vocabulary[0]) - words.begin();
+            if (common == count) continue;
+            start = max(0, min(common - (int)(rng() % length), count - length));
+        }
+        int variant = rng() % 6;
+        string phrase = "\"";
+        for (int k = 0; k < length; k++) {
+            int index = variant == 0 ? start + length - 1 - k : start + k;
+            phrase += (k ? " " : "") + words[index];
+        }
+        phrase += "\"";
+        if (variant == 1) phrase += "~" + to_string(rng() % 3);
+        if (variant == 2) phrase = "-" + phrase;
+        return phrase;
+    }
+    return "\"" + zipfWord() + " " + zipfWord() + "\"";
+}
+
+static string randomQuery() {
+    static const char* fields[] = {"", "title:", "artist:"};
+    string query;
+    int terms = 1 + rng() % 3;
+    for (int j = 0; j < terms; j++) {
+        // Un tercio de las veces una de las más comunes (listas largas)
+        string word = rng() % 3 == 0 ? vocabulary[rng() % 40] : zipfWord();
+        string field = fields[rng() % 3];
+        switch (rng() % 12) {
+        case 0: query += "NOT " + word; break;
+        case 1: query += "-" + word; break;
+        case 2: query += (j > 0 ? "OR " : "") + word; break;
+        case 3: query += "\"" + word + "\""; break;
+        case 4: query += word.substr(0, max<size_t>(2, word.size() - 2)); break;   // prefijo / fuzzy
+        case 7: query += field + word.substr(0, max<size_t>(3, word.size() - 1)); break;
+        case 8:
+        case 9: {
+            string phrase = randomPhrase();
+            if (phrase[0] == '-') phrase = phrase.substr(1);
+            query += (rng() % 4 == 0 ? "-" : "") + field + (rng() % 2 ? phrase : word);
+            break;
+        }
+        case 10:
+        case 11: query += randomPhrase(); break;
+        default: query += word; break;
+        }
+        query += " ";
+    }
+    return query;
+}
+
+static vector<int> bruteForce(const string& text) {
+    vector<int> ids;
+    Query query;
+    if (!parseQuery(text.c_str(), &query)) {
+        return ids;
+    }
+    for (size_t id = 0; id < model.size(); id++) {
+        ModelSong& song = model[id];
+        if (song.alive &&
+            queryMatchesWords(&query, (char(*)[64])song.words.data(), song.titleWordCount,
+                              song.wordCount)) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+static vector<int> search(SongDatabase* db, const string& query, int limit) {
+    SearchResult result = searchSongs(db, query.c_str(), limit);
+    vector<int> ids(result.songIds, result.songIds + result.count);
+    freeSearchResult(&result);
+    return ids;
+}
+
+// Todas (limit 0) contra la fuerza bruta; las k mejores (WAND) contra el
+// principio de todas; y otra vez, ya de la caché
+static void checkQueries(SongDatabase* db, const vector<string>& queries, const char* phase) {
+    int phaseFailures = 0;
+    for (const string& query : queries) {
+        vector<int> all = search(db, query, 0);
+        vector<int> sorted = all;
+        sort(sorted.begin(), sorted.end());
+        vector<int> expected = bruteForce(query);
+
+        bool ok = sorted == expected && search(db, query, 0) == all;
+        for (int k : {1, 5, 20}) {
+            vector<int> top = search(db, query, k);
+            ok = ok && top == vector<int>(all.begin(), all.begin() + min<size_t>(k, all.size()));
+        }
+        if (!ok) {
+            if (phaseFailures < 5) {
+                printf("[FALLO] %s: '%s' devuelve %zu, la fuerza bruta %zu\n", phase,
+                       query.c_str(), sorted.size(), expected.size());
+            }
+            phaseFailures++;
+        }
+    }
+    failures += phaseFailures;
+}
+
+// Cada canción del modelo por id y por URL, con sus textos actuales
+static void checkSongs(SongDatabase* db, const char* phase) {
+    int phaseFailures = 0;
+    for (size_t id = 1; id < model.size(); id++) {
+        SongView song;
+        bool found = getSongById(db, id, &song);
+        bool ok = found == model[id].alive;
+        if (ok && found) {
+            ok = model[id].title == song.title && model[id].artist == song.artist &&
+                 model[id].url == song.url;
+            SongView byURL;
+            ok = ok && getSongByURL(db, model[id].url.c_str(), &byURL) && byURL.id == id;
+        }
+        if (!ok) {
+            if (phaseFailures < 5) {
+                printf("[FALLO] %s: la canción %zu no coincide con el modelo\n", phase, id);
+            }
+            phaseFailures++;
+        }
+    }
+    failures += phaseFailures;
+}
+
+static SongDatabase* reload(SongDatabase* db) {
+    freeDatabase(db);
+    globalDB = loadDatabase(dbPath);
+    return globalDB;
+}
+
+static uint32_t savedSongCount() {
+    DatabaseHeader header;
+    FILE* file = fopen(dbPath, "rb");
+    size_t read = file ? fread(&header, sizeof(header), 1, file) : 0;
+    if (file) fclose(file);
+    return read == 1 ? header.numSongs : 0;
+}
+
+static void removeFiles() {
+    for (const char* suffix : {"", ".wal", ".wal.ckpt", ".tmp"}) {
+        unlink((string(dbPath) + suffix).c_str());
+    }
+}
+
+int main() {
+    // La base escribe una línea por canción
+    cout.setstate(ios::badbit);
+    snprintf(dbPath, sizeof(dbPath), "/tmp/test_search_oracle_%d.db", (int)getpid());
+    removeFiles();
+
+    for (int i = 0; i < ORACLE_VOCABULARY; i++) {
+        string word;
+        int length = 3 + rng() % 6;
+        for (int k = 0; k < length; k++) {
+            word += (char)('a' + rng() % 10);
+        }
+        vocabulary.push_back(word);
+    }
+
+    SongDatabase* db = globalDB = loadDatabase(dbPath);
+    addSongs(db, ORACLE_SONGS);
+
+    vector<string> queries;
+    for (int i = 0; i < ORACLE_QUERIES; i++) {
+        queries.push_back(randomQuery());
+    }
+    // Frases solas: todas sus candidatas se deciden con las posiciones
+    for (int i = 0; i < ORACLE_PHRASE_QUERIES; i++) {
+        queries.push_back(randomPhrase());
+    }
+    checkQueries(db, queries, "altas");
+    while (mergePendingSegments(db->invertedIndex, SEGMENT_MERGES_PER_TICK) > 0) {
+    }
+    // La fusión no cambia los resultados y no invalida la caché: sin esto no
+    // se leerían las listas fusionadas
+    bumpDatabaseGeneration(db);
+    checkQueries(db, queries, "fusión de segmentos");
+
+    // Borrados y correcciones: postings viejos que filtra la búsqueda
+    mutateSongs(db, ORACLE_SONGS / 20);
+    checkQueries(db, queries, "cambios");
+    // Solo borrados: cada uno tiene que invalidar la caché por sí mismo
+    mutateSongs(db, ORACLE_SONGS / 100, 100);
+    checkQueries(db, queries, "borrados");
+
+    // Guardar con las filas muertas sin compactar (sección DEAD) y recargar
+    saveDatabase(db, dbPath);
+    db = reload(db);
+    checkSongs(db, "recarga");
+    checkQueries(db, queries, "recarga");
+
+    while (!compactIndexStep(db, COMPACTION_WORDS_PER_TICK)) {
+    }
+    checkQueries(db, queries, "compactación");
+
+    // Ya compactadas, en el archivo solo quedan las filas vivas
+    saveDatabase(db, dbPath);
+    uint32_t savedSongs = savedSongCount();
+    uint32_t aliveSongs = count_if(model.begin(), model.end(),
+                                   [](const ModelSong& song) { return song.alive; });
+    if (savedSongs != aliveSongs) {
+        printf("[FALLO] Se guardan %u filas tras la compactación, vivas hay %u\n",
+               savedSongs, aliveSongs);
+        failures++;
+    }
+    db = reload(db);
+    checkSongs(db, "guardado compactado");
+    checkQueries(db, queries, "guardado compactado");
+
+    // Más altas sobre los índices cargados
+    addSongs(db, ORACLE_SONGS / 4);
+    mutateSongs(db, ORACLE_SONGS / 40);
+    checkQueries(db, queries, "altas tras recarga");
+
+    // Sin checkpoint: todo lo anterior a la recarga sale del WAL
+    db = reload(db);
+    checkSongs(db, "WAL");
+    checkQueries(db, queries, "WAL");
+
+    // Checkpoint en un hijo mientras siguen llegando cambios (WAL rotado)
+    initBackgroundCheckpoints(createEpoll());
+    if (!startBackgroundCheckpoint(db)) {
+        printf("[FALLO] No se pudo lanzar el checkpoint en segundo plano\n");
+        failures++;
+    }
+    addSongs(db, ORACLE_SONGS / 20);
+    mutateSongs(db, ORACLE_SONGS / 40);
+    waitBackgroundCheckpoint();
+    db = reload(db);
+    checkSongs(db, "checkpoint");
+    checkQueries(db, queries, "checkpoint");
+
+    freeDatabase(db);
+    removeFiles();
+
+    if (failures > 0) {
+        printf("[TEST] search_oracle: %d fallos\n", failures);
+        return 1;
+    }
+    printf("[TEST] search_oracle: OK\n");
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Pruebas del WAL: cola a medias, registro corrupto, escritura fallida y
+// rotación para los checkpoints (también con un .ckpt de uno que falló).
+// Uso: make test
+#include "../indexation/song_wal.hpp"
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+static char walPath[64];
+static vector<uint32_t> replayed;   // ids en el orden en que se reproducen
+
+static void collectRecord(void* owner, const WalRecordHeader& header,
+                          const char* texts[SONG_TEXT_FIELDS]) {
+    replayed.push_back(header.songId);
+}
+
+static void expect(bool ok, const char* what) {
+    if (!ok) {
+        printf("[FALLO] %s\n", what);
+        failures++;
+    }
+}
+
+static void appendSongs(SongWal* wal, uint32_t first, uint32_t last) {
+    string title(40, 't');
+    const char* texts[SONG_TEXT_FIELDS];
+    for (int field = 0; field < SONG_TEXT_FIELDS; field++) {
+        texts[field] = title.c_str();
+    }
+    for (uint32_t id = first; id <= last; id++) {
+        walAppendSong(wal, id, 180, 0, texts);
+    }
+}
+
+static vector<uint32_t> idRange(uint32_t first, uint32_t last) {
+    vector<uint32_t> ids;
+    for (uint32_t id = first; id <= last; id++) {
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+static vector<uint32_t> reopen() {
+    replayed.clear();
+    closeSongWal(openSongWal(walPath, collectRecord, nullptr));
+    return replayed;
+}
+
+static off_t fileSize(const string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+static void appendRaw(const string& path, const void* data, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    expect(fd >= 0 && write(fd, data, size) == (ssize_t)size, "no se pudo escribir a mano");
+    close(fd);
+}
+
+static void removeFiles() {
+    unlink(walPath);
+    unlink((string(walPath) + ".ckpt").c_str());
+}
+
+// ===== COLA A MEDIAS: se ignora y lo nuevo va detrás de lo válido =====
+static void testTornTail() {
+    removeFiles();
+    SongWal* wal = openSongWal(walPath, collectRecord, nullptr);
+    appendSongs(wal, 1, 5);
+    closeSongWal(wal);
+    off_t validBytes = fileSize(walPath);
+
+    WalRecordHeader torn;
+    memset(&torn, 0x5a, sizeof(torn));
+    appendRaw(walPath, &torn, sizeof(torn) / 2);
+
+    expect(reopen() == idRange(1, 5), "cola a medias: no se reproducen los 5 registros");
+    expect(fileSize(walPath) == validBytes, "cola a medias: no se recorta al abrir");
+
+    wal = openSongWal(walPath, collectRecord, nullptr);
+    appendSongs(wal, 6, 8);
+    closeSongWal(wal);
+    expect(reopen() == idRange(1, 8), "cola a medias: se pierden los registros de después");
+}
+
+// ===== REGISTRO CORRUPTO: se reproduce hasta él =====
+static void testCorruptRecord() {
+    removeFiles();
+    SongWal* wal = openSongWal(walPath, collectRecord, nullptr);
+    appendSongs(wal, 1, 4);
+    closeSongWal(wal);
+
+    off_t recordBytes = fileSize(walPath) / 4;
+    int fd = open(walPath, O_RDWR);
+    char byte = 0;
+    expect(pread(fd, &byte, 1, 2 * recordBytes + sizeof(WalRecordHeader)) == 1, "pread");
+    byte ^= 0x01;
+    expect(pwrite(fd, &byte, 1, 2 * recordBytes + sizeof(WalRecordHeader)) == 1, "pwrite");
+    close(fd);
+
+    expect(reopen() == idRange(1, 2), "registro corrupto: no se para en el tercero");
+}
+
+// ===== ESCRITURA FALLIDA: el archivo vuelve atrás y el buffer se reintenta =====
+static void testFailedFlush() {
+    removeFiles();
+    signal(SIGXFSZ, SIG_IGN);
+    SongWal* wal = openSongWal(walPath, collectRecord, nullptr);
+    appendSongs(wal, 1, 3);
+    expect(flushSongWal(wal), "no se pudo escribir el WAL");
+
+    // Límite de tamaño a mitad de los registros siguientes
+    struct rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    struct rlimit small = limit;
+    small.rlim_cur = wal->fileBytes + sizeof(WalRecordHeader);
+    setrlimit(RLIMIT_FSIZE, &small);
+
+    appendSongs(wal, 4, 6);
+    expect(!flushSongWal(wal), "escritura fallida: flushSongWal no lo detecta");
+    expect(!wal->buffer.empty(), "escritura fallida: se pierde el buffer");
+    expect(fileSize(walPath) == (off_t)wal->fileBytes, "escritura fallida: queda la escritura a medias");
+
+    setrlimit(RLIMIT_FSIZE, &limit);
+    expect(flushSongWal(wal), "escritura fallida: el reintento no escribe");
+    closeSongWal(wal);
+    expect(reopen() == idRange(1, 6), "escritura fallida: faltan registros al reproducir");
+}
+
+// ===== ROTACIÓN: el .ckpt se reproduce antes que el WAL =====
+static void testRotation() {
+    removeFiles();
+    string ckptPath = string(walPath) + ".ckpt";
+    SongWal* wal = openSongWal(walPath, collectRecord, nullptr);
+    appendSongs(wal, 1, 3);
+    expect(rotateSongWal(wal), "rotación: no se pudo rotar");
+    expect(fileSize(walPath) == 0 && fileSize(ckptPath) > 0, "rotación: el WAL no pasa al .ckpt");
+
+    // Checkpoint fallido: el .ckpt se queda y el siguiente le añade el WAL
+    appendSongs(wal, 4, 5);
+    expect(rotateSongWal(wal), "rotación: no se pudo rotar con un .ckpt");
+    expect(fileSize(walPath) == 0, "rotación: el WAL no se vacía al pasarlo al .ckpt");
+    appendSongs(wal, 6, 7);
+    closeSongWal(wal);
+    expect(reopen() == idRange(1, 7), "rotación: el orden al reproducir no es .ckpt y WAL");
+
+    // Un .ckpt con la cola a medias (corte mientras se le añadía el WAL)
+    WalRecordHeader torn;
+    memset(&torn, 0x5a, sizeof(torn));
+    appendRaw(ckptPath, &torn, sizeof(torn) / 2);
+    replayed.clear();
+    wal = openSongWal(walPath, collectRecord, nullptr);
+    expect(replayed == idRange(1, 7), "rotación: la cola del .ckpt tapa el WAL");
+    expect(rotateSongWal(wal), "rotación: no se pudo rotar tras la cola a medias");
+    appendSongs(wal, 8, 8);
+    closeSongWal(wal);
+    expect(reopen() == idRange(1, 8), "rotación: lo añadido tras la cola del .ckpt se pierde");
+
+    // Checkpoint terminado: el .ckpt se borra
+    wal = openSongWal(walPath, collectRecord, nullptr);
+    finishSongWalCheckpoint(wal);
+    closeSongWal(wal);
+    expect(fileSize(ckptPath) < 0, "rotación: el .ckpt sigue tras el checkpoint");
+}
+
+int main() {
+    snprintf(walPath, sizeof(walPath), "/tmp/test_song_wal_%d.wal", (int)getpid());
+
+    testTornTail();
+    testCorruptRecord();
+    testFailedFlush();
+    testRotation();
+    removeFiles();
+
+    if (failures > 0) {
+        printf("[TEST] song_wal: %d fallos\n", failures);
+        return 1;
+    }
+    printf("[TEST] song_wal: OK\n");
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include "downloader.hpp"
+#include <cmath>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// ===== EJECUTAR YT-DLP Y PROCESAR SU SALIDA LÍNEA A LÍNEA =====
+// Devuelve el código de salida de yt-dlp (-1 si no se pudo lanzar)
+static int runYtDlp(const char *const argv[], WorkerJobContext &ctx, void (*onLine)(char *, WorkerJobContext &)) {
+	int pipeOutput[2];
+	if (pipe(pipeOutput) < 0) {
+		cerr << "[Worker " << ctx.worker_id << "] Error creando pipe" << endl;
+		return -1;
+	}
+
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		// stdout y stderr al mismo pipe: con --print yt-dlp manda el progreso a stderr
+		close(pipeOutput[0]);
+		dup2(pipeOutput[1], STDOUT_FILENO);
+		dup2(pipeOutput[1], STDERR_FILENO);
+		close(pipeOutput[1]);
+
+		execv("/usr/bin/yt-dlp", (char *const *)argv);
+
+		// Si execv falla
+		cerr << "[Worker " << ctx.worker_id << "] Error ejecutando yt-dlp: "
+			 << strerror(errno) << endl;
+		exit(1);
+	}
+
+	close(pipeOutput[1]);
+	if (pid < 0) {
+		cerr << "[Worker " << ctx.worker_id << "] Error en fork" << endl;
+		close(pipeOutput[0]);
+		return -1;
+	}
+
+	char lineBuffer[4096];
+	size_t lineUsed = 0;
+	bool pipeOpen = true;
+
+	while (pipeOpen) {
+		ssize_t bytesRead = read(pipeOutput[0], lineBuffer + lineUsed, sizeof(lineBuffer) - 1 - lineUsed);
+		if (bytesRead < 0) {
+			if (errno == EINTR) continue;
+			cerr << "error" << strerror(errno) << endl;
+			break;
+		}
+		if (bytesRead == 0) {
+			pipeOpen = false;
+			if (lineUsed == 0) break;
+			lineBuffer[lineUsed++] = '\n';	// procesar la última línea incompleta
+		} else {
+			lineUsed += bytesRead;
+		}
+
+		char *lineStart = lineBuffer;
+		char *newline;
+		while ((newline = (char *)memchr(lineStart, '\n', lineBuffer + lineUsed - lineStart)) != nullptr) {
+			*newline = '\0';
+			if (newline > lineStart && newline[-1] == '\r') newline[-1] = '\0';
+			onLine(lineStart, ctx);
+			lineStart = newline + 1;
+		}
+
+		// Compactar lo que quede de una línea incompleta
+		lineUsed = lineBuffer + lineUsed - lineStart;
+		memmove(lineBuffer, lineStart, lineUsed);
+		if (lineUsed >= sizeof(lineBuffer) - 1) {
+			lineUsed = 0;	// línea absurdamente larga: descartarla
+		}
+	}
+	close(pipeOutput[0]);
+
+	int status;
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// ===== BACKEND YT-DLP =====
+static int ytDlpProbe(WorkerJobContext &ctx) {
+	// --print sin momento implica --simulate: solo extrae la información
+	const char *argv[] = {
+		"yt-dlp",
+		"--print", "META:%(title)s\nMETA:%(artist,uploader)s\nMETA:%(duration)s",
+		"--no-warnings",
+		"--extractor-args", "youtube:player_client=android",
+		ctx.url.c_str(),
+		nullptr};
+	return runYtDlp(argv, ctx, handleDownloadLine);
+}
+
+static int ytDlpDownload(WorkerJobContext &ctx) {
+	string output = "songs/" + sanitizeFilename(ctx.title) + ".%(ext)s";
+	const char *argv[] = {
+		"yt-dlp",
+		"--quiet",
+		"--progress", "--newline",
+		"--progress-template",
+		"download:PROGRESS:%(progress.downloaded_bytes)s:%(progress.total_bytes,progress.total_bytes_estimate)s"
+		":%(progress.speed)s:%(progress.eta)s",
+		"-x", "--audio-format", "mp3",
+		"--no-warnings",
+		"--extractor-args", "youtube:player_client=android",
+		"-o", output.c_str(),
+		ctx.url.c_str(),
+		nullptr};
+	return runYtDlp(argv, ctx, handleDownloadLine);
+}
+
+static int ytDlpExpand(WorkerJobContext &ctx) {
+	const char *argv[] = {
+		"yt-dlp",
+		"--flat-playlist",
+		"--print", "ITEM:%(url)s",
+		"--no-warnings",
+		ctx.url.c_str(),
+		nullptr};
+	return runYtDlp(argv, ctx, handleExpandLine);
+}
+
+Downloader ytDlpDownloader = {"yt-dlp", ytDlpProbe, ytDlpDownload, ytDlpExpand};
+
+// ===== BACKEND FALSO =====
+FakeDownloaderConfig fakeDownloaderConfig;
+
+// splitmix64: mismo resultado para la misma (semilla, URL, fase)
+static uint64_t fakeRandom(uint64_t &state) {
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static uint64_t fakeSeed(const WorkerJobContext &ctx, uint64_t phase) {
+	uint64_t hash = 14695981039346656037ull ^ fakeDownloaderConfig.seed ^ (phase << 56);
+	for (unsigned char c : ctx.url) {
+		hash = (hash ^ c) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static double fakeUnit(uint64_t &state) {
+	return (fakeRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void fakeSleep(int meanMs, uint64_t &state) {
+	double ms = meanMs;
+	if (fakeDownloaderConfig.latencyDistribution == LATENCY_UNIFORM) {
+		ms = 2.0 * meanMs * fakeUnit(state);
+	} else if (fakeDownloaderConfig.latencyDistribution == LATENCY_EXPONENTIAL) {
+		ms = -meanMs * log(1.0 - fakeUnit(state));
+	}
+	if (ms > 0) usleep((useconds_t)(ms * 1000));
+}
+
+static bool fakeFails(uint64_t &state, WorkerJobContext &ctx) {
+	if (fakeUnit(state) >= fakeDownloaderConfig.failureRate) return false;
+	char line[] = "ERROR: [fake] simulated extractor failure";
+	handleDownloadLine(line, ctx);
+	return true;
+}
+
+static int fakeProbe(WorkerJobContext &ctx) {
+	uint64_t state = fakeSeed(ctx, 1);
+	fakeSleep(fakeDownloaderConfig.probeLatencyMs, state);
+	if (fakeFails(state, ctx)) return 1;
+
+	static const char *artists[] = {"Fake Queen", "The Synthetics", "Loopback Trio", "Null Ensemble"};
+	char line[256];
+	snprintf(line, sizeof(line), "META:Fake Song %016llx", (unsigned long long)fakeRandom(state));
+	handleDownloadLine(line, ctx);
+	snprintf(line, sizeof(line), "META:%s", artists[fakeRandom(state) % 4]);
+	handleDownloadLine(line, ctx);
+	snprintf(line, sizeof(line), "META:%d", (int)(120 + fakeRandom(state) % 240));
+	handleDownloadLine(line, ctx);
+	return 0;
+}
+
+// MP3 sintético: cabecera ID3v2 vacía + tramas MPEG-1 Layer III de silencio
+// (128 kbps, 44.1 kHz => 417 bytes por trama)
+static int fakeDownload(WorkerJobContext &ctx) {
+	uint64_t state = fakeSeed(ctx, 2);
+	fakeSleep(fakeDownloaderConfig.downloadLatencyMs, state);
+	if (fakeFails(state, ctx)) return 1;
+
+	mkdir("songs", 0755);
+	string path = "songs/" + sanitizeFilename(ctx.title) + ".mp3";
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		ctx.lastError = "cannot create " + path;
+		return 1;
+	}
+
+	const uint64_t total = fakeDownloaderConfig.fileBytes;
+	const uint64_t rate = fakeDownloaderConfig.bytesPerSecond ? fakeDownloaderConfig.bytesPerSecond : total;
+	const size_t frameBytes = 417;
+	char frame[frameBytes] = {(char)0xFF, (char)0xFB, (char)0x90, (char)0x00};
+	const char id3[10] = {'I', 'D', '3', 3, 0, 0, 0, 0, 0, 0};
+
+	uint64_t written = write(fd, id3, sizeof(id3)) == (ssize_t)sizeof(id3) ? sizeof(id3) : 0;
+	uint64_t startMs = monotonicMs();
+
+	// Bloques de ~64 KiB al ritmo configurado, con una línea de progreso por bloque
+	while (written < total) {
+		uint64_t chunkEnd = min(total, written + 64 * 1024);
+		while (written < chunkEnd) {
+			size_t len = (size_t)min<uint64_t>(frameBytes, total - written);
+			if (write(fd, frame, len) != (ssize_t)len) {
+				close(fd);
+				ctx.lastError = "short write on " + path;
+				return 1;
+			}
+			written += len;
+		}
+
+		uint64_t dueMs = startMs + written * 1000 / rate;
+		uint64_t now = monotonicMs();
+		if (dueMs > now) usleep((dueMs - now) * 1000);
+
+		char line[128];
+		uint64_t elapsedMs = max<uint64_t>(1, monotonicMs() - startMs);
+		snprintf(line, sizeof(line), "PROGRESS:%llu:%llu:%llu:%llu", (unsigned long long)written,
+				 (unsigned long long)total, (unsigned long long)(written * 1000 / elapsedMs),
+				 (unsigned long long)((total - written) / rate));
+		handleDownloadLine(line, ctx);
+	}
+
+	close(fd);
+	return 0;
+}
+
+static int fakeExpand(WorkerJobContext &ctx) {
+	uint64_t state = fakeSeed(ctx, 3);
+	fakeSleep(fakeDownloaderConfig.probeLatencyMs, state);
+
+	char line[600];
+	for (int i = 0; i < fakeDownloaderConfig.playlistSize; i++) {
+		snprintf(line, sizeof(line), "ITEM:fake://%.400s/%d", ctx.url.c_str(), i);
+		handleExpandLine(line, ctx);
+	}
+	return 0;
+}
+
+Downloader fakeDownloader = {"fake", fakeProbe, fakeDownload, fakeExpand};
+
+Downloader *activeDownloader = &ytDlpDownloader;
+
+bool selectDownloader(const char *name) {
+	if (!name) name = getenv("MUSIC_DOWNLOADER");
+	if (!name || strcmp(name, "yt-dlp") == 0) {
+		activeDownloader = &ytDlpDownloader;
+	} else if (strcmp(name, "fake") == 0) {
+		activeDownloader = &fakeDownloader;
+	} else {
+		cerr << "[ERROR] Backend de descarga desconocido: " << name << endl;
+		return false;
+	}
+
+	cout << "[Server] Backend de descarga: " << activeDownloader->name << endl;
+	return true;
+}
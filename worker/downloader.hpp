@@ -0,0 +1,39 @@
+#pragma once
+
+#include "worker.hpp"
+
+using namespace std;
+
+// ===== BACKEND DE DESCARGA =====
+// Cada fase devuelve un código de salida (0 = OK) y entrega su salida línea a
+// línea a handleDownloadLine / handleExpandLine, igual que haría yt-dlp.
+struct Downloader {
+    const char* name;
+    int (*probe)(WorkerJobContext& ctx);      // metadatos (META:)
+    int (*download)(WorkerJobContext& ctx);   // audio + progreso (PROGRESS:)
+    int (*expand)(WorkerJobContext& ctx);     // entradas de una playlist (ITEM:)
+};
+
+// ===== BACKEND FALSO (determinista, sin red) =====
+#define LATENCY_FIXED       0
+#define LATENCY_UNIFORM     1   // [0, 2 * media]
+#define LATENCY_EXPONENTIAL 2   // cola larga, como un extractor real
+
+struct FakeDownloaderConfig {
+    uint64_t seed = 1;
+    int latencyDistribution = LATENCY_EXPONENTIAL;
+    int probeLatencyMs = 200;           // media por sondeo
+    int downloadLatencyMs = 500;        // media antes del primer byte
+    uint64_t fileBytes = 4 * 1024 * 1024;
+    uint64_t bytesPerSecond = 8 * 1024 * 1024;
+    double failureRate = 0.0;
+    int playlistSize = 50;
+};
+
+extern Downloader ytDlpDownloader;
+extern Downloader fakeDownloader;
+extern Downloader* activeDownloader;
+extern FakeDownloaderConfig fakeDownloaderConfig;
+
+// "yt-dlp" (por defecto) o "fake"; nullptr => variable MUSIC_DOWNLOADER
+bool selectDownloader(const char* name = nullptr);
@@ -0,0 +1,170 @@
+#include "failure_guard.hpp"
+#include "worker.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+using namespace std;
+
+unordered_map<string, NegativeEntry> negativeCache;
+CircuitBreaker downloadBreaker;
+uint64_t (*failureGuardClock)() = monotonicMs;
+
+// ===== URL CANÓNICA (clave de la caché negativa) =====
+// youtu.be/ID, m.youtube.com/watch?v=ID&list=... => youtube.com/watch?v=ID
+string canonicalizeURL(const string &rawUrl) {
+	string url = rawUrl;
+	url.erase(0, url.find_first_not_of(" \t\r\n"));
+	url.erase(url.find_last_not_of(" \t\r\n") + 1);
+
+	size_t fragment = url.find('#');
+	if (fragment != string::npos) url.erase(fragment);
+
+	size_t schemeEnd = url.find("://");
+	size_t hostStart = schemeEnd == string::npos ? 0 : schemeEnd + 3;
+	size_t hostEnd = url.find_first_of("/?", hostStart);
+	if (hostEnd == string::npos) hostEnd = url.size();
+
+	string host = url.substr(hostStart, hostEnd - hostStart);
+	string rest = url.substr(hostEnd);
+	transform(host.begin(), host.end(), host.begin(), [](unsigned char c) { return tolower(c); });
+
+	for (const char *prefix : {"www.", "m.", "music."}) {
+		if (host.compare(0, strlen(prefix), prefix) == 0) {
+			host.erase(0, strlen(prefix));
+			break;
+		}
+	}
+
+	// ===== YOUTUBE: quedarse solo con el ID del vídeo =====
+	string videoId;
+	if (host == "youtu.be") {
+		// Sin /ID detrás del host no hay vídeo: se normaliza como cualquier otra
+		if (rest.size() > 1 && rest[0] == '/') {
+			size_t idEnd = rest.find_first_of("/?", 1);
+			videoId = rest.substr(1, idEnd == string::npos ? string::npos : idEnd - 1);
+		}
+	} else if (host == "youtube.com" && rest.compare(0, 7, "/watch?") == 0) {
+		size_t v = rest.find("v=");
+		while (v != string::npos && rest[v - 1] != '?' && rest[v - 1] != '&') {
+			v = rest.find("v=", v + 2);
+		}
+		if (v != string::npos) {
+			videoId = rest.substr(v + 2, rest.find('&', v) == string::npos ? string::npos : rest.find('&', v) - v - 2);
+		}
+	}
+	if (!videoId.empty()) {
+		return "https://youtube.com/watch?v=" + videoId;
+	}
+
+	while (rest.size() > 1 && rest.back() == '/') rest.pop_back();
+	if (rest == "/") rest.clear();
+	return "https://" + host + rest;
+}
+
+// ===== VENTANA DESLIZANTE DEL CIRCUIT BREAKER =====
+static void breakerRecord(bool failed) {
+	CircuitBreaker &breaker = downloadBreaker;
+	uint64_t now = failureGuardClock();
+
+	if (breaker.state == BREAKER_HALF_OPEN) {
+		breaker.probeInFlight = false;
+		if (failed) {
+			// La prueba falló: volver a abrir con más espera
+			breaker.cooldownMs = min<uint64_t>(breaker.cooldownMs * 2, BREAKER_COOLDOWN_MAX_MS);
+			breaker.state = BREAKER_OPEN;
+			breaker.openUntilMs = now + breaker.cooldownMs;
+			cerr << "[BREAKER] Prueba fallida, abierto otros " << breaker.cooldownMs / 1000 << "s" << endl;
+		} else {
+			breaker.state = BREAKER_CLOSED;
+			breaker.cooldownMs = BREAKER_COOLDOWN_MS;
+			breaker.recent.clear();
+			breaker.recentFailures = 0;
+			cout << "[BREAKER] Cerrado, las descargas vuelven a funcionar" << endl;
+		}
+		return;
+	}
+
+	breaker.recent.push_back(failed);
+	breaker.recentFailures += failed;
+	if ((int)breaker.recent.size() > BREAKER_WINDOW) {
+		breaker.recentFailures -= breaker.recent.front();
+		breaker.recent.pop_front();
+	}
+
+	if (breaker.state == BREAKER_CLOSED && (int)breaker.recent.size() >= BREAKER_MIN_SAMPLES &&
+		breaker.recentFailures >= BREAKER_FAILURE_RATIO * breaker.recent.size()) {
+		breaker.state = BREAKER_OPEN;
+		breaker.openUntilMs = now + breaker.cooldownMs;
+		cerr << "[BREAKER] Abierto: " << breaker.recentFailures << "/" << breaker.recent.size()
+			 << " descargas fallidas, pausa de " << breaker.cooldownMs / 1000 << "s" << endl;
+	}
+}
+
+const NegativeEntry *findRecentFailure(const string &url) {
+	auto it = negativeCache.find(canonicalizeURL(url));
+	if (it == negativeCache.end() || it->second.expiresMs <= failureGuardClock()) {
+		return nullptr;
+	}
+	return &it->second;
+}
+
+void recordDownloadFailure(const string &url, const string &reason) {
+	NegativeEntry &entry = negativeCache[canonicalizeURL(url)];
+	entry.failures++;
+	entry.reason = reason.empty() ? "unknown" : reason;
+
+	// TTL exponencial: una URL que falla una y otra vez se bloquea más tiempo
+	uint64_t ttl = NEGATIVE_TTL_MS;
+	for (int i = 1; i < entry.failures && ttl < NEGATIVE_TTL_MAX_MS; i++) ttl *= 2;
+	entry.expiresMs = failureGuardClock() + min<uint64_t>(ttl, NEGATIVE_TTL_MAX_MS);
+
+	breakerRecord(true);
+}
+
+void recordDownloadSuccess(const string &url) {
+	negativeCache.erase(canonicalizeURL(url));
+	breakerRecord(false);
+}
+
+void purgeNegativeCache() {
+	uint64_t now = failureGuardClock();
+	for (auto it = negativeCache.begin(); it != negativeCache.end();) {
+		if (it->second.expiresMs <= now) {
+			it = negativeCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+// ===== ¿SE PUEDE DESPACHAR UN TRABAJO NUEVO? =====
+bool breakerAllowsDispatch() {
+	CircuitBreaker &breaker = downloadBreaker;
+
+	if (breaker.state == BREAKER_OPEN && failureGuardClock() >= breaker.openUntilMs) {
+		breaker.state = BREAKER_HALF_OPEN;
+		breaker.probeInFlight = false;
+		cout << "[BREAKER] Semiabierto, probando con una descarga" << endl;
+	}
+
+	if (breaker.state == BREAKER_CLOSED) return true;
+	if (breaker.state == BREAKER_HALF_OPEN) return !breaker.probeInFlight;
+	return false;
+}
+
+void breakerOnDispatch() {
+	if (downloadBreaker.state == BREAKER_HALF_OPEN) {
+		downloadBreaker.probeInFlight = true;
+	}
+}
+
+const char *breakerStateName() {
+	switch (downloadBreaker.state) {
+	case BREAKER_OPEN:
+		return "open";
+	case BREAKER_HALF_OPEN:
+		return "half_open";
+	}
+	return "closed";
+}
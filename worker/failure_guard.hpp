@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+using namespace std;
+
+// ===== CACHÉ NEGATIVA DE URLS FALLIDAS =====
+#define NEGATIVE_TTL_MS      (10 * 60 * 1000)        // primer fallo: 10 min
+#define NEGATIVE_TTL_MAX_MS  (24 * 60 * 60 * 1000)   // tope tras fallos repetidos
+
+struct NegativeEntry {
+    uint64_t expiresMs;
+    int failures;
+    string reason;
+};
+
+// ===== CIRCUIT BREAKER =====
+#define BREAKER_CLOSED    0     // todo normal
+#define BREAKER_OPEN      1     // no se despachan trabajos nuevos
+#define BREAKER_HALF_OPEN 2     // se deja pasar un trabajo de prueba
+
+#define BREAKER_WINDOW           20      // últimos resultados considerados
+#define BREAKER_MIN_SAMPLES      10
+#define BREAKER_FAILURE_RATIO    0.5
+#define BREAKER_COOLDOWN_MS      (60 * 1000)
+#define BREAKER_COOLDOWN_MAX_MS  (15 * 60 * 1000)
+
+struct CircuitBreaker {
+    int state = BREAKER_CLOSED;
+    deque<bool> recent;         // true = fallo
+    int recentFailures = 0;
+    uint64_t openUntilMs = 0;
+    uint64_t cooldownMs = BREAKER_COOLDOWN_MS;
+    bool probeInFlight = false;
+};
+
+extern unordered_map<string, NegativeEntry> negativeCache;
+extern CircuitBreaker downloadBreaker;
+// Reloj de la caché y del breaker (monotonicMs; las pruebas ponen uno falso)
+extern uint64_t (*failureGuardClock)();
+
+// Funciones
+string canonicalizeURL(const string& url);
+
+const NegativeEntry* findRecentFailure(const string& url);
+void recordDownloadFailure(const string& url, const string& reason);
+void recordDownloadSuccess(const string& url);
+void purgeNegativeCache();
+
+bool breakerAllowsDispatch();
+void breakerOnDispatch();
+const char* breakerStateName();
@@ -0,0 +1,188 @@
+#include "job_journal.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+int journalFd = -1;
+string journalBuffer;           // registros pendientes de escribir (group commit)
+map<uint32_t, DownloadRequest> journalLiveJobs;
+
+// ===== CHECKSUM FNV-1a =====
+static uint32_t journalChecksum(const JournalRecordHeader &header, const char *url) {
+	JournalRecordHeader copy = header;
+	copy.checksum = 0;
+
+	uint32_t hash = 2166136261u;
+	const unsigned char *bytes = (const unsigned char *)&copy;
+	for (size_t i = 0; i < sizeof(copy); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	for (uint16_t i = 0; i < header.urlLength; i++) {
+		hash = (hash ^ (unsigned char)url[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static void appendRecord(string &out, uint8_t kind, const DownloadRequest &req, bool withUrl) {
+	JournalRecordHeader header;
+	header.kind = kind;
+	header.jobType = (uint8_t)req.type;
+	header.jobId = req.jobId;
+	header.urlLength = withUrl ? (uint16_t)min(req.url.size(), (size_t)UINT16_MAX) : 0;
+	header.checksum = journalChecksum(header, req.url.c_str());
+
+	out.append((const char *)&header, sizeof(header));
+	out.append(req.url.c_str(), header.urlLength);
+}
+
+static bool writeAll(int fd, const char *data, size_t size) {
+	size_t total = 0;
+	while (total < size) {
+		ssize_t written = write(fd, data + total, size - total);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		total += written;
+	}
+	return true;
+}
+
+// ===== REPRODUCIR EL JOURNAL: ENQUEUE sin FINISH => pendiente =====
+static void replayJournal(const char *filepath) {
+	int fd = open(filepath, O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+
+	struct stat st;
+	fstat(fd, &st);
+	string data(st.st_size, '\0');
+	ssize_t bytesRead = read(fd, &data[0], st.st_size);
+	close(fd);
+	if (bytesRead != st.st_size) {
+		cerr << "[JOURNAL] No se pudo leer el journal" << endl;
+		return;
+	}
+
+	size_t pos = 0;
+	int records = 0;
+	while (pos + sizeof(JournalRecordHeader) <= data.size()) {
+		JournalRecordHeader header;
+		memcpy(&header, data.data() + pos, sizeof(header));
+		const char *url = data.data() + pos + sizeof(header);
+
+		// Un registro truncado o corrupto marca el final válido (escritura a medias)
+		if (pos + sizeof(header) + header.urlLength > data.size() ||
+			journalChecksum(header, url) != header.checksum) {
+			cerr << "[JOURNAL] Registro inválido en offset " << pos << ", se ignora el resto" << endl;
+			break;
+		}
+		pos += sizeof(header) + header.urlLength;
+		records++;
+
+		if (header.kind == JOURNAL_ENQUEUE) {
+			DownloadRequest req;
+			req.url = string(url, header.urlLength);
+			req.clientFd = -1;
+			req.type = header.jobType;
+			req.jobId = header.jobId;
+			journalLiveJobs[req.jobId] = req;
+		} else if (header.kind == JOURNAL_FINISH) {
+			journalLiveJobs.erase(header.jobId);
+		}
+	}
+
+	cout << "[JOURNAL] " << records << " registros reproducidos, "
+		 << journalLiveJobs.size() << " trabajos pendientes" << endl;
+}
+
+bool openJobJournal(const char *filepath, vector<DownloadRequest> &pending) {
+	journalLiveJobs.clear();
+	replayJournal(filepath);
+
+	// ===== COMPACTAR: reescribir solo los trabajos vivos =====
+	string compacted;
+	for (auto &pair : journalLiveJobs) {
+		appendRecord(compacted, JOURNAL_ENQUEUE, pair.second, true);
+		pending.push_back(pair.second);	// map ordenado => orden de llegada
+	}
+
+	string tmpPath = string(filepath) + ".tmp";
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || !writeAll(fd, compacted.data(), compacted.size()) || fdatasync(fd) < 0) {
+		cerr << "[JOURNAL] No se pudo compactar el journal: " << strerror(errno) << endl;
+		if (fd >= 0) close(fd);
+		return false;
+	}
+	close(fd);
+
+	if (rename(tmpPath.c_str(), filepath) < 0) {
+		cerr << "[JOURNAL] No se pudo reemplazar el journal: " << strerror(errno) << endl;
+		return false;
+	}
+
+	journalFd = open(filepath, O_WRONLY | O_APPEND);
+	if (journalFd < 0) {
+		cerr << "[JOURNAL] No se pudo abrir el journal: " << strerror(errno) << endl;
+		return false;
+	}
+
+	return true;
+}
+
+void journalEnqueue(const DownloadRequest &req) {
+	if (journalFd < 0) return;
+	journalLiveJobs[req.jobId] = req;
+	appendRecord(journalBuffer, JOURNAL_ENQUEUE, req, true);
+	if (journalBuffer.size() >= JOURNAL_FLUSH_BYTES) flushJobJournal();
+}
+
+void journalStart(uint32_t jobId) {
+	if (journalFd < 0) return;
+	DownloadRequest req;
+	req.jobId = jobId;
+	appendRecord(journalBuffer, JOURNAL_START, req, false);
+	if (journalBuffer.size() >= JOURNAL_FLUSH_BYTES) flushJobJournal();
+}
+
+void journalFinish(uint32_t jobId) {
+	if (journalFd < 0) return;
+	journalLiveJobs.erase(jobId);
+	DownloadRequest req;
+	req.jobId = jobId;
+	appendRecord(journalBuffer, JOURNAL_FINISH, req, false);
+	if (journalBuffer.size() >= JOURNAL_FLUSH_BYTES) flushJobJournal();
+}
+
+// ===== GROUP COMMIT: un write + fdatasync para todo lo acumulado =====
+void flushJobJournal() {
+	if (journalFd < 0 || journalBuffer.empty()) return;
+
+	if (!writeAll(journalFd, journalBuffer.data(), journalBuffer.size())) {
+		cerr << "[JOURNAL] Error escribiendo el journal: " << strerror(errno) << endl;
+		return;
+	}
+	fdatasync(journalFd);
+	journalBuffer.clear();
+
+	// Sin trabajos vivos el contenido ya no aporta nada
+	if (journalLiveJobs.empty()) {
+		struct stat st;
+		if (fstat(journalFd, &st) == 0 && st.st_size > JOURNAL_TRUNCATE_BYTES) {
+			ftruncate(journalFd, 0);
+			fdatasync(journalFd);
+		}
+	}
+}
+
+void closeJobJournal() {
+	flushJobJournal();
+	if (journalFd >= 0) {
+		close(journalFd);
+		journalFd = -1;
+	}
+}
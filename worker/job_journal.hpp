@@ -0,0 +1,35 @@
+#pragma once
+
+#include "worker.hpp"
+#include <vector>
+
+using namespace std;
+
+// Tipos de registro del journal de trabajos
+#define JOURNAL_ENQUEUE 1
+#define JOURNAL_START   2
+#define JOURNAL_FINISH  3
+
+// Se fuerza escritura + fdatasync al superar este tamaño de buffer
+#define JOURNAL_FLUSH_BYTES (64 * 1024)
+// Sin trabajos vivos, el journal se trunca al superar este tamaño
+#define JOURNAL_TRUNCATE_BYTES (1024 * 1024)
+
+// Registro en disco (seguido de urlLength bytes de URL en JOURNAL_ENQUEUE)
+#pragma pack(1)
+struct JournalRecordHeader {
+    uint8_t kind;
+    uint8_t jobType;
+    uint32_t jobId;
+    uint16_t urlLength;
+    uint32_t checksum;      // FNV-1a de la cabecera (checksum = 0) + URL
+};
+#pragma pack()
+
+// Funciones
+bool openJobJournal(const char* filepath, vector<DownloadRequest>& pending);
+void journalEnqueue(const DownloadRequest& req);
+void journalStart(uint32_t jobId);
+void journalFinish(uint32_t jobId);
+void flushJobJournal();
+void closeJobJournal();
@@ -1,5 +1,7 @@
 #include "worker.hpp"
+#include "downloader.hpp"
 #include <sys/types.h>
+#include <ctime>
 
 using namespace std;
 
@@ -38,6 +40,147 @@ bool readWorkerMessage(int fd, WorkerMessage &msg) {
 	return true;
 }
 
+// Nombre de archivo (sin extensión) derivado del título
+string sanitizeFilename(const string &title) {
+	string filename = title.substr(0, 240);
+	for (char &c : filename) {
+		if (!isalnum((unsigned char)c) && c != '_' && c != '-' && c != ' ') {
+			c = '_';
+		}
+	}
+	return filename;
+}
+
+uint64_t monotonicMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// CLOCK_MONOTONIC es común a todos los procesos: sirve para medir el IPC
+uint64_t monotonicUs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Formato: PROGRESS:<descargados>:<total>:<velocidad>:<eta> ("NA" si falta)
+bool parseProgressLine(const char *line, ProgressFrame &frame) {
+	if (strncmp(line, "PROGRESS:", 9) != 0) {
+		return false;
+	}
+
+	const char *fields[4];
+	const char *ptr = line + 9;
+	for (int i = 0; i < 4; i++) {
+		if (!ptr) return false;
+		fields[i] = ptr;
+		ptr = strchr(ptr, ':');
+		if (ptr) ptr++;
+	}
+
+	// strtod acepta "NA" devolviendo 0 (y yt-dlp imprime floats en speed/total estimado)
+	frame.downloadedBytes = (uint64_t)strtod(fields[0], nullptr);
+	frame.totalBytes = (uint64_t)strtod(fields[1], nullptr);
+	frame.speed = (uint32_t)strtod(fields[2], nullptr);
+	frame.eta = isdigit((unsigned char)fields[3][0]) ? atoi(fields[3]) : -1;
+	return true;
+}
+
+// ===== SALIDA DE UNA DESCARGA: METADATOS + PROGRESO =====
+void handleDownloadLine(char *line, WorkerJobContext &ctx) {
+	ProgressFrame frame;
+
+	if (strncmp(line, "META:", 5) == 0 && ctx.metadataLines < 3) {
+		if (ctx.metadataLines == 0) {
+			ctx.title = line + 5;
+		}
+		size_t len = strlen(line + 5);
+		if (ctx.bytesMetadata + len + 1 < sizeof(ctx.metadata) - 512) {
+			memcpy(ctx.metadata + ctx.bytesMetadata, line + 5, len);
+			ctx.bytesMetadata += len;
+			ctx.metadata[ctx.bytesMetadata++] = '\n';
+		}
+		ctx.metadataLines++;
+	} else if (parseProgressLine(line, frame)) {
+		// Limitar a una trama cada PROGRESS_INTERVAL_MS (la final siempre pasa)
+		uint64_t now = monotonicMs();
+		bool finished = frame.totalBytes > 0 && frame.downloadedBytes >= frame.totalBytes;
+		if (finished || now - ctx.lastProgressSent >= PROGRESS_INTERVAL_MS) {
+			ctx.lastProgressSent = now;
+			WorkerMessage messageProgress;
+			messageProgress.type = MSG_PROGRESS;
+			messageProgress.sentUs = monotonicUs();
+			memcpy(messageProgress.data, &frame, sizeof(frame));
+			messageProgress.data_length = sizeof(frame);
+			writeWorkerMessage(ctx.write_fd, messageProgress);
+		}
+	} else if (line[0] != '\0') {
+		cerr << "[Worker " << ctx.worker_id << "] yt-dlp: " << line << endl;
+		if (strncmp(line, "ERROR:", 6) == 0) {
+			ctx.lastError = line + 6 + strspn(line + 6, " ");
+		}
+	}
+
+	// Enviar los metadatos en cuanto están completos (antes de la descarga)
+	if (ctx.metadataLines == 3 && !ctx.metadataSent &&
+		ctx.bytesMetadata + ctx.url.size() < sizeof(ctx.metadata)) {
+		ctx.metadataSent = true;
+		WorkerMessage messageMetadata;
+		memcpy(ctx.metadata + ctx.bytesMetadata, ctx.url.c_str(), ctx.url.size());
+		ctx.bytesMetadata += ctx.url.length();
+		ctx.metadata[ctx.bytesMetadata] = '\0';
+		messageMetadata.type = MSG_METADATA;
+		messageMetadata.sentUs = monotonicUs();
+		memcpy(messageMetadata.data, ctx.metadata, ctx.bytesMetadata);
+		messageMetadata.data[ctx.bytesMetadata] = '\0';
+		messageMetadata.data_length = ctx.bytesMetadata;
+
+		if (!writeWorkerMessage(ctx.write_fd, messageMetadata)) {
+			cerr << "[Worker " << ctx.worker_id << "] Error enviando metadatos" << endl;
+		}
+	}
+}
+
+// ===== SALIDA DE UNA EXPANSIÓN DE PLAYLIST: UNA URL POR LÍNEA =====
+void flushPlaylistItems(WorkerJobContext &ctx) {
+	if (ctx.bytesMetadata == 0) return;
+
+	WorkerMessage messageItems;
+	messageItems.type = MSG_PLAYLIST_ITEMS;
+	messageItems.sentUs = monotonicUs();
+	memcpy(messageItems.data, ctx.metadata, ctx.bytesMetadata);
+	messageItems.data_length = ctx.bytesMetadata;
+	messageItems.data[ctx.bytesMetadata] = '\0';
+	writeWorkerMessage(ctx.write_fd, messageItems);
+	ctx.bytesMetadata = 0;
+}
+
+void handleExpandLine(char *line, WorkerJobContext &ctx) {
+	if (strncmp(line, "ITEM:", 5) != 0) {
+		if (line[0] != '\0') {
+			cerr << "[Worker " << ctx.worker_id << "] yt-dlp: " << line << endl;
+			if (strncmp(line, "ERROR:", 6) == 0) {
+				ctx.lastError = line + 6 + strspn(line + 6, " ");
+			}
+		}
+		return;
+	}
+
+	const char *itemUrl = line + 5;
+	size_t len = strlen(itemUrl);
+	if (len == 0 || len >= 512) return;	// no cabe en Song::url
+
+	// Empaquetar varias URLs por mensaje separadas por '\n'
+	if (ctx.bytesMetadata + len + 1 >= sizeof(ctx.metadata)) {
+		flushPlaylistItems(ctx);
+	}
+	memcpy(ctx.metadata + ctx.bytesMetadata, itemUrl, len);
+	ctx.bytesMetadata += len;
+	ctx.metadata[ctx.bytesMetadata++] = '\n';
+	ctx.metadataLines++;
+}
+
 void workerProcess(int read_fd, int write_fd, int worker_id) {
 	cout << "[Worker " << worker_id << "] Iniciado con PID " << getpid() << endl;
 
@@ -54,93 +197,65 @@ void workerProcess(int read_fd, int write_fd, int worker_id) {
 			break;
 		}
 
-		if (request.type != MSG_REQUEST) {
+		if (request.type != MSG_REQUEST && request.type != MSG_EXPAND) {
 			continue;
 		}
 
-		string url(request.data, request.data_length);
-		cout << "[Worker " << worker_id << "] Procesando: " << url << endl;
-
-		int pipeMetadata[2];
-		pipe(pipeMetadata);
-
-		// ===== EJECUTAR YT-DLP =====
-		pid_t pid = fork();
-
-		if (pid == 0) {
-			close(pipeMetadata[0]);
-			dup2(pipeMetadata[1], STDOUT_FILENO);
-			close(pipeMetadata[1]);
-
-			execl("/usr/bin/yt-dlp",
-				"yt-dlp",
-				"--print", "before_dl:%(title)s\n%(artist,uploader)s\n%(duration)s",
-				"-x", "--audio-format", "mp3",
-				"--quiet",
-				"--no-warnings",
-				"--extractor-args", "youtube:player_client=android",
-				"-o", "songs/%(title)s.%(ext)s",
-				url.c_str(),
-				(char *)NULL);
-
-			// Si execl falla
-			cerr << "[Worker " << worker_id << "] Error ejecutando yt-dlp: "
-				 << strerror(errno) << endl;
-			exit(1);
-		} 
-		else if (pid > 0) {
-			// Proceso padre: esperar a que termine yt-dlp
-			int status;
-			close(pipeMetadata[1]);
-
-			char metadata[2048];
-			ssize_t bytesMetadata = 0;
-			while (bytesMetadata < (ssize_t)sizeof(metadata)) {
-				ssize_t bytesRead = read(pipeMetadata[0], metadata, sizeof(metadata));
-				if (bytesRead < 0) {
-					cerr << "error" << strerror(errno) << endl;
-				}
-				if (bytesRead == 0) {
-					break;
-				}
-				bytesMetadata += bytesRead;
-			}
-			close(pipeMetadata[0]);
-
-			WorkerMessage messageMetadata;
-			
-			cout << "[DEBUG WORKER] url en url.c_str() " << url.c_str() << endl;
-			memcpy(metadata + bytesMetadata, url.c_str(), url.size());
-			bytesMetadata += url.length();
-			metadata[bytesMetadata] = '\0';
-			cout << "[DEBUG WORKER] url copiada en metadata[2048]" << metadata << endl;
-			messageMetadata.type = MSG_METADATA;
-			memcpy(messageMetadata.data, metadata, bytesMetadata);
-			messageMetadata.data[bytesMetadata] = '\0';
-			messageMetadata.data_length = bytesMetadata;
-
-			if (!writeWorkerMessage(write_fd, messageMetadata)) {
-				cerr << "[Worker " << worker_id << "] Error enviando metadatos" << endl;
-				break;
+		WorkerJobContext ctx;
+		ctx.write_fd = write_fd;
+		ctx.worker_id = worker_id;
+		ctx.url = string(request.data, request.data_length);
+		int exitCode;
+
+		if (request.type == MSG_EXPAND) {
+			cout << "[Worker " << worker_id << "] Expandiendo playlist (" << activeDownloader->name
+				 << "): " << ctx.url << endl;
+
+			exitCode = activeDownloader->expand(ctx);
+			flushPlaylistItems(ctx);
+
+			cout << "[Worker " << worker_id << "] Playlist expandida: " << ctx.metadataLines
+				 << " entradas" << endl;
+		} else {
+			cout << "[Worker " << worker_id << "] Procesando (" << activeDownloader->name
+				 << "): " << ctx.url << endl;
+
+			// ===== FASE 1: SONDEO DE METADATOS (sin descargar) =====
+			exitCode = activeDownloader->probe(ctx);
+
+			if (exitCode == 0 && !ctx.metadataSent) {
+				cerr << "[Worker " << worker_id << "] Metadatos incompletos: " << ctx.url << endl;
+				ctx.lastError = "incomplete metadata";
+				exitCode = 1;
 			}
 
-			waitpid(pid, &status, 0);
-			close(pipeMetadata[0]);
+			// ===== FASE 2: DESCARGA DEL AUDIO (a songs/<título saneado>.mp3) =====
+			if (exitCode == 0) {
+				exitCode = activeDownloader->download(ctx);
+			}
 
-			if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-				cout << "[Worker " << worker_id << "] Descarga completada: " << url << endl;
+			if (exitCode == 0) {
+				cout << "[Worker " << worker_id << "] Descarga completada: " << ctx.url << endl;
 			} else {
-				cerr << "[Worker " << worker_id << "] Error en descarga: " << url << endl;
+				cerr << "[Worker " << worker_id << "] Error en descarga: " << ctx.url << endl;
 			}
-		} 
-		else {
-			cerr << "[Worker " << worker_id << "] Error en fork" << endl;
 		}
 
+		if (exitCode != 0 && ctx.lastError.empty()) {
+			ctx.lastError = exitCode < 0 ? string(activeDownloader->name) + " could not run"
+										 : string(activeDownloader->name) + " exit " + to_string(exitCode);
+		}
+
+		// url\nmotivo (motivo vacío si todo fue bien)
+		string payload = ctx.url + "\n" + (exitCode == 0 ? "" : ctx.lastError);
+		payload.resize(min(payload.size(), sizeof(request.data) - 1));
+
 		WorkerMessage response;
 		response.type = MSG_FINISHED;
-		response.data_length = url.length();
-		memcpy(response.data, url.c_str(), response.data_length);
+		response.sentUs = monotonicUs();
+		response.status = exitCode;
+		response.data_length = payload.length();
+		memcpy(response.data, payload.c_str(), response.data_length);
 		response.data[response.data_length] = '\0';
 
 		if (!writeWorkerMessage(write_fd, response)) {
@@ -152,4 +267,4 @@ void workerProcess(int read_fd, int write_fd, int worker_id) {
 	close(read_fd);
 	close(write_fd);
 	exit(0);
-}
\ No newline at end of file
+}
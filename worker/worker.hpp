@@ -22,22 +22,64 @@ using namespace std;
 #define MSG_FINISHED 2
 #define MSG_SHUTDOWN 3
 #define MSG_METADATA 4
+#define MSG_PROGRESS 5
+#define MSG_EXPAND   6
+#define MSG_PLAYLIST_ITEMS 7
+
+// Tipos de trabajo
+#define JOB_DOWNLOAD 0
+#define JOB_EXPAND   1
+
+// Progreso: como máximo una trama cada PROGRESS_INTERVAL_MS por trabajo
+#define PROGRESS_INTERVAL_MS 250
+// Sin progreso durante este tiempo => descarga atascada
+#define STALL_TIMEOUT_MS 30000
 
 // Message structure for pipe communication
 struct WorkerMessage {
     uint8_t type;
+    int32_t status;         // MSG_FINISHED: código de salida de yt-dlp (0 = OK), data = url\nmotivo
+    uint64_t sentUs;        // monotonicUs() al enviar (mide la latencia del pipe)
     uint32_t data_length;
     char data[2048];
     
-    WorkerMessage() : type(MSG_FINISHED), data_length(0) {
+    WorkerMessage() : type(MSG_FINISHED), status(0), sentUs(0), data_length(0) {
         data[0] = '\0';
     }
 };
 
+// Trama compacta de progreso (payload de MSG_PROGRESS)
+#pragma pack(1)
+struct ProgressFrame {
+    uint64_t downloadedBytes;
+    uint64_t totalBytes;    // 0 si yt-dlp no lo conoce
+    uint32_t speed;         // bytes/s
+    int32_t eta;            // segundos, -1 si desconocido
+};
+#pragma pack()
 
 struct DownloadRequest {
     string url;
     int clientFd;
+    int type = JOB_DOWNLOAD;
+    int bulkId = -1;        // trabajo masivo (ADDLIST) al que pertenece
+    uint32_t jobId = 0;     // identificador en el journal de trabajos
+    uint64_t enqueuedMs = 0;
+    uint64_t startedMs = 0;
+};
+
+// Estado de un trabajo dentro del proceso worker
+struct WorkerJobContext {
+    int write_fd;
+    int worker_id;
+    string url;
+    string title;
+    string lastError;       // última línea "ERROR:" de yt-dlp (motivo del fallo)
+    char metadata[2048];
+    size_t bytesMetadata = 0;
+    int metadataLines = 0;
+    bool metadataSent = false;
+    uint64_t lastProgressSent = 0;
 };
 
 // Worker information structure (for server use)
@@ -47,9 +89,13 @@ struct WorkerInfo {
     int pipe_write_fd;
     int state;
     DownloadRequest currentRequest;
+    ProgressFrame lastProgress;
+    uint64_t lastProgressMs;    // último avance (o inicio del trabajo)
+    bool stalled;
     
     WorkerInfo() : pid(-1), pipe_read_fd(-1), pipe_write_fd(-1), 
-                   state(WORKER_IDLE) {
+                   state(WORKER_IDLE), lastProgress{}, lastProgressMs(0),
+                   stalled(false) {
         currentRequest.clientFd = -1;
     }
 };
@@ -57,4 +103,13 @@ struct WorkerInfo {
 // Funciones
 void workerProcess(int read_fd, int write_fd, int worker_id);
 bool writeWorkerMessage(int fd, const WorkerMessage& msg);
-bool readWorkerMessage(int fd, WorkerMessage& msg);
\ No newline at end of file
+bool readWorkerMessage(int fd, WorkerMessage& msg);
+bool parseProgressLine(const char* line, ProgressFrame& frame);
+uint64_t monotonicMs();
+uint64_t monotonicUs();
+
+// Procesado de la salida de un backend (una línea cada vez)
+void handleDownloadLine(char* line, WorkerJobContext& ctx);
+void handleExpandLine(char* line, WorkerJobContext& ctx);
+void flushPlaylistItems(WorkerJobContext& ctx);
+string sanitizeFilename(const string& title);
\ No newline at end of file
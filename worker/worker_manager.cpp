@@ -1,5 +1,7 @@
 #include "worker_manager.hpp"
 #include "worker.hpp"
+#include "job_journal.hpp"
+#include "failure_guard.hpp"
 #include <iostream>
 #include <unistd.h>
 #include <fcntl.h>
@@ -9,7 +11,143 @@
 using namespace std;
 
 vector<WorkerInfo> workers;
-queue<DownloadRequest> downloadQueue;
+deque<DownloadRequest> downloadQueue;
+map<int, BulkJob> bulkJobs;
+int nextBulkId = 1;
+uint32_t nextRequestId = 1;
+WorkerPoolStats poolStats;
+
+// ===== ENCOLAR UN TRABAJO (y registrarlo en el journal) =====
+static void enqueueJob(DownloadRequest &req) {
+	req.jobId = nextRequestId++;
+	req.enqueuedMs = monotonicMs();
+	journalEnqueue(req);
+	downloadQueue.push_back(req);
+}
+
+// ===== REPORTE AGREGADO DE UN TRABAJO MASIVO =====
+static void reportBulkProgress(BulkJob &bulk, bool force) {
+	uint64_t now = monotonicMs();
+	if (!force && now - bulk.lastReportMs < BULK_REPORT_INTERVAL_MS) {
+		return;
+	}
+	bulk.lastReportMs = now;
+
+	if (bulk.clientFd > 0) {
+		// Formato: BULK id completadas fallidas total
+		string msg = "BULK " + to_string(bulk.id) + " " + to_string(bulk.done) + " " +
+					 to_string(bulk.failed) + " " + to_string(bulk.total) + "\n";
+		send(bulk.clientFd, msg.c_str(), msg.length(), MSG_NOSIGNAL);
+	}
+}
+
+// ===== FIN DE LA EXPANSIÓN: DEDUPLICAR EN LOTE Y ENCOLAR =====
+static void enqueueBulkItems(BulkJob &bulk) {
+	// Primero las repetidas dentro de la playlist, después todas las que
+	// quedan contra la base de una vez
+	unordered_set<string> seen;
+	seen.reserve(bulk.pendingUrls.size());
+	vector<string> urls;
+	urls.reserve(bulk.pendingUrls.size());
+	for (string &url : bulk.pendingUrls) {
+		if (seen.insert(url).second) {
+			urls.push_back(move(url));
+		} else {
+			bulk.duplicates++;
+		}
+	}
+
+	vector<char> duplicates(urls.size());
+	findDuplicateURLs(globalDB, urls.data(), urls.size(), duplicates.data());
+
+	for (size_t i = 0; i < urls.size(); i++) {
+		const string &url = urls[i];
+		if (duplicates[i]) {
+			bulk.duplicates++;
+			continue;
+		}
+		if (findRecentFailure(url)) {
+			bulk.blocked++;
+			continue;
+		}
+
+		// El cliente lo tiene el trabajo masivo (ver detachClient)
+		DownloadRequest req;
+		req.url = url;
+		req.clientFd = -1;
+		req.bulkId = bulk.id;
+		enqueueJob(req);
+		bulk.total++;
+	}
+	bulk.pendingUrls.clear();
+	bulk.pendingUrls.shrink_to_fit();
+	bulk.expanded = true;
+
+	cout << "[Server] Playlist " << bulk.id << " expandida: " << bulk.total << " en cola, "
+		 << bulk.duplicates << " duplicadas, " << bulk.blocked << " con fallos recientes" << endl;
+
+	if (bulk.clientFd > 0) {
+		// Formato: BULK_QUEUED id encoladas duplicadas bloqueadas
+		string msg = "BULK_QUEUED " + to_string(bulk.id) + " " + to_string(bulk.total) + " " +
+					 to_string(bulk.duplicates) + " " + to_string(bulk.blocked) + "\n";
+		send(bulk.clientFd, msg.c_str(), msg.length(), MSG_NOSIGNAL);
+	}
+}
+
+// ===== CERRAR UN TRABAJO MASIVO SI YA NO LE QUEDA NADA =====
+static void completeBulkJobIfDone(map<int, BulkJob>::iterator it) {
+	BulkJob &bulk = it->second;
+	if (!bulk.expanded || bulk.done + bulk.failed < bulk.total) {
+		reportBulkProgress(bulk, false);
+		return;
+	}
+
+	reportBulkProgress(bulk, true);
+	if (bulk.clientFd > 0) {
+		string msg = "BULK_DONE " + to_string(bulk.id) + "\n";
+		send(bulk.clientFd, msg.c_str(), msg.length(), MSG_NOSIGNAL);
+	}
+	cout << "[Server] Playlist " << bulk.id << " terminada: " << bulk.done << " OK, "
+		 << bulk.failed << " fallidas" << endl;
+	bulkJobs.erase(it);
+}
+
+// ===== LA EXPANSIÓN DE LA PLAYLIST FALLÓ =====
+// Lo que llegó antes del error no se encola: la playlist se reintenta entera
+static void failBulkJob(map<int, BulkJob>::iterator it, string reason) {
+	BulkJob &bulk = it->second;
+	for (char &c : reason) {
+		if (c == '\n' || c == '\r') c = ' ';
+	}
+
+	cerr << "[Server] Playlist " << bulk.id << " no se pudo expandir: " << reason << endl;
+	if (bulk.clientFd > 0) {
+		// Formato: BULK_FAILED id motivo
+		string msg = "BULK_FAILED " + to_string(bulk.id) + " " + reason + "\n";
+		send(bulk.clientFd, msg.c_str(), msg.length(), MSG_NOSIGNAL);
+	}
+	bulkJobs.erase(it);
+}
+
+// ===== UN TRABAJO DE UN TRABAJO MASIVO TERMINÓ =====
+static void finishBulkItem(const DownloadRequest &finished, bool ok, const string &reason) {
+	auto it = bulkJobs.find(finished.bulkId);
+	if (it == bulkJobs.end()) return;
+
+	if (finished.type == JOB_EXPAND) {
+		if (!ok) {
+			failBulkJob(it, reason);
+			return;
+		}
+		enqueueBulkItems(it->second);
+	} else if (ok) {
+		it->second.done++;
+	} else {
+		it->second.failed++;
+	}
+
+	completeBulkJobIfDone(it);
+}
 
 bool initializeWorkers(int epollFd, int numWorkers) {
 	cout << "[Server] Inicializando " << numWorkers << " workers..." << endl;
@@ -80,17 +218,61 @@ void handleWorkerEvent(int fd, void *data) {
 		return;
 	}
 
+	if (response.sentUs > 0) {
+		uint64_t ipcUs = monotonicUs() - response.sentUs;
+		poolStats.ipcMessages++;
+		poolStats.ipcUsTotal += ipcUs;
+		poolStats.ipcUsMax = max(poolStats.ipcUsMax, ipcUs);
+	}
+
 	if (response.type == MSG_FINISHED) {
-		string url(response.data, response.data_length);
+		// data = url\nmotivo
+		string payload(response.data, response.data_length);
+		size_t separator = payload.find('\n');
+		string url = payload.substr(0, separator);
+		string reason = separator == string::npos ? "" : payload.substr(separator + 1);
 		cout << "[Server] Worker " << worker->pid << " terminó: " << url << endl;
 
 		cout << "[DEBUG] worker->currentRequest.url = " << worker->currentRequest.url << endl;
 		cout << "[DEBUG] worker->currentRequest.clientFd = " << worker->currentRequest.clientFd << endl;
 
-		int clientFd = worker->currentRequest.clientFd;
+		DownloadRequest finished = worker->currentRequest;
+		journalFinish(finished.jobId);
+
+		poolStats.jobsCompleted += response.status == 0;
+		poolStats.jobsFailed += response.status != 0;
+		poolStats.runMsTotal += monotonicMs() - finished.startedMs;
+		if (finished.enqueuedMs > 0) {
+			poolStats.queueWaitMsTotal += finished.startedMs - finished.enqueuedMs;
+		}
+		worker->state = WORKER_IDLE;
+		worker->currentRequest.clientFd = -1;
+		worker->currentRequest.bulkId = -1;
+
+		if (finished.type == JOB_DOWNLOAD) {
+			markSongState(finished.url.c_str(), response.status == 0 ? SONG_AVAILABLE : SONG_FAILED);
+		}
+
+		// Caché negativa + circuit breaker
+		if (response.status == 0) {
+			recordDownloadSuccess(finished.url);
+		} else {
+			cerr << "[Server] Motivo del fallo: " << reason << endl;
+			recordDownloadFailure(finished.url, reason);
+		}
+
+		if (finished.bulkId >= 0) {
+			// Los trabajos masivos solo informan de forma agregada
+			finishBulkItem(finished, response.status == 0, reason);
+			assignPendingDownloads();
+			return;
+		}
+
+		int clientFd = finished.clientFd;
 
 		if (clientFd > 0) {
-			string msg = "Descarga completada: " + url + "\n";
+			string msg = response.status == 0 ? "Descarga completada: " + url + "\n"
+											  : "Descarga fallida: " + url + " (" + reason + ")\n";
 			ssize_t sent = send(clientFd, msg.c_str(), msg.length(), 0);
 
 			if (sent > 0) {
@@ -104,11 +286,58 @@ void handleWorkerEvent(int fd, void *data) {
 			cerr << "[Server] clientFd inválido: " << clientFd << endl;
 		}
 
-		worker->state = WORKER_IDLE;
-		worker->currentRequest.clientFd = -1;
 		assignPendingDownloads();
 	}
 
+	else if (response.type == MSG_PLAYLIST_ITEMS) {
+		auto it = bulkJobs.find(worker->currentRequest.bulkId);
+		if (it == bulkJobs.end()) {
+			return;
+		}
+
+		// Una URL por línea; se acumulan hasta que termine la expansión
+		const char *ptr = response.data;
+		const char *end = response.data + response.data_length;
+		while (ptr < end) {
+			const char *newline = (const char *)memchr(ptr, '\n', end - ptr);
+			if (!newline) newline = end;
+			if (newline > ptr) {
+				it->second.pendingUrls.emplace_back(ptr, newline - ptr);
+			}
+			ptr = newline + 1;
+		}
+	}
+
+	else if (response.type == MSG_PROGRESS) {
+		if (response.data_length != sizeof(ProgressFrame) || worker->state != WORKER_BUSY) {
+			return;
+		}
+
+		ProgressFrame frame;
+		memcpy(&frame, response.data, sizeof(frame));
+
+		// Solo cuenta como avance si han llegado bytes nuevos
+		if (frame.downloadedBytes != worker->lastProgress.downloadedBytes) {
+			worker->lastProgressMs = monotonicMs();
+			if (worker->stalled) {
+				cout << "[Server] Descarga reanudada: " << worker->currentRequest.url << endl;
+				worker->stalled = false;
+			}
+		}
+		worker->lastProgress = frame;
+
+		int clientFd = worker->currentRequest.clientFd;
+		if (clientFd > 0 && worker->currentRequest.bulkId < 0) {
+			// Formato: PROGRESS url descargados total velocidad eta
+			string msg = "PROGRESS " + worker->currentRequest.url + " " +
+						 to_string(frame.downloadedBytes) + " " +
+						 to_string(frame.totalBytes) + " " +
+						 to_string(frame.speed) + " " +
+						 to_string(frame.eta) + "\n";
+			send(clientFd, msg.c_str(), msg.length(), MSG_NOSIGNAL);
+		}
+	}
+
 	else if (response.type == MSG_METADATA) {
 		char metadata[2048];
 		memcpy(metadata, response.data, response.data_length);
@@ -125,28 +354,26 @@ void handleWorkerEvent(int fd, void *data) {
 		}
 
 		Song songMetadata;
+		memset(&songMetadata, 0, sizeof(songMetadata));
 
-		strcpy(songMetadata.title, title);
+		snprintf(songMetadata.title, sizeof(songMetadata.title), "%s", title);
 		cout << "[DEBUG WORKER MANAGER] title " << title << endl;
-		strcpy(songMetadata.artist, artist);
+		snprintf(songMetadata.artist, sizeof(songMetadata.artist), "%s", artist);
 		cout << "[DEBUG WORKER MANAGER] artist " << artist << endl;
-		strcpy(songMetadata.url, url);
+		snprintf(songMetadata.url, sizeof(songMetadata.url), "%s", url);
 		cout << "[DEBUG WORKER MANAGER] url " << url << endl;
 		songMetadata.duration = atoi(duration);
 		cout << "[DEBUG WORKER MANAGER] duration " << duration << endl;
 
-		string filename = title;
-		for (char &c : filename) {
-			if (!isalnum(c) && c != '_' && c != '-' && c != ' ') {
-				c = '_';
-			}
-		}
-		filename += ".mp3";
+		// Mismo nombre que usa el worker en la fase de descarga
+		string filename = sanitizeFilename(title) + ".mp3";
 
 		cout << "[DEBUG] filename " << filename << endl;
-		strcpy(songMetadata.filename, filename.c_str());
+		snprintf(songMetadata.filename, sizeof(songMetadata.filename), "%s", filename.c_str());
 		songMetadata.id = 0;
 
+		// Buscable desde ya; el audio sigue descargándose
+		songMetadata.state = SONG_PENDING;
 		indexSong(songMetadata);
 	}
 }
@@ -158,12 +385,61 @@ void submitDownload(const string &url, int clientFd) {
 	req.url = url;
 	req.clientFd = clientFd;
 
-	downloadQueue.push(req);
+	enqueueJob(req);
 	assignPendingDownloads();
 }
 
+int submitPlaylist(const string &url, int clientFd) {
+	BulkJob bulk;
+	bulk.id = nextBulkId++;
+	bulk.clientFd = clientFd;
+	bulk.playlistUrl = url;
+	bulkJobs[bulk.id] = bulk;
+
+	cout << "[Server] Añadiendo playlist " << bulk.id << " a cola: " << url
+		 << " (cliente: " << clientFd << ")" << endl;
+
+	DownloadRequest req;
+	req.url = url;
+	req.clientFd = -1;
+	req.type = JOB_EXPAND;
+	req.bulkId = bulk.id;
+
+	enqueueJob(req);
+	assignPendingDownloads();
+	return bulk.id;
+}
+
+// ===== EL CLIENTE SE DESCONECTÓ =====
+// Sus trabajos siguen, pero nadie debe recibir sus mensajes: el fd se
+// reutiliza en la siguiente conexión
+void detachClient(int clientFd) {
+	for (auto &entry : bulkJobs) {
+		if (entry.second.clientFd == clientFd) {
+			entry.second.clientFd = -1;
+		}
+	}
+	for (auto &worker : workers) {
+		if (worker.currentRequest.clientFd == clientFd) {
+			worker.currentRequest.clientFd = -1;
+		}
+	}
+	for (auto &req : downloadQueue) {
+		if (req.clientFd == clientFd) {
+			req.clientFd = -1;
+		}
+	}
+}
+
 void assignPendingDownloads() {
 	while (!downloadQueue.empty()) {
+		// Con el breaker abierto los trabajos esperan en cola (ver tickDownloadGuards)
+		if (!breakerAllowsDispatch()) {
+			cout << "[Server] Circuit breaker " << breakerStateName() << ", "
+				 << downloadQueue.size() << " descargas en espera" << endl;
+			break;
+		}
+
 		WorkerInfo *idleWorker = nullptr;
 		for (auto &worker : workers) {
 			if (worker.state == WORKER_IDLE) {
@@ -179,15 +455,19 @@ void assignPendingDownloads() {
 		}
 
 		DownloadRequest req = downloadQueue.front();
-		downloadQueue.pop();
+		downloadQueue.pop_front();
 
 		WorkerMessage request;
-		request.type = MSG_REQUEST;
+		request.type = req.type == JOB_EXPAND ? MSG_EXPAND : MSG_REQUEST;
 		request.data_length = req.url.length();
 		memcpy(request.data, req.url.c_str(), request.data_length);
 		request.data[request.data_length] = '\0';
 
+		req.startedMs = monotonicMs();
 		idleWorker->currentRequest = req;
+		idleWorker->lastProgress = ProgressFrame{};
+		idleWorker->lastProgressMs = monotonicMs();
+		idleWorker->stalled = false;
 
 		cout << "[DEBUG] Guardado en worker PID=" << idleWorker->pid
 			 << " -> url=" << idleWorker->currentRequest.url
@@ -195,17 +475,91 @@ void assignPendingDownloads() {
 
 		if (writeWorkerMessage(idleWorker->pipe_write_fd, request)) {
 			idleWorker->state = WORKER_BUSY;
+			journalStart(req.jobId);
+			breakerOnDispatch();
 			cout << "[Server] Asignado al worker " << idleWorker->pid
 				 << ": " << req.url << endl;
 		} else {
 			cerr << "[ERROR] No se pudo enviar request al worker\n";
-			downloadQueue.push(req);
+			downloadQueue.push_back(req);
 			idleWorker->currentRequest.clientFd = -1;
 			break;
 		}
 	}
 }
 
+void checkStalledDownloads() {
+	uint64_t now = monotonicMs();
+
+	for (auto &worker : workers) {
+		if (worker.state != WORKER_BUSY || worker.stalled) {
+			continue;
+		}
+		if (now - worker.lastProgressMs < STALL_TIMEOUT_MS) {
+			continue;
+		}
+
+		worker.stalled = true;
+		cerr << "[WARNING] Descarga atascada en worker " << worker.pid << " ("
+			 << (now - worker.lastProgressMs) / 1000 << "s sin progreso): "
+			 << worker.currentRequest.url << endl;
+
+		int clientFd = worker.currentRequest.clientFd;
+		if (clientFd > 0) {
+			string msg = "STALLED " + worker.currentRequest.url + "\n";
+			send(clientFd, msg.c_str(), msg.length(), MSG_NOSIGNAL);
+		}
+	}
+}
+
+// ===== REANUDAR LOS TRABAJOS QUE QUEDARON PENDIENTES EN EL JOURNAL =====
+void resumeJournaledJobs(const char *journalPath) {
+	vector<DownloadRequest> pending;
+	if (!openJobJournal(journalPath, pending)) {
+		cerr << "[ERROR] Journal de trabajos no disponible, las descargas no sobrevivirán a un reinicio" << endl;
+		return;
+	}
+
+	int resumed = 0;
+	for (DownloadRequest &req : pending) {
+		nextRequestId = max(nextRequestId, req.jobId + 1);
+
+		if (req.type == JOB_EXPAND) {
+			// La playlist se vuelve a expandir; nadie escucha el progreso agregado
+			BulkJob bulk;
+			bulk.id = nextBulkId++;
+			bulk.clientFd = -1;
+			bulk.playlistUrl = req.url;
+			bulkJobs[bulk.id] = bulk;
+			req.bulkId = bulk.id;
+		} else {
+			SongView song;
+			if (getSongByURL(globalDB, req.url.c_str(), &song) && song.state == SONG_AVAILABLE) {
+				// Terminó pero el FINISH no llegó a disco
+				journalFinish(req.jobId);
+				continue;
+			}
+			req.bulkId = -1;
+		}
+
+		downloadQueue.push_back(req);
+		resumed++;
+	}
+
+	if (resumed > 0) {
+		cout << "[Server] Reanudando " << resumed << " trabajos del journal" << endl;
+		assignPendingDownloads();
+	}
+}
+
+// ===== TAREA PERIÓDICA: CADUCAR LA CACHÉ NEGATIVA Y REANUDAR TRAS EL BACKOFF =====
+void tickDownloadGuards() {
+	purgeNegativeCache();
+	if (!downloadQueue.empty()) {
+		assignPendingDownloads();
+	}
+}
+
 void shutdownWorkers() {
 	cout << "[Server] Cerrando workers..." << endl;
 
@@ -2,20 +2,58 @@
 
 #include "worker.hpp"
 #include <vector>
-#include <queue>
+#include <deque>
 #include <string>
+#include <map>
+#include <unordered_set>
 
 using namespace std;
 
+// Reporte agregado de un trabajo masivo: como máximo uno por intervalo
+#define BULK_REPORT_INTERVAL_MS 1000
+
+// Trabajo masivo (ADDLIST): una playlist expandida en muchas descargas
+struct BulkJob {
+    int id;
+    int clientFd;
+    string playlistUrl;
+    vector<string> pendingUrls;     // entradas recibidas durante la expansión
+    int total = 0;
+    int done = 0;
+    int failed = 0;
+    int duplicates = 0;
+    int blocked = 0;                // URLs en la caché negativa
+    bool expanded = false;
+    uint64_t lastReportMs = 0;
+};
+
+// Métricas del pool de workers (bench_workers y logs)
+struct WorkerPoolStats {
+    uint64_t jobsCompleted = 0;
+    uint64_t jobsFailed = 0;
+    uint64_t queueWaitMsTotal = 0;  // encolado -> asignado a un worker
+    uint64_t runMsTotal = 0;        // asignado -> MSG_FINISHED
+    uint64_t ipcMessages = 0;
+    uint64_t ipcUsTotal = 0;        // write() en el worker -> read() en el servidor
+    uint64_t ipcUsMax = 0;
+};
+
 // Variables globales
 extern vector<WorkerInfo> workers;
-extern queue<DownloadRequest> downloadQueue;
+extern deque<DownloadRequest> downloadQueue;
 extern uint32_t nextRequestId;
+extern map<int, BulkJob> bulkJobs;
+extern WorkerPoolStats poolStats;
 
 // Funciones
 bool initializeWorkers(int epollFd, int numWorkers = 4);
 void submitDownload(const string& url, int clientFd);
+int submitPlaylist(const string& url, int clientFd);
+void detachClient(int clientFd);
 void assignPendingDownloads();
+void checkStalledDownloads();
+void tickDownloadGuards();
+void resumeJournaledJobs(const char* journalPath);
 void shutdownWorkers();
 
 // Handler para epoll